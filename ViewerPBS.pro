@@ -26,7 +26,24 @@ LIBS += -lGLEW
 
 SOURCES += \
     triangle_mesh.cc \
+    vertex_buffer.cc \
     mesh_io.cc \
+    mesh_optimizer.cc \
+    mesh_simplifier.cc \
+    mesh_processing.cc \
+    geometry_kernels.cc \
+    obj_io.cc \
+    stl_io.cc \
+    glb_io.cc \
+    qmesh_io.cc \
+    json.cc \
+    radix_sort.cc \
+    mapped_file.cc \
+    byte_swap.cc \
+    ply_format.cc \
+    ply_stream.cc \
+    mesh_cache.cc \
+    model_loader.cc \
     main.cc \
     main_window.cc \
     glwidget.cc \
@@ -34,7 +51,26 @@ SOURCES += \
 
 HEADERS  += \
     triangle_mesh.h \
+    vertex_buffer.h \
     mesh_io.h \
+    mesh_optimizer.h \
+    mesh_simplifier.h \
+    mesh_processing.h \
+    geometry_kernels.h \
+    obj_io.h \
+    stl_io.h \
+    glb_io.h \
+    qmesh_io.h \
+    json.h \
+    radix_sort.h \
+    mapped_file.h \
+    byte_swap.h \
+    parallel.h \
+    ply_format.h \
+    ply_stream.h \
+    text_parser.h \
+    mesh_cache.h \
+    model_loader.h \
     main_window.h \
     glwidget.h \
     camera.h
@@ -0,0 +1,384 @@
+// Author: Marc Comino 2020
+
+#include <GL/glew.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "./mesh_generator.h"
+#include "./mesh_io.h"
+#include "./parallel.h"
+#include "./triangle_mesh.h"
+
+namespace {
+
+const char *kStageNames[] = {"header",  "vertices",     "faces",
+                             "normals", "bounding_box", "vertex_buffer",
+                             "gl_upload"};
+const size_t kStages = sizeof(kStageNames) / sizeof(kStageNames[0]);
+const size_t kGlUploadStage = kStages - 1;
+
+/**
+ * @brief kReadStages The stages that read the file, used for the throughput.
+ */
+const size_t kReadStages = 3;
+
+/**
+ * @brief QuietStdout Silences the loader logs while it is alive, so they do
+ * not end up in the JSON.
+ */
+class QuietStdout {
+ public:
+  QuietStdout() : buffer_(std::cout.rdbuf(nullptr)) {}
+  ~QuietStdout() {
+    std::cout.rdbuf(buffer_);
+    std::cout.clear();
+  }
+
+ private:
+  std::streambuf *buffer_;
+};
+
+/**
+ * @brief GlUploader Offscreen OpenGL 3.3 context that uploads meshes the way
+ * GLWidget does.
+ */
+class GlUploader {
+ public:
+  GlUploader() : vao_(0), vbo_(0), ebo_(0) {}
+
+  ~GlUploader() {
+    if (vao_ == 0) return;
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &vbo_);
+    glDeleteBuffers(1, &ebo_);
+  }
+
+  /**
+   * @brief Initialize Creates the context and its buffers.
+   * @return Whether a 3.3 core context is available.
+   */
+  bool Initialize() {
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    context_.setFormat(format);
+    surface_.setFormat(format);
+    surface_.create();
+    if (!context_.create() || !context_.makeCurrent(&surface_)) return false;
+
+    glewExperimental = true;
+    if (glewInit() != GLEW_OK) return false;
+    glGetError();
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vbo_);
+    glGenBuffers(1, &ebo_);
+    return true;
+  }
+
+  std::string renderer() const {
+    return reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+  }
+
+  /**
+   * @brief Upload Sends the vertex and index buffers of the mesh and waits for
+   * the transfer to finish.
+   * @return The time it took, in seconds.
+   */
+  double Upload(const data_representation::TriangleMesh &mesh) {
+    const auto kStart = std::chrono::steady_clock::now();
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, mesh.buffer_.size() * sizeof(float),
+                 mesh.buffer_.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.faces_.size() * sizeof(int),
+                 mesh.faces_.data(), GL_STATIC_DRAW);
+    glFinish();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         kStart)
+        .count();
+  }
+
+ private:
+  QOffscreenSurface surface_;
+  QOpenGLContext context_;
+  GLuint vao_;
+  GLuint vbo_;
+  GLuint ebo_;
+};
+
+/**
+ * @brief ResetPeakRss Restarts the peak resident set size of the process, so
+ * every load is measured on its own. Only Linux supports it.
+ */
+void ResetPeakRss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+}
+
+/**
+ * @brief PeakRss Peak resident set size in bytes since the last reset, or
+ * since the start of the process if it cannot be reset.
+ */
+size_t PeakRss() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0)
+      return std::stoull(line.substr(6)) * 1024;
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+/**
+ * @brief Run The measurements of one synthetic mesh.
+ */
+struct Run {
+  std::string shape;
+  size_t requested;
+  size_t vertices;
+  size_t triangles;
+  size_t file_bytes;
+  std::vector<double> stages[kStages];
+  std::vector<double> totals;
+  size_t peak_rss;
+};
+
+double Mean(const std::vector<double> &values) {
+  double sum = 0.0;
+  for (double value : values) sum += value;
+  return values.empty() ? 0.0 : sum / values.size();
+}
+
+/**
+ * @brief WriteSummary Writes the mean, the sample standard deviation, the
+ * coefficient of variation and the range of a list of durations.
+ */
+void WriteSummary(std::ostream &out, const std::vector<double> &seconds) {
+  const double kMean = Mean(seconds);
+  double squares = 0.0;
+  for (double value : seconds) squares += (value - kMean) * (value - kMean);
+  const double kStddev =
+      seconds.size() > 1 ? std::sqrt(squares / (seconds.size() - 1)) : 0.0;
+  out << "{\"mean_ms\": " << kMean * 1000.0
+      << ", \"stddev_ms\": " << kStddev * 1000.0
+      << ", \"cv\": " << (kMean > 0.0 ? kStddev / kMean : 0.0)
+      << ", \"min_ms\": "
+      << *std::min_element(seconds.begin(), seconds.end()) * 1000.0
+      << ", \"max_ms\": "
+      << *std::max_element(seconds.begin(), seconds.end()) * 1000.0 << "}";
+}
+
+void WriteRun(std::ostream &out, const Run &run) {
+  std::vector<double> read(run.totals.size(), 0.0);
+  for (size_t stage = 0; stage < kReadStages; ++stage)
+    for (size_t i = 0; i < read.size(); ++i) read[i] += run.stages[stage][i];
+
+  out << "    {\n"
+      << "      \"shape\": \"" << run.shape << "\",\n"
+      << "      \"requested_triangles\": " << run.requested << ",\n"
+      << "      \"triangles\": " << run.triangles << ",\n"
+      << "      \"vertices\": " << run.vertices << ",\n"
+      << "      \"file_bytes\": " << run.file_bytes << ",\n"
+      << "      \"stages\": {\n";
+  bool first = true;
+  for (size_t stage = 0; stage < kStages; ++stage) {
+    if (run.stages[stage].empty()) continue;
+    out << (first ? "" : ",\n") << "        \"" << kStageNames[stage]
+        << "\": ";
+    WriteSummary(out, run.stages[stage]);
+    first = false;
+  }
+  out << "\n      },\n"
+      << "      \"total\": ";
+  WriteSummary(out, run.totals);
+  out << ",\n"
+      << "      \"read_mb_per_s\": " << run.file_bytes / Mean(read) / 1e6
+      << ",\n"
+      << "      \"triangles_per_s\": " << run.triangles / Mean(run.totals)
+      << ",\n"
+      << "      \"peak_rss_bytes\": " << run.peak_rss << "\n"
+      << "    }";
+}
+
+std::vector<std::string> SplitList(const QString &list) {
+  std::vector<std::string> items;
+  for (const QString &item : list.split(',', QString::SkipEmptyParts))
+    items.push_back(item.trimmed().toStdString());
+  return items;
+}
+
+/**
+ * @brief Measure Generates a mesh, stores it as PLY and loads it repeats
+ * times.
+ * @return Whether every load succeeded.
+ */
+bool Measure(const std::string &shape, size_t triangles, int repeats,
+             const std::string &path, GlUploader *uploader, Run *run) {
+  {
+    data_representation::TriangleMesh mesh;
+    if (shape == "sphere") {
+      data_representation::GenerateSphere(triangles, &mesh);
+    } else if (shape == "grid") {
+      data_representation::GenerateNoisyGrid(triangles, &mesh);
+    } else {
+      std::cerr << "Unknown shape " << shape << std::endl;
+      return false;
+    }
+    QuietStdout quiet;
+    if (!data_representation::WriteToPly(path, mesh)) return false;
+  }
+
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) return false;
+  run->shape = shape;
+  run->requested = triangles;
+  run->file_bytes = static_cast<size_t>(info.st_size);
+  run->peak_rss = 0;
+
+  for (int repeat = 0; repeat < repeats; ++repeat) {
+    ResetPeakRss();
+    data_representation::TriangleMesh mesh;
+    data_representation::PlyReadStages stages;
+    bool loaded;
+    {
+      QuietStdout quiet;
+      loaded = data_representation::ReadFromPly(
+          path, &mesh, data_representation::NormalPolicy::kWhenMissing,
+          &stages);
+    }
+    if (!loaded) return false;
+
+    const double kSeconds[kStages] = {
+        stages.header,       stages.vertices,
+        stages.faces,        stages.normals,
+        stages.bounding_box, stages.vertex_buffer,
+        uploader != nullptr ? uploader->Upload(mesh) : 0.0};
+    double total = 0.0;
+    for (size_t stage = 0; stage < kStages; ++stage) {
+      if (stage == kGlUploadStage && uploader == nullptr) continue;
+      run->stages[stage].push_back(kSeconds[stage]);
+      total += kSeconds[stage];
+    }
+    run->totals.push_back(total);
+    run->peak_rss = std::max(run->peak_rss, PeakRss());
+    run->vertices = mesh.vertices_.size() / 3;
+    run->triangles = mesh.faces_.size() / 3;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  // The GL stage needs a GUI application, which needs a display.
+  const bool kGl = std::none_of(argv + 1, argv + argc, [](const char *arg) {
+    return strcmp(arg, "--no-gl") == 0;
+  });
+  std::unique_ptr<QCoreApplication> app(
+      kGl ? new QGuiApplication(argc, argv)
+          : new QCoreApplication(argc, argv));
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Generates synthetic PLY meshes, loads them with ReadFromPly and "
+      "reports the time of every stage as JSON.");
+  parser.addHelpOption();
+  QCommandLineOption sizes(
+      "sizes", "Comma separated triangle counts.", "list",
+      "10000,100000,1000000,10000000,100000000");
+  QCommandLineOption shapes("shapes", "Comma separated shapes: sphere, grid.",
+                            "list", "sphere,grid");
+  QCommandLineOption repeats("repeats", "Loads per mesh.", "count", "5");
+  QCommandLineOption directory("dir", "Where the meshes are written.", "path",
+                               QDir::tempPath());
+  QCommandLineOption output("output", "JSON file, stdout by default.",
+                            "file");
+  QCommandLineOption keep("keep", "Keep the generated meshes.");
+  QCommandLineOption no_gl("no-gl", "Skip the GL upload stage.");
+  parser.addOptions(
+      {sizes, shapes, repeats, directory, output, keep, no_gl});
+  parser.process(*app);
+
+  const int kRepeats = std::max(1, parser.value(repeats).toInt());
+  std::unique_ptr<GlUploader> uploader;
+  if (kGl) {
+    uploader.reset(new GlUploader());
+    if (!uploader->Initialize()) {
+      std::cerr << "No OpenGL 3.3 context, skipping the upload stage"
+                << std::endl;
+      uploader.reset();
+    }
+  }
+
+  std::vector<Run> runs;
+  for (const std::string &shape : SplitList(parser.value(shapes))) {
+    for (const std::string &size : SplitList(parser.value(sizes))) {
+      const size_t kTriangles = std::stoull(size);
+      const std::string kPath =
+          QDir(parser.value(directory))
+              .filePath(QString("synthetic_%1_%2.ply")
+                            .arg(shape.c_str(), size.c_str()))
+              .toStdString();
+      std::cerr << "Measuring " << shape << " of " << kTriangles
+                << " triangles" << std::endl;
+
+      Run run;
+      const bool kMeasured = Measure(shape, kTriangles, kRepeats, kPath,
+                                     uploader.get(), &run);
+      if (!parser.isSet(keep)) remove(kPath.c_str());
+      if (!kMeasured) {
+        std::cerr << "Could not measure " << kPath << std::endl;
+        return 1;
+      }
+      runs.push_back(std::move(run));
+    }
+  }
+
+  std::ostringstream json;
+  json << "{\n"
+       << "  \"threads\": " << data_representation::NumThreads() << ",\n"
+       << "  \"repeats\": " << kRepeats << ",\n"
+       << "  \"gl_renderer\": ";
+  if (uploader != nullptr) {
+    json << "\"" << uploader->renderer() << "\",\n";
+  } else {
+    json << "null,\n";
+  }
+  json << "  \"runs\": [\n";
+  for (size_t i = 0; i < runs.size(); ++i) {
+    WriteRun(json, runs[i]);
+    json << (i + 1 < runs.size() ? ",\n" : "\n");
+  }
+  json << "  ]\n}\n";
+
+  if (!parser.isSet(output)) {
+    std::cout << json.str();
+    return 0;
+  }
+  std::ofstream fout(parser.value(output).toStdString().c_str());
+  fout << json.str();
+  return fout ? 0 : 1;
+}
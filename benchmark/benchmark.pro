@@ -0,0 +1,51 @@
+# Author: Marc Comino 2020
+#
+# Mesh loading benchmark, built separately from the viewer:
+#   cd benchmark && qmake && make && ./release/PlyBenchmark --help
+
+QT       += core gui
+
+TARGET = PlyBenchmark
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += c++14
+CONFIG(release, release|debug):QMAKE_CXXFLAGS += -Wall -O2
+
+CONFIG(release, release|debug):DESTDIR = release/
+CONFIG(release, release|debug):OBJECTS_DIR = release/
+CONFIG(release, release|debug):MOC_DIR = release/
+
+CONFIG(debug, release|debug):DESTDIR = debug/
+CONFIG(debug, release|debug):OBJECTS_DIR = debug/
+CONFIG(debug, release|debug):MOC_DIR = debug/
+
+INCLUDEPATH += .. /usr/include/eigen3/
+
+LIBS += -lGLEW
+
+SOURCES += \
+    benchmark.cc \
+    mesh_generator.cc \
+    ../triangle_mesh.cc \
+    ../vertex_buffer.cc \
+    ../mesh_io.cc \
+    ../mesh_processing.cc \
+    ../geometry_kernels.cc \
+    ../mapped_file.cc \
+    ../byte_swap.cc \
+    ../ply_format.cc
+
+HEADERS  += \
+    mesh_generator.h \
+    ../triangle_mesh.h \
+    ../vertex_buffer.h \
+    ../mesh_io.h \
+    ../mesh_processing.h \
+    ../geometry_kernels.h \
+    ../mapped_file.h \
+    ../byte_swap.h \
+    ../parallel.h \
+    ../ply_format.h \
+    ../text_parser.h
@@ -0,0 +1,131 @@
+// Author: Marc Comino 2020
+
+#include <benchmark/mesh_generator.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+/**
+ * @brief Noise Deterministic value in [-1, 1] for a grid position.
+ */
+float Noise(uint64_t i, uint64_t j) {
+  uint64_t x = (i << 32) ^ j;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return static_cast<float>(x >> 40) / static_cast<float>(1 << 23) - 1.0f;
+}
+
+}  // namespace
+
+void GenerateSphere(size_t triangles, TriangleMesh *mesh) {
+  // A sphere of r rings and 2r segments has 4r(r - 1) triangles.
+  const size_t kRings = std::max<size_t>(
+      2, static_cast<size_t>(
+             std::lround((1.0 + std::sqrt(1.0 + triangles)) / 2.0)));
+  const size_t kSegments = kRings * 2;
+  const size_t kSouth = 1 + (kRings - 1) * kSegments;
+
+  mesh->Clear();
+  mesh->vertices_.resize((kSouth + 1) * 3);
+  mesh->faces_.resize(kSegments * (kRings - 1) * 6);
+  float *vertices = mesh->vertices_.data();
+  int *faces = mesh->faces_.data();
+
+  vertices[2] = 1.0f;
+  vertices[kSouth * 3 + 2] = -1.0f;
+  ParallelFor(kRings - 1, [&](size_t ring) {
+    const double kTheta = kPi * (ring + 1) / kRings;
+    for (size_t j = 0; j < kSegments; ++j) {
+      const double kPhi = 2.0 * kPi * j / kSegments;
+      float *vertex = vertices + (1 + ring * kSegments + j) * 3;
+      vertex[0] = static_cast<float>(std::sin(kTheta) * std::cos(kPhi));
+      vertex[1] = static_cast<float>(std::sin(kTheta) * std::sin(kPhi));
+      vertex[2] = static_cast<float>(std::cos(kTheta));
+    }
+  });
+
+  // Caps first, then two triangles per quad of every band.
+  ParallelFor(kRings, [&](size_t band) {
+    for (size_t j = 0; j < kSegments; ++j) {
+      const size_t kNext = (j + 1) % kSegments;
+      if (band == 0) {
+        int *face = faces + j * 3;
+        face[0] = 0;
+        face[1] = static_cast<int>(1 + j);
+        face[2] = static_cast<int>(1 + kNext);
+      } else if (band == kRings - 1) {
+        const size_t kRing = 1 + (kRings - 2) * kSegments;
+        int *face = faces + (kSegments + j) * 3;
+        face[0] = static_cast<int>(kSouth);
+        face[1] = static_cast<int>(kRing + kNext);
+        face[2] = static_cast<int>(kRing + j);
+      } else {
+        const int kA = static_cast<int>(1 + (band - 1) * kSegments + j);
+        const int kB = static_cast<int>(1 + (band - 1) * kSegments + kNext);
+        const int kC = kA + static_cast<int>(kSegments);
+        const int kD = kB + static_cast<int>(kSegments);
+        int *face =
+            faces + (2 * kSegments + ((band - 1) * kSegments + j) * 2) * 3;
+        face[0] = kA;
+        face[1] = kC;
+        face[2] = kD;
+        face[3] = kA;
+        face[4] = kD;
+        face[5] = kB;
+      }
+    }
+  });
+}
+
+void GenerateNoisyGrid(size_t triangles, TriangleMesh *mesh) {
+  // A grid of n x n vertices has 2(n - 1)^2 triangles.
+  const size_t kSide =
+      1 + std::max<size_t>(1, static_cast<size_t>(std::lround(
+                                  std::sqrt(triangles / 2.0))));
+  const float kSpacing = 2.0f / (kSide - 1);
+
+  mesh->Clear();
+  mesh->vertices_.resize(kSide * kSide * 3);
+  mesh->faces_.resize((kSide - 1) * (kSide - 1) * 6);
+  float *vertices = mesh->vertices_.data();
+  int *faces = mesh->faces_.data();
+
+  ParallelFor(kSide, [&](size_t row) {
+    for (size_t i = 0; i < kSide; ++i) {
+      float *vertex = vertices + (row * kSide + i) * 3;
+      vertex[0] = -1.0f + i * kSpacing;
+      vertex[1] = -1.0f + row * kSpacing;
+      vertex[2] = 0.5f * kSpacing * Noise(i, row);
+    }
+  });
+  ParallelFor(kSide - 1, [&](size_t row) {
+    for (size_t i = 0; i + 1 < kSide; ++i) {
+      const int kA = static_cast<int>(row * kSide + i);
+      const int kB = kA + 1;
+      const int kC = kA + static_cast<int>(kSide);
+      const int kD = kC + 1;
+      int *face = faces + (row * (kSide - 1) + i) * 6;
+      face[0] = kA;
+      face[1] = kB;
+      face[2] = kD;
+      face[3] = kA;
+      face[4] = kD;
+      face[5] = kC;
+    }
+  });
+}
+
+}  // namespace data_representation
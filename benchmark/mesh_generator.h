@@ -0,0 +1,32 @@
+// Author: Marc Comino 2020
+
+#ifndef BENCHMARK_MESH_GENERATOR_H_
+#define BENCHMARK_MESH_GENERATOR_H_
+
+#include <triangle_mesh.h>
+
+#include <cstddef>
+
+namespace data_representation {
+
+/**
+ * @brief GenerateSphere Builds a unit sphere subdivided into rings and twice as
+ * many segments, with about the requested number of triangles. Its vertices
+ * are shared and evenly spread, the best case for the loader.
+ * @param triangles Requested triangle count.
+ * @param mesh The resulting mesh, without normals.
+ */
+void GenerateSphere(size_t triangles, TriangleMesh *mesh);
+
+/**
+ * @brief GenerateNoisyGrid Builds a square grid of about the requested number
+ * of triangles whose heights are deterministic noise, so the face normals
+ * differ everywhere.
+ * @param triangles Requested triangle count.
+ * @param mesh The resulting mesh, without normals.
+ */
+void GenerateNoisyGrid(size_t triangles, TriangleMesh *mesh);
+
+}  // namespace data_representation
+
+#endif  // BENCHMARK_MESH_GENERATOR_H_
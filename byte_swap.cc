@@ -0,0 +1,210 @@
+// Author: Marc Comino 2020
+
+#include <byte_swap.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BYTE_SWAP_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BYTE_SWAP_NEON
+#endif
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief SwapFields Scalar fallback swapping the fields of a single record.
+ */
+void SwapFields(char *record, const std::vector<size_t> &fields) {
+  for (size_t size : fields) {
+    std::reverse(record, record + size);
+    record += size;
+  }
+}
+
+void SwapScalar(char *p, size_t count, size_t size) {
+  for (size_t i = 0; i < count; ++i, p += size) {
+    if (size == 2) {
+      uint16_t value;
+      memcpy(&value, p, 2);
+      value = __builtin_bswap16(value);
+      memcpy(p, &value, 2);
+    } else if (size == 4) {
+      uint32_t value;
+      memcpy(&value, p, 4);
+      value = __builtin_bswap32(value);
+      memcpy(p, &value, 4);
+    } else if (size == 8) {
+      uint64_t value;
+      memcpy(&value, p, 8);
+      value = __builtin_bswap64(value);
+      memcpy(p, &value, 8);
+    } else {
+      std::reverse(p, p + size);
+    }
+  }
+}
+
+/**
+ * @brief RecordMask Builds the 16-byte shuffle that reverses every field of a
+ * record and leaves the bytes past its end untouched.
+ */
+void RecordMask(const std::vector<size_t> &fields, unsigned char mask[16]) {
+  for (size_t j = 0; j < 16; ++j) mask[j] = static_cast<unsigned char>(j);
+
+  size_t offset = 0;
+  for (size_t size : fields) {
+    for (size_t b = 0; b < size && offset + b < 16; ++b)
+      mask[offset + b] = static_cast<unsigned char>(offset + size - 1 - b);
+    offset += size;
+  }
+}
+
+#if defined(BYTE_SWAP_X86)
+
+enum class SimdLevel { kScalar, kSsse3, kAvx2 };
+
+SimdLevel DetectSimdLevel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return SimdLevel::kAvx2;
+  if (__builtin_cpu_supports("ssse3")) return SimdLevel::kSsse3;
+  return SimdLevel::kScalar;
+}
+
+const SimdLevel kSimdLevel = DetectSimdLevel();
+
+__attribute__((target("ssse3"))) size_t SwapSsse3(char *p, size_t bytes,
+                                                    size_t size) {
+  std::vector<size_t> fields(16 / size, size);
+  unsigned char mask[16];
+  RecordMask(fields, mask);
+
+  const __m128i kMask = _mm_loadu_si128(reinterpret_cast<__m128i *>(mask));
+  size_t i = 0;
+  for (; i + 16 <= bytes; i += 16) {
+    __m128i *block = reinterpret_cast<__m128i *>(p + i);
+    _mm_storeu_si128(block, _mm_shuffle_epi8(_mm_loadu_si128(block), kMask));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) size_t SwapAvx2(char *p, size_t bytes,
+                                                  size_t size) {
+  std::vector<size_t> fields(16 / size, size);
+  unsigned char mask[16];
+  RecordMask(fields, mask);
+
+  // vpshufb shuffles within each 128-bit lane, so both lanes use the mask.
+  const __m128i kLane = _mm_loadu_si128(reinterpret_cast<__m128i *>(mask));
+  const __m256i kMask = _mm256_broadcastsi128_si256(kLane);
+  size_t i = 0;
+  for (; i + 64 <= bytes; i += 64) {
+    __m256i *block = reinterpret_cast<__m256i *>(p + i);
+    const __m256i kFirst = _mm256_loadu_si256(block);
+    const __m256i kSecond = _mm256_loadu_si256(block + 1);
+    _mm256_storeu_si256(block, _mm256_shuffle_epi8(kFirst, kMask));
+    _mm256_storeu_si256(block + 1, _mm256_shuffle_epi8(kSecond, kMask));
+  }
+  for (; i + 32 <= bytes; i += 32) {
+    __m256i *block = reinterpret_cast<__m256i *>(p + i);
+    _mm256_storeu_si256(block,
+                        _mm256_shuffle_epi8(_mm256_loadu_si256(block), kMask));
+  }
+  return i;
+}
+
+/**
+ * @brief SwapRecordsSsse3 Swaps one record per shuffle. The bytes loaded past
+ * the end of a record belong to the next one, which has not been swapped yet,
+ * and are written back unchanged.
+ * @return The number of records processed.
+ */
+__attribute__((target("ssse3"))) size_t SwapRecordsSsse3(
+    char *p, size_t count, size_t stride, const std::vector<size_t> &fields) {
+  unsigned char mask[16];
+  RecordMask(fields, mask);
+
+  const __m128i kMask = _mm_loadu_si128(reinterpret_cast<__m128i *>(mask));
+  const size_t kBytes = count * stride;
+  size_t i = 0;
+  for (; i < count && i * stride + 16 <= kBytes; ++i) {
+    __m128i *record = reinterpret_cast<__m128i *>(p + i * stride);
+    _mm_storeu_si128(record, _mm_shuffle_epi8(_mm_loadu_si128(record), kMask));
+  }
+  return i;
+}
+
+#endif  // BYTE_SWAP_X86
+
+/**
+ * @brief SwapVectorized Swaps the largest prefix of the block that the
+ * available instruction set can handle.
+ * @return The number of bytes processed.
+ */
+size_t SwapVectorized(char *p, size_t bytes, size_t size) {
+#if defined(BYTE_SWAP_X86)
+  if (kSimdLevel == SimdLevel::kAvx2) return SwapAvx2(p, bytes, size);
+  if (kSimdLevel == SimdLevel::kSsse3) return SwapSsse3(p, bytes, size);
+#elif defined(BYTE_SWAP_NEON)
+  size_t i = 0;
+  for (; i + 16 <= bytes; i += 16) {
+    uint8_t *block = reinterpret_cast<uint8_t *>(p + i);
+    const uint8x16_t kValues = vld1q_u8(block);
+    if (size == 2) vst1q_u8(block, vrev16q_u8(kValues));
+    if (size == 4) vst1q_u8(block, vrev32q_u8(kValues));
+    if (size == 8) vst1q_u8(block, vrev64q_u8(kValues));
+  }
+  return i;
+#endif
+  (void)p;
+  (void)bytes;
+  (void)size;
+  return 0;
+}
+
+}  // namespace
+
+void ByteSwap(void *data, size_t count, size_t size) {
+  if (size != 2 && size != 4 && size != 8) {
+    if (size > 1) SwapScalar(static_cast<char *>(data), count, size);
+    return;
+  }
+
+  char *p = static_cast<char *>(data);
+  const size_t kDone = SwapVectorized(p, count * size, size);
+  SwapScalar(p + kDone, count - kDone / size, size);
+}
+
+void ByteSwapRecords(void *data, size_t count,
+                     const std::vector<size_t> &fields) {
+  if (fields.empty()) return;
+
+  char *p = static_cast<char *>(data);
+  const size_t kStride = std::accumulate(fields.begin(), fields.end(),
+                                         static_cast<size_t>(0));
+  const bool kUniform =
+      std::all_of(fields.begin(), fields.end(),
+                  [&](size_t size) { return size == fields.front(); });
+  if (kUniform) {
+    ByteSwap(p, count * fields.size(), fields.front());
+    return;
+  }
+
+  size_t done = 0;
+#if defined(BYTE_SWAP_X86)
+  if (kStride <= 16 && kSimdLevel != SimdLevel::kScalar)
+    done = SwapRecordsSsse3(p, count, kStride, fields);
+#endif
+  for (size_t i = done; i < count; ++i) SwapFields(p + i * kStride, fields);
+}
+
+}  // namespace data_representation
@@ -0,0 +1,35 @@
+// Author: Marc Comino 2020
+
+#ifndef BYTE_SWAP_H_
+#define BYTE_SWAP_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief ByteSwap Reverses the byte order of count consecutive values of the
+ * given size (2, 4 or 8 bytes) in place. Uses AVX2 or SSSE3 shuffles when the
+ * CPU supports them.
+ * @param data First value. Needs no particular alignment.
+ * @param count Number of values.
+ * @param size Size of every value in bytes.
+ */
+void ByteSwap(void *data, size_t count, size_t size);
+
+/**
+ * @brief ByteSwapRecords Reverses the byte order of every field of count
+ * consecutive fixed-size records in place. Records whose fields all have the
+ * same size are swapped as a single block, records up to 16 bytes long with
+ * mixed field sizes are swapped with one shuffle each.
+ * @param data First record. Needs no particular alignment.
+ * @param count Number of records.
+ * @param fields Size in bytes of every field of a record, in order.
+ */
+void ByteSwapRecords(void *data, size_t count,
+                     const std::vector<size_t> &fields);
+
+}  // namespace data_representation
+
+#endif  // BYTE_SWAP_H_
@@ -40,6 +40,7 @@ Camera::Camera()
       centering_y_(0.0),
       centering_z_(0.0),
       scaling_(1.0),
+      radius_(0.0),
       field_of_view_(0.0),
       z_near_(0.0),
       z_far_(0.0) {}
@@ -141,6 +142,17 @@ void Camera::UpdateModel(Eigen::Vector3f min, Eigen::Vector3f max) {
   float longest_edge =
       std::max(max[0] - min[0], std::max(max[1] - min[1], max[2] - min[2]));
   scaling_ = 1.0 / static_cast<double>(longest_edge);
+  radius_ = (max - min).cast<double>().norm() / 2.0 * scaling_;
+}
+
+double Camera::ProjectedSize(double length) const {
+  // The view keeps the model center at (pan_x_, pan_y_, -distance_).
+  const double kCenter =
+      std::sqrt(pan_x_ * pan_x_ + pan_y_ * pan_y_ + distance_ * distance_);
+  const double kDepth = std::max(kCenter - radius_, z_near_);
+  const double kFocal =
+      viewport_height_ / (2.0 * std::tan(field_of_view_ * M_PI / 360.0));
+  return length * scaling_ * kFocal / kDepth;
 }
 
 void Camera::SetRotationX(double y) {
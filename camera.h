@@ -119,6 +119,12 @@ class Camera {
    */
   double scaling_;
 
+  /**
+   * @brief radius_ Radius of the sphere around the model bounding box, after
+   * the modeling transform.
+   */
+  double radius_;
+
   /**
    * @brief field_of_view_ Field of view for a perspective camera.
    */
@@ -235,6 +241,15 @@ class Camera {
    */
   void UpdateModel(Eigen::Vector3f min, Eigen::Vector3f max);
 
+  /**
+   * @brief ProjectedSize Size in pixels of a model space length seen on the
+   * viewport axis at the point of the model closest to the camera, the
+   * largest it can appear anywhere on the model. Depths are clamped to the
+   * near plane.
+   * @param length A length in the units of the model.
+   */
+  double ProjectedSize(double length) const;
+
   /**
    * @brief SetRotationX If rotating is active, rotates the camera around the X
    * axis.
@@ -0,0 +1,625 @@
+// Author: Marc Comino 2020
+
+#include <geometry_kernels.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEOMETRY_KERNELS_X86
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GEOMETRY_KERNELS_NEON
+#endif
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kAcos Coefficients of the polynomial of FastAcos, from x^7 to x^0
+ * (Abramowitz and Stegun 4.4.46).
+ */
+const float kAcos[8] = {-0.0012624911f, 0.0066700901f,  -0.0170881256f,
+                        0.0308918810f,  -0.0501743046f, 0.0889789874f,
+                        -0.2145988016f, 1.5707963050f};
+
+const float kPi = 3.14159265358979f;
+
+/**
+ * @brief FastAcos acos(x) as sqrt(1 - |x|) times a polynomial in |x|. x is
+ * clamped to [-1, 1].
+ */
+float FastAcos(float x) {
+  const float kX = std::min(1.0f, std::fabs(x));
+  float polynomial = kAcos[0];
+  for (int i = 1; i < 8; ++i) polynomial = polynomial * kX + kAcos[i];
+  const float kAngle = std::sqrt(1.0f - kX) * polynomial;
+  return x < 0.0f ? kPi - kAngle : kAngle;
+}
+
+#if defined(GEOMETRY_KERNELS_X86)
+
+enum class SimdLevel { kScalar, kSse2, kAvx2 };
+
+SimdLevel DetectSimdLevel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return SimdLevel::kAvx2;
+  if (__builtin_cpu_supports("sse2")) return SimdLevel::kSse2;
+  return SimdLevel::kScalar;
+}
+
+const SimdLevel kSimdLevel = DetectSimdLevel();
+
+/**
+ * @brief ExtendBoundsSse2 Loads four points as three registers whose lanes
+ * cycle through x, y and z, and reduces every register on its own; the lanes
+ * are folded back into components at the end.
+ * @return The number of points processed.
+ */
+__attribute__((target("sse2"))) size_t ExtendBoundsSse2(const float *points,
+                                                        size_t count,
+                                                        float min[3],
+                                                        float max[3]) {
+  __m128 low[3], high[3];
+  for (int r = 0; r < 3; ++r) {
+    float lanes_min[4], lanes_max[4];
+    for (int l = 0; l < 4; ++l) {
+      lanes_min[l] = min[(r * 4 + l) % 3];
+      lanes_max[l] = max[(r * 4 + l) % 3];
+    }
+    low[r] = _mm_loadu_ps(lanes_min);
+    high[r] = _mm_loadu_ps(lanes_max);
+  }
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (int r = 0; r < 3; ++r) {
+      const __m128 kValues = _mm_loadu_ps(points + i * 3 + r * 4);
+      low[r] = _mm_min_ps(low[r], kValues);
+      high[r] = _mm_max_ps(high[r], kValues);
+    }
+  }
+
+  float lanes_min[12], lanes_max[12];
+  for (int r = 0; r < 3; ++r) {
+    _mm_storeu_ps(lanes_min + r * 4, low[r]);
+    _mm_storeu_ps(lanes_max + r * 4, high[r]);
+  }
+  for (int l = 0; l < 12; ++l) {
+    min[l % 3] = std::min(min[l % 3], lanes_min[l]);
+    max[l % 3] = std::max(max[l % 3], lanes_max[l]);
+  }
+  return i;
+}
+
+/**
+ * @brief ExtendBoundsAvx2 Same as the SSE2 kernel with eight points per
+ * iteration.
+ * @return The number of points processed.
+ */
+__attribute__((target("avx2"))) size_t ExtendBoundsAvx2(const float *points,
+                                                        size_t count,
+                                                        float min[3],
+                                                        float max[3]) {
+  __m256 low[3], high[3];
+  for (int r = 0; r < 3; ++r) {
+    float lanes_min[8], lanes_max[8];
+    for (int l = 0; l < 8; ++l) {
+      lanes_min[l] = min[(r * 8 + l) % 3];
+      lanes_max[l] = max[(r * 8 + l) % 3];
+    }
+    low[r] = _mm256_loadu_ps(lanes_min);
+    high[r] = _mm256_loadu_ps(lanes_max);
+  }
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    for (int r = 0; r < 3; ++r) {
+      const __m256 kValues = _mm256_loadu_ps(points + i * 3 + r * 8);
+      low[r] = _mm256_min_ps(low[r], kValues);
+      high[r] = _mm256_max_ps(high[r], kValues);
+    }
+  }
+
+  float lanes_min[24], lanes_max[24];
+  for (int r = 0; r < 3; ++r) {
+    _mm256_storeu_ps(lanes_min + r * 8, low[r]);
+    _mm256_storeu_ps(lanes_max + r * 8, high[r]);
+  }
+  for (int l = 0; l < 24; ++l) {
+    min[l % 3] = std::min(min[l % 3], lanes_min[l]);
+    max[l % 3] = std::max(max[l % 3], lanes_max[l]);
+  }
+  return i;
+}
+
+__attribute__((target("sse2"))) size_t SubtractSse2(const float *const a[3],
+                                                    const float *const b[3],
+                                                    size_t count,
+                                                    float *const out[3]) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (int k = 0; k < 3; ++k)
+      _mm_storeu_ps(out[k] + i, _mm_sub_ps(_mm_loadu_ps(a[k] + i),
+                                           _mm_loadu_ps(b[k] + i)));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) size_t SubtractAvx2(const float *const a[3],
+                                                    const float *const b[3],
+                                                    size_t count,
+                                                    float *const out[3]) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    for (int k = 0; k < 3; ++k)
+      _mm256_storeu_ps(out[k] + i, _mm256_sub_ps(_mm256_loadu_ps(a[k] + i),
+                                                 _mm256_loadu_ps(b[k] + i)));
+  }
+  return i;
+}
+
+__attribute__((target("sse2"))) size_t CrossSse2(const float *const a[3],
+                                                 const float *const b[3],
+                                                 size_t count,
+                                                 float *const out[3]) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 u[3], v[3];
+    for (int k = 0; k < 3; ++k) {
+      u[k] = _mm_loadu_ps(a[k] + i);
+      v[k] = _mm_loadu_ps(b[k] + i);
+    }
+    for (int k = 0; k < 3; ++k) {
+      const int kA = (k + 1) % 3, kB = (k + 2) % 3;
+      _mm_storeu_ps(out[k] + i, _mm_sub_ps(_mm_mul_ps(u[kA], v[kB]),
+                                           _mm_mul_ps(u[kB], v[kA])));
+    }
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) size_t CrossAvx2(const float *const a[3],
+                                                 const float *const b[3],
+                                                 size_t count,
+                                                 float *const out[3]) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 u[3], v[3];
+    for (int k = 0; k < 3; ++k) {
+      u[k] = _mm256_loadu_ps(a[k] + i);
+      v[k] = _mm256_loadu_ps(b[k] + i);
+    }
+    for (int k = 0; k < 3; ++k) {
+      const int kA = (k + 1) % 3, kB = (k + 2) % 3;
+      _mm256_storeu_ps(out[k] + i, _mm256_sub_ps(_mm256_mul_ps(u[kA], v[kB]),
+                                                 _mm256_mul_ps(u[kB], v[kA])));
+    }
+  }
+  return i;
+}
+
+__attribute__((target("sse2"))) size_t DotSse2(const float *const a[3],
+                                               const float *const b[3],
+                                               size_t count, float *out) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 dot = _mm_mul_ps(_mm_loadu_ps(a[0] + i), _mm_loadu_ps(b[0] + i));
+    for (int k = 1; k < 3; ++k)
+      dot = _mm_add_ps(dot, _mm_mul_ps(_mm_loadu_ps(a[k] + i),
+                                       _mm_loadu_ps(b[k] + i)));
+    _mm_storeu_ps(out + i, dot);
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) size_t DotAvx2(const float *const a[3],
+                                               const float *const b[3],
+                                               size_t count, float *out) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 dot =
+        _mm256_mul_ps(_mm256_loadu_ps(a[0] + i), _mm256_loadu_ps(b[0] + i));
+    for (int k = 1; k < 3; ++k)
+      dot = _mm256_add_ps(dot, _mm256_mul_ps(_mm256_loadu_ps(a[k] + i),
+                                             _mm256_loadu_ps(b[k] + i)));
+    _mm256_storeu_ps(out + i, dot);
+  }
+  return i;
+}
+
+__attribute__((target("sse2"))) size_t NormalizeSse2(float *const v[3],
+                                                     size_t count,
+                                                     float min_length) {
+  const __m128 kZero = _mm_setzero_ps();
+  const __m128 kOne = _mm_set1_ps(1.0f);
+  const __m128 kMinLength = _mm_set1_ps(min_length);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 c[3];
+    for (int k = 0; k < 3; ++k) c[k] = _mm_loadu_ps(v[k] + i);
+    const __m128 kLength = _mm_sqrt_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0], c[0]), _mm_mul_ps(c[1], c[1])),
+                   _mm_mul_ps(c[2], c[2])));
+    const __m128 kKeep = _mm_and_ps(_mm_cmpgt_ps(kLength, kZero),
+                                    _mm_cmpge_ps(kLength, kMinLength));
+    const __m128 kScale = _mm_and_ps(kKeep, _mm_div_ps(kOne, kLength));
+    for (int k = 0; k < 3; ++k)
+      _mm_storeu_ps(v[k] + i, _mm_mul_ps(c[k], kScale));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) size_t NormalizeAvx2(float *const v[3],
+                                                     size_t count,
+                                                     float min_length) {
+  const __m256 kZero = _mm256_setzero_ps();
+  const __m256 kOne = _mm256_set1_ps(1.0f);
+  const __m256 kMinLength = _mm256_set1_ps(min_length);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 c[3];
+    for (int k = 0; k < 3; ++k) c[k] = _mm256_loadu_ps(v[k] + i);
+    const __m256 kLength = _mm256_sqrt_ps(_mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(c[0], c[0]), _mm256_mul_ps(c[1], c[1])),
+        _mm256_mul_ps(c[2], c[2])));
+    const __m256 kKeep =
+        _mm256_and_ps(_mm256_cmp_ps(kLength, kZero, _CMP_GT_OQ),
+                      _mm256_cmp_ps(kLength, kMinLength, _CMP_GE_OQ));
+    const __m256 kScale = _mm256_and_ps(kKeep, _mm256_div_ps(kOne, kLength));
+    for (int k = 0; k < 3; ++k)
+      _mm256_storeu_ps(v[k] + i, _mm256_mul_ps(c[k], kScale));
+  }
+  return i;
+}
+
+__attribute__((target("sse2"))) size_t AnglesSse2(const float *dots,
+                                                  const float *lengths,
+                                                  size_t count,
+                                                  float *angles) {
+  const __m128 kZero = _mm_setzero_ps();
+  const __m128 kOne = _mm_set1_ps(1.0f);
+  const __m128 kSign = _mm_set1_ps(-0.0f);
+  const __m128 kPiVector = _mm_set1_ps(kPi);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 kLengths = _mm_loadu_ps(lengths + i);
+    const __m128 kCosine =
+        _mm_div_ps(_mm_loadu_ps(dots + i), _mm_sqrt_ps(kLengths));
+    const __m128 kX = _mm_min_ps(kOne, _mm_andnot_ps(kSign, kCosine));
+    __m128 polynomial = _mm_set1_ps(kAcos[0]);
+    for (int j = 1; j < 8; ++j)
+      polynomial =
+          _mm_add_ps(_mm_mul_ps(polynomial, kX), _mm_set1_ps(kAcos[j]));
+    const __m128 kAngle =
+        _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(kOne, kX)), polynomial);
+    const __m128 kNegative = _mm_cmplt_ps(kCosine, kZero);
+    const __m128 kResult =
+        _mm_or_ps(_mm_and_ps(kNegative, _mm_sub_ps(kPiVector, kAngle)),
+                  _mm_andnot_ps(kNegative, kAngle));
+    _mm_storeu_ps(angles + i,
+                  _mm_and_ps(_mm_cmpgt_ps(kLengths, kZero), kResult));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) size_t AnglesAvx2(const float *dots,
+                                                  const float *lengths,
+                                                  size_t count,
+                                                  float *angles) {
+  const __m256 kZero = _mm256_setzero_ps();
+  const __m256 kOne = _mm256_set1_ps(1.0f);
+  const __m256 kSign = _mm256_set1_ps(-0.0f);
+  const __m256 kPiVector = _mm256_set1_ps(kPi);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256 kLengths = _mm256_loadu_ps(lengths + i);
+    const __m256 kCosine =
+        _mm256_div_ps(_mm256_loadu_ps(dots + i), _mm256_sqrt_ps(kLengths));
+    const __m256 kX = _mm256_min_ps(kOne, _mm256_andnot_ps(kSign, kCosine));
+    __m256 polynomial = _mm256_set1_ps(kAcos[0]);
+    for (int j = 1; j < 8; ++j)
+      polynomial = _mm256_add_ps(_mm256_mul_ps(polynomial, kX),
+                                 _mm256_set1_ps(kAcos[j]));
+    const __m256 kAngle =
+        _mm256_mul_ps(_mm256_sqrt_ps(_mm256_sub_ps(kOne, kX)), polynomial);
+    const __m256 kResult =
+        _mm256_blendv_ps(kAngle, _mm256_sub_ps(kPiVector, kAngle),
+                         _mm256_cmp_ps(kCosine, kZero, _CMP_LT_OQ));
+    _mm256_storeu_ps(
+        angles + i,
+        _mm256_and_ps(_mm256_cmp_ps(kLengths, kZero, _CMP_GT_OQ), kResult));
+  }
+  return i;
+}
+
+/**
+ * @brief WeightedSumAvx2 Walks eight segments in lockstep, one per lane. A
+ * lane whose segment has ended gathers nothing and adds zero, so every
+ * segment is still added in order.
+ * @return The number of segments processed.
+ */
+__attribute__((target("avx2"))) size_t WeightedSumAvx2(
+    const float *const vectors[3], const float *weights,
+    const uint32_t *offsets, size_t segments, float *const sums[3]) {
+  const __m256 kZero = _mm256_setzero_ps();
+  size_t s = 0;
+  for (; s + 8 <= segments; s += 8) {
+    const __m256i kBegin =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(offsets + s));
+    const __m256i kEnd =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(offsets + s + 1));
+    const __m256i kLength = _mm256_sub_epi32(kEnd, kBegin);
+    uint32_t longest = 0;
+    for (size_t l = 0; l < 8; ++l)
+      longest = std::max(longest, offsets[s + l + 1] - offsets[s + l]);
+
+    __m256 sum[3] = {kZero, kZero, kZero};
+    for (uint32_t r = 0; r < longest; ++r) {
+      const __m256i kStep = _mm256_set1_epi32(static_cast<int>(r));
+      const __m256 kActive = _mm256_castsi256_ps(
+          _mm256_cmpgt_epi32(kLength, kStep));
+      const __m256i kEntry = _mm256_add_epi32(kBegin, kStep);
+      const __m256 kWeight =
+          _mm256_mask_i32gather_ps(kZero, weights, kEntry, kActive, 4);
+      for (int k = 0; k < 3; ++k) {
+        const __m256 kValue =
+            _mm256_mask_i32gather_ps(kZero, vectors[k], kEntry, kActive, 4);
+        sum[k] = _mm256_add_ps(sum[k], _mm256_mul_ps(kValue, kWeight));
+      }
+    }
+    for (int k = 0; k < 3; ++k) _mm256_storeu_ps(sums[k] + s, sum[k]);
+  }
+  return s;
+}
+
+#elif defined(GEOMETRY_KERNELS_NEON)
+
+/**
+ * @brief ExtendBoundsNeon Deinterleaves four points per iteration.
+ * @return The number of points processed.
+ */
+size_t ExtendBoundsNeon(const float *points, size_t count, float min[3],
+                        float max[3]) {
+  float32x4_t low[3], high[3];
+  for (int k = 0; k < 3; ++k) {
+    low[k] = vdupq_n_f32(min[k]);
+    high[k] = vdupq_n_f32(max[k]);
+  }
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const float32x4x3_t kValues = vld3q_f32(points + i * 3);
+    for (int k = 0; k < 3; ++k) {
+      low[k] = vminq_f32(low[k], kValues.val[k]);
+      high[k] = vmaxq_f32(high[k], kValues.val[k]);
+    }
+  }
+  for (int k = 0; k < 3; ++k) {
+    min[k] = vminvq_f32(low[k]);
+    max[k] = vmaxvq_f32(high[k]);
+  }
+  return i;
+}
+
+size_t SubtractNeon(const float *const a[3], const float *const b[3],
+                    size_t count, float *const out[3]) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (int k = 0; k < 3; ++k)
+      vst1q_f32(out[k] + i,
+                vsubq_f32(vld1q_f32(a[k] + i), vld1q_f32(b[k] + i)));
+  }
+  return i;
+}
+
+size_t CrossNeon(const float *const a[3], const float *const b[3],
+                 size_t count, float *const out[3]) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t u[3], v[3];
+    for (int k = 0; k < 3; ++k) {
+      u[k] = vld1q_f32(a[k] + i);
+      v[k] = vld1q_f32(b[k] + i);
+    }
+    for (int k = 0; k < 3; ++k) {
+      const int kA = (k + 1) % 3, kB = (k + 2) % 3;
+      vst1q_f32(out[k] + i, vsubq_f32(vmulq_f32(u[kA], v[kB]),
+                                      vmulq_f32(u[kB], v[kA])));
+    }
+  }
+  return i;
+}
+
+size_t DotNeon(const float *const a[3], const float *const b[3], size_t count,
+               float *out) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t dot = vmulq_f32(vld1q_f32(a[0] + i), vld1q_f32(b[0] + i));
+    for (int k = 1; k < 3; ++k)
+      dot = vaddq_f32(dot, vmulq_f32(vld1q_f32(a[k] + i), vld1q_f32(b[k] + i)));
+    vst1q_f32(out + i, dot);
+  }
+  return i;
+}
+
+size_t NormalizeNeon(float *const v[3], size_t count, float min_length) {
+  const float32x4_t kZero = vdupq_n_f32(0.0f);
+  const float32x4_t kOne = vdupq_n_f32(1.0f);
+  const float32x4_t kMinLength = vdupq_n_f32(min_length);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t c[3];
+    for (int k = 0; k < 3; ++k) c[k] = vld1q_f32(v[k] + i);
+    const float32x4_t kLength = vsqrtq_f32(
+        vaddq_f32(vaddq_f32(vmulq_f32(c[0], c[0]), vmulq_f32(c[1], c[1])),
+                  vmulq_f32(c[2], c[2])));
+    const uint32x4_t kKeep =
+        vandq_u32(vcgtq_f32(kLength, kZero), vcgeq_f32(kLength, kMinLength));
+    const float32x4_t kScale =
+        vbslq_f32(kKeep, vdivq_f32(kOne, kLength), kZero);
+    for (int k = 0; k < 3; ++k) vst1q_f32(v[k] + i, vmulq_f32(c[k], kScale));
+  }
+  return i;
+}
+
+size_t AnglesNeon(const float *dots, const float *lengths, size_t count,
+                  float *angles) {
+  const float32x4_t kZero = vdupq_n_f32(0.0f);
+  const float32x4_t kOne = vdupq_n_f32(1.0f);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const float32x4_t kLengths = vld1q_f32(lengths + i);
+    const float32x4_t kCosine =
+        vdivq_f32(vld1q_f32(dots + i), vsqrtq_f32(kLengths));
+    const float32x4_t kX = vminq_f32(kOne, vabsq_f32(kCosine));
+    float32x4_t polynomial = vdupq_n_f32(kAcos[0]);
+    for (int j = 1; j < 8; ++j)
+      polynomial = vaddq_f32(vmulq_f32(polynomial, kX), vdupq_n_f32(kAcos[j]));
+    const float32x4_t kAngle =
+        vmulq_f32(vsqrtq_f32(vsubq_f32(kOne, kX)), polynomial);
+    const float32x4_t kResult =
+        vbslq_f32(vcltq_f32(kCosine, kZero),
+                  vsubq_f32(vdupq_n_f32(kPi), kAngle), kAngle);
+    vst1q_f32(angles + i, vbslq_f32(vcgtq_f32(kLengths, kZero), kResult,
+                                    kZero));
+  }
+  return i;
+}
+
+#endif  // GEOMETRY_KERNELS_NEON
+
+}  // namespace
+
+void ExtendBounds(const float *points, size_t count, float min[3],
+                  float max[3]) {
+  size_t i = 0;
+#if defined(GEOMETRY_KERNELS_X86)
+  if (kSimdLevel == SimdLevel::kAvx2) {
+    i = ExtendBoundsAvx2(points, count, min, max);
+  } else if (kSimdLevel == SimdLevel::kSse2) {
+    i = ExtendBoundsSse2(points, count, min, max);
+  }
+#elif defined(GEOMETRY_KERNELS_NEON)
+  i = ExtendBoundsNeon(points, count, min, max);
+#endif
+  for (; i < count; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      min[k] = std::min(min[k], points[i * 3 + k]);
+      max[k] = std::max(max[k], points[i * 3 + k]);
+    }
+  }
+}
+
+void Subtract(const float *const a[3], const float *const b[3], size_t count,
+              float *const out[3]) {
+  size_t i = 0;
+#if defined(GEOMETRY_KERNELS_X86)
+  if (kSimdLevel == SimdLevel::kAvx2) {
+    i = SubtractAvx2(a, b, count, out);
+  } else if (kSimdLevel == SimdLevel::kSse2) {
+    i = SubtractSse2(a, b, count, out);
+  }
+#elif defined(GEOMETRY_KERNELS_NEON)
+  i = SubtractNeon(a, b, count, out);
+#endif
+  for (; i < count; ++i) {
+    for (int k = 0; k < 3; ++k) out[k][i] = a[k][i] - b[k][i];
+  }
+}
+
+void Cross(const float *const a[3], const float *const b[3], size_t count,
+           float *const out[3]) {
+  size_t i = 0;
+#if defined(GEOMETRY_KERNELS_X86)
+  if (kSimdLevel == SimdLevel::kAvx2) {
+    i = CrossAvx2(a, b, count, out);
+  } else if (kSimdLevel == SimdLevel::kSse2) {
+    i = CrossSse2(a, b, count, out);
+  }
+#elif defined(GEOMETRY_KERNELS_NEON)
+  i = CrossNeon(a, b, count, out);
+#endif
+  for (; i < count; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      const int kA = (k + 1) % 3, kB = (k + 2) % 3;
+      out[k][i] = a[kA][i] * b[kB][i] - a[kB][i] * b[kA][i];
+    }
+  }
+}
+
+void Dot(const float *const a[3], const float *const b[3], size_t count,
+         float *out) {
+  size_t i = 0;
+#if defined(GEOMETRY_KERNELS_X86)
+  if (kSimdLevel == SimdLevel::kAvx2) {
+    i = DotAvx2(a, b, count, out);
+  } else if (kSimdLevel == SimdLevel::kSse2) {
+    i = DotSse2(a, b, count, out);
+  }
+#elif defined(GEOMETRY_KERNELS_NEON)
+  i = DotNeon(a, b, count, out);
+#endif
+  for (; i < count; ++i)
+    out[i] = a[0][i] * b[0][i] + a[1][i] * b[1][i] + a[2][i] * b[2][i];
+}
+
+void Normalize(float *const v[3], size_t count, float min_length) {
+  size_t i = 0;
+#if defined(GEOMETRY_KERNELS_X86)
+  if (kSimdLevel == SimdLevel::kAvx2) {
+    i = NormalizeAvx2(v, count, min_length);
+  } else if (kSimdLevel == SimdLevel::kSse2) {
+    i = NormalizeSse2(v, count, min_length);
+  }
+#elif defined(GEOMETRY_KERNELS_NEON)
+  i = NormalizeNeon(v, count, min_length);
+#endif
+  for (; i < count; ++i) {
+    const float kLength =
+        std::sqrt(v[0][i] * v[0][i] + v[1][i] * v[1][i] + v[2][i] * v[2][i]);
+    const float kScale =
+        kLength > 0.0f && kLength >= min_length ? 1.0f / kLength : 0.0f;
+    for (int k = 0; k < 3; ++k) v[k][i] *= kScale;
+  }
+}
+
+void Angles(const float *dots, const float *lengths, size_t count,
+            float *angles) {
+  size_t i = 0;
+#if defined(GEOMETRY_KERNELS_X86)
+  if (kSimdLevel == SimdLevel::kAvx2) {
+    i = AnglesAvx2(dots, lengths, count, angles);
+  } else if (kSimdLevel == SimdLevel::kSse2) {
+    i = AnglesSse2(dots, lengths, count, angles);
+  }
+#elif defined(GEOMETRY_KERNELS_NEON)
+  i = AnglesNeon(dots, lengths, count, angles);
+#endif
+  for (; i < count; ++i) {
+    angles[i] =
+        lengths[i] > 0.0f ? FastAcos(dots[i] / std::sqrt(lengths[i])) : 0.0f;
+  }
+}
+
+void WeightedSum(const float *const vectors[3], const float *weights,
+                 const uint32_t *offsets, size_t segments,
+                 float *const sums[3]) {
+  size_t s = 0;
+#if defined(GEOMETRY_KERNELS_X86)
+  if (kSimdLevel == SimdLevel::kAvx2)
+    s = WeightedSumAvx2(vectors, weights, offsets, segments, sums);
+#endif
+  for (; s < segments; ++s) {
+    float sum[3] = {0.0f, 0.0f, 0.0f};
+    for (uint32_t e = offsets[s]; e < offsets[s + 1]; ++e) {
+      for (int k = 0; k < 3; ++k) sum[k] += vectors[k][e] * weights[e];
+    }
+    for (int k = 0; k < 3; ++k) sums[k][s] = sum[k];
+  }
+}
+
+}  // namespace data_representation
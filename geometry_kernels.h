@@ -0,0 +1,71 @@
+// Author: Marc Comino 2020
+
+#ifndef GEOMETRY_KERNELS_H_
+#define GEOMETRY_KERNELS_H_
+
+#include <stdint.h>
+
+#include <cstddef>
+
+namespace data_representation {
+
+// Vectors are given in structure of arrays form: v[0], v[1] and v[2] hold the
+// x, y and z components of count consecutive vectors. Every kernel uses AVX2
+// or SSE2 when the CPU supports them, NEON on AArch64, and a scalar loop
+// otherwise. Arrays need no particular alignment, and the result does not
+// depend on the instruction set chosen.
+
+/**
+ * @brief ExtendBounds Extends the box [min, max] to contain count packed xyz
+ * points.
+ */
+void ExtendBounds(const float *points, size_t count, float min[3],
+                  float max[3]);
+
+/**
+ * @brief Subtract out = a - b.
+ */
+void Subtract(const float *const a[3], const float *const b[3], size_t count,
+              float *const out[3]);
+
+/**
+ * @brief Cross out = a x b. out must not alias a or b.
+ */
+void Cross(const float *const a[3], const float *const b[3], size_t count,
+           float *const out[3]);
+
+/**
+ * @brief Dot out = a . b.
+ */
+void Dot(const float *const a[3], const float *const b[3], size_t count,
+         float *out);
+
+/**
+ * @brief Normalize Scales every vector to unit length in place. Vectors of
+ * zero length, or shorter than min_length, become zero.
+ */
+void Normalize(float *const v[3], size_t count, float min_length);
+
+/**
+ * @brief Angles The angle between pairs of vectors given their dot product
+ * and the product of their squared lengths, zero when a vector has no length.
+ * acos is approximated by a polynomial with an absolute error below 1e-7
+ * radians.
+ */
+void Angles(const float *dots, const float *lengths, size_t count,
+            float *angles);
+
+/**
+ * @brief WeightedSum Adds the weighted vectors of every segment in order:
+ * sums[s] is the sum of vectors[e] * weights[e] for e in
+ * [offsets[s], offsets[s + 1]). AVX2 walks eight segments at once with
+ * gathers, other instruction sets use the scalar loop.
+ * @param offsets segments + 1 offsets into vectors and weights.
+ */
+void WeightedSum(const float *const vectors[3], const float *weights,
+                 const uint32_t *offsets, size_t segments,
+                 float *const sums[3]);
+
+}  // namespace data_representation
+
+#endif  // GEOMETRY_KERNELS_H_
@@ -0,0 +1,653 @@
+// Author: Marc Comino 2020
+
+#include <glb_io.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "./json.h"
+#include "./mesh_processing.h"
+#include "./parallel.h"
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+namespace {
+
+const uint32_t kGlbMagic = 0x46546C67;  // "glTF"
+const uint32_t kGlbVersion = 2;
+const uint32_t kJsonChunk = 0x4E4F534A;  // "JSON"
+const uint32_t kBinChunk = 0x004E4942;   // "BIN\0"
+const size_t kGlbHeaderSize = 12;
+const size_t kChunkHeaderSize = 8;
+
+const int kByte = 5120;
+const int kUnsignedByte = 5121;
+const int kShort = 5122;
+const int kUnsignedShort = 5123;
+const int kUnsignedInt = 5125;
+const int kFloat = 5126;
+
+const int kTrianglesMode = 4;
+
+/**
+ * @brief kElementBlock Elements per task of the parallel passes.
+ */
+const size_t kElementBlock = 1 << 16;
+
+size_t ComponentSize(int type) {
+  switch (type) {
+    case kByte:
+    case kUnsignedByte:
+      return 1;
+    case kShort:
+    case kUnsignedShort:
+      return 2;
+    case kUnsignedInt:
+    case kFloat:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+int TypeComponents(const std::string &type) {
+  if (type == "SCALAR") return 1;
+  if (type == "VEC2") return 2;
+  if (type == "VEC3") return 3;
+  if (type == "VEC4") return 4;
+  return 0;
+}
+
+size_t ElementSize(const GlbAccessor &accessor) {
+  return ComponentSize(accessor.component_type) * accessor.components;
+}
+
+/**
+ * @brief End One past the last byte of the accessor.
+ */
+size_t End(const GlbAccessor &accessor) {
+  return accessor.offset + accessor.stride * (accessor.count - 1) +
+         ElementSize(accessor);
+}
+
+/**
+ * @brief ToIndex Converts a value that must be a non-negative integer.
+ */
+bool ToIndex(const JsonValue &value, size_t *index) {
+  if (value.type != JsonValue::Type::kNumber || !(value.number >= 0.0) ||
+      value.number > 9.0e15 || value.number != std::floor(value.number))
+    return false;
+  *index = static_cast<size_t>(value.number);
+  return true;
+}
+
+/**
+ * @brief ReadIndex Reads a member that must be a non-negative integer.
+ */
+bool ReadIndex(const JsonValue &object, const std::string &key,
+               size_t *value) {
+  const JsonValue *member = object.Find(key);
+  return member != nullptr && ToIndex(*member, value);
+}
+
+/**
+ * @brief ReadOptionalIndex Like ReadIndex, but a missing member takes the
+ * value fallback.
+ */
+bool ReadOptionalIndex(const JsonValue &object, const std::string &key,
+                       size_t fallback, size_t *value) {
+  *value = fallback;
+  return object.Find(key) == nullptr || ReadIndex(object, key, value);
+}
+
+/**
+ * @brief Item Returns item index of the array named key of root, or nullptr.
+ */
+const JsonValue *Item(const JsonValue &root, const std::string &key,
+                      size_t index) {
+  const JsonValue *array = root.Find(key);
+  if (array == nullptr || index >= array->Size()) return nullptr;
+  return &array->items[index];
+}
+
+/**
+ * @brief ResolveAccessor Locates accessor index inside the binary chunk,
+ * checking that all its elements lie within its buffer view.
+ */
+bool ResolveAccessor(const JsonValue &gltf, size_t index, size_t bin_size,
+                     GlbAccessor *accessor) {
+  const JsonValue *kAccessor = Item(gltf, "accessors", index);
+  size_t view_index, buffer_index, count, component_type;
+  if (kAccessor == nullptr || kAccessor->Find("sparse") != nullptr ||
+      !ReadIndex(*kAccessor, "bufferView", &view_index) ||
+      !ReadIndex(*kAccessor, "count", &count) ||
+      !ReadIndex(*kAccessor, "componentType", &component_type))
+    return false;
+
+  const JsonValue *kType = kAccessor->Find("type");
+  const JsonValue *kNormalized = kAccessor->Find("normalized");
+  accessor->component_type = static_cast<int>(component_type);
+  accessor->components =
+      kType != nullptr ? TypeComponents(kType->string) : 0;
+  accessor->normalized = kNormalized != nullptr && kNormalized->boolean;
+  accessor->count = count;
+  const size_t kElementSize = ElementSize(*accessor);
+  if (kElementSize == 0 || count == 0) return false;
+
+  // Only the binary chunk of the GLB, which is a buffer without uri.
+  const JsonValue *kView = Item(gltf, "bufferViews", view_index);
+  if (kView == nullptr || !ReadIndex(*kView, "buffer", &buffer_index))
+    return false;
+  const JsonValue *kBuffer = Item(gltf, "buffers", buffer_index);
+  if (buffer_index != 0 || kBuffer == nullptr ||
+      kBuffer->Find("uri") != nullptr)
+    return false;
+
+  size_t view_length, view_offset, offset;
+  if (!ReadIndex(*kView, "byteLength", &view_length) ||
+      !ReadOptionalIndex(*kView, "byteOffset", 0, &view_offset) ||
+      !ReadOptionalIndex(*kView, "byteStride", kElementSize,
+                         &accessor->stride) ||
+      !ReadOptionalIndex(*kAccessor, "byteOffset", 0, &offset))
+    return false;
+  if (accessor->stride < kElementSize || view_offset > bin_size ||
+      view_length > bin_size - view_offset || offset > view_length ||
+      count - 1 > (view_length - offset) / accessor->stride ||
+      offset + accessor->stride * (count - 1) + kElementSize > view_length)
+    return false;
+
+  accessor->offset = view_offset + offset;
+  accessor->present = true;
+  return true;
+}
+
+/**
+ * @brief ReadComponent Converts component i of an element to float, applying
+ * the normalization of integer types.
+ */
+float ReadComponent(const char *element, const GlbAccessor &accessor, int i) {
+  switch (accessor.component_type) {
+    case kFloat: {
+      float value;
+      memcpy(&value, element + i * 4, sizeof(value));
+      return value;
+    }
+    case kByte: {
+      const float kValue = static_cast<int8_t>(element[i]);
+      return accessor.normalized ? std::max(kValue / 127.0f, -1.0f) : kValue;
+    }
+    case kUnsignedByte: {
+      const float kValue = static_cast<uint8_t>(element[i]);
+      return accessor.normalized ? kValue / 255.0f : kValue;
+    }
+    case kShort: {
+      int16_t value;
+      memcpy(&value, element + i * 2, sizeof(value));
+      return accessor.normalized ? std::max(value / 32767.0f, -1.0f) : value;
+    }
+    case kUnsignedShort: {
+      uint16_t value;
+      memcpy(&value, element + i * 2, sizeof(value));
+      return accessor.normalized ? value / 65535.0f : value;
+    }
+    default: {
+      uint32_t value;
+      memcpy(&value, element + i * 4, sizeof(value));
+      return static_cast<float>(value);
+    }
+  }
+}
+
+uint32_t ReadIndexValue(const char *data, const GlbAccessor &indices,
+                        size_t i) {
+  const char *kElement = data + indices.offset + i * indices.stride;
+  switch (indices.component_type) {
+    case kUnsignedByte:
+      return static_cast<uint8_t>(*kElement);
+    case kUnsignedShort: {
+      uint16_t value;
+      memcpy(&value, kElement, sizeof(value));
+      return value;
+    }
+    default: {
+      uint32_t value;
+      memcpy(&value, kElement, sizeof(value));
+      return value;
+    }
+  }
+}
+
+/**
+ * @brief ValidIndices Whether every index references one of vertices.
+ */
+bool ValidIndices(const char *data, const GlbAccessor &indices,
+                  size_t vertices) {
+  const size_t kBlocks = (indices.count + kElementBlock - 1) / kElementBlock;
+  std::vector<char> valid(kBlocks, 1);
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kEnd = std::min(indices.count, (block + 1) * kElementBlock);
+    for (size_t i = block * kElementBlock; i < kEnd; ++i) {
+      if (ReadIndexValue(data, indices, i) >= vertices) {
+        valid[block] = 0;
+        return;
+      }
+    }
+  });
+  return std::find(valid.begin(), valid.end(), 0) == valid.end();
+}
+
+/**
+ * @brief NodeTransform The local transform of a node, given either as a matrix
+ * or as translation, rotation and scale.
+ */
+Eigen::Matrix4f NodeTransform(const JsonValue &node) {
+  Eigen::Matrix4f transform = Eigen::Matrix4f::Identity();
+  const JsonValue *kMatrix = node.Find("matrix");
+  if (kMatrix != nullptr && kMatrix->Size() == 16) {
+    for (int i = 0; i < 16; ++i)
+      transform(i % 4, i / 4) = static_cast<float>(kMatrix->items[i].number);
+    return transform;
+  }
+
+  const JsonValue *kTranslation = node.Find("translation");
+  const JsonValue *kRotation = node.Find("rotation");
+  const JsonValue *kScale = node.Find("scale");
+  if (kScale != nullptr && kScale->Size() == 3) {
+    for (int i = 0; i < 3; ++i)
+      transform(i, i) = static_cast<float>(kScale->items[i].number);
+  }
+  if (kRotation != nullptr && kRotation->Size() == 4) {
+    const Eigen::Quaternionf kQuaternion(
+        static_cast<float>(kRotation->items[3].number),
+        static_cast<float>(kRotation->items[0].number),
+        static_cast<float>(kRotation->items[1].number),
+        static_cast<float>(kRotation->items[2].number));
+    transform.topLeftCorner<3, 3>() =
+        kQuaternion.normalized().toRotationMatrix() *
+        transform.topLeftCorner<3, 3>();
+  }
+  if (kTranslation != nullptr && kTranslation->Size() == 3) {
+    for (int i = 0; i < 3; ++i)
+      transform(i, 3) = static_cast<float>(kTranslation->items[i].number);
+  }
+  return transform;
+}
+
+/**
+ * @brief SceneBuilder Walks the node hierarchy of the scene and resolves the
+ * triangle primitives of every mesh instance.
+ */
+class SceneBuilder {
+ public:
+  SceneBuilder(const JsonValue &gltf, const char *bin, size_t bin_size,
+               std::vector<GlbPrimitive> *primitives)
+      : gltf_(gltf), bin_(bin), bin_size_(bin_size), primitives_(primitives),
+        min_(Eigen::Vector3f::Constant(std::numeric_limits<float>::max())),
+        max_(-min_) {}
+
+  bool Build() {
+    const JsonValue *kNodes = gltf_.Find("nodes");
+    const size_t kNodeCount = kNodes != nullptr ? kNodes->Size() : 0;
+
+    std::vector<size_t> roots;
+    size_t scene = 0;
+    ReadIndex(gltf_, "scene", &scene);
+    const JsonValue *kScene = Item(gltf_, "scenes", scene);
+    const JsonValue *kSceneNodes =
+        kScene != nullptr ? kScene->Find("nodes") : nullptr;
+    if (kSceneNodes != nullptr) {
+      roots.resize(kSceneNodes->Size());
+      for (size_t i = 0; i < roots.size(); ++i)
+        if (!ToIndex(kSceneNodes->items[i], &roots[i])) return false;
+    } else if (kNodeCount > 0) {
+      // Without scenes, every node that is nobody's child is a root.
+      std::vector<bool> child(kNodeCount, false);
+      for (const JsonValue &node : kNodes->items) {
+        const JsonValue *kChildren = node.Find("children");
+        if (kChildren == nullptr) continue;
+        size_t index;
+        for (const JsonValue &value : kChildren->items)
+          if (ToIndex(value, &index) && index < kNodeCount) child[index] = true;
+      }
+      for (size_t i = 0; i < kNodeCount; ++i)
+        if (!child[i]) roots.push_back(i);
+    } else {
+      // Without nodes, every mesh is drawn untransformed.
+      const JsonValue *kMeshes = gltf_.Find("meshes");
+      const size_t kMeshCount = kMeshes != nullptr ? kMeshes->Size() : 0;
+      for (size_t i = 0; i < kMeshCount; ++i)
+        if (!AddMesh(i, Eigen::Matrix4f::Identity())) return false;
+      return true;
+    }
+
+    for (size_t root : roots)
+      if (!AddNode(root, Eigen::Matrix4f::Identity(), 0)) return false;
+    return true;
+  }
+
+  const Eigen::Vector3f &min() const { return min_; }
+  const Eigen::Vector3f &max() const { return max_; }
+
+ private:
+  bool AddNode(size_t index, const Eigen::Matrix4f &parent, size_t depth) {
+    const JsonValue *kNode = Item(gltf_, "nodes", index);
+    // The hierarchy is a forest, deeper paths can only come from cycles.
+    if (kNode == nullptr || depth > gltf_.Find("nodes")->Size()) return false;
+
+    const Eigen::Matrix4f kWorld = parent * NodeTransform(*kNode);
+    size_t mesh;
+    if (ReadIndex(*kNode, "mesh", &mesh) && !AddMesh(mesh, kWorld))
+      return false;
+
+    const JsonValue *kChildren = kNode->Find("children");
+    if (kChildren == nullptr) return true;
+    size_t child;
+    for (const JsonValue &value : kChildren->items) {
+      if (!ToIndex(value, &child) || !AddNode(child, kWorld, depth + 1))
+        return false;
+    }
+    return true;
+  }
+
+  bool AddMesh(size_t index, const Eigen::Matrix4f &world) {
+    const JsonValue *kMesh = Item(gltf_, "meshes", index);
+    const JsonValue *kPrimitives =
+        kMesh != nullptr ? kMesh->Find("primitives") : nullptr;
+    if (kPrimitives == nullptr) return false;
+
+    for (const JsonValue &primitive : kPrimitives->items) {
+      if (primitive.Number("mode", kTrianglesMode) != kTrianglesMode) continue;
+      const JsonValue *kAttributes = primitive.Find("attributes");
+      size_t position, normal, indices;
+      if (kAttributes == nullptr ||
+          !ReadIndex(*kAttributes, "POSITION", &position))
+        continue;
+
+      GlbPrimitive result;
+      if (!ResolveAccessor(gltf_, position, bin_size_, &result.positions) ||
+          result.positions.components != 3)
+        return false;
+      const size_t kVertices = result.positions.count;
+
+      if (ReadIndex(*kAttributes, "NORMAL", &normal) &&
+          (!ResolveAccessor(gltf_, normal, bin_size_, &result.normals) ||
+           result.normals.components != 3 ||
+           result.normals.count != kVertices))
+        return false;
+
+      if (ReadIndex(primitive, "indices", &indices)) {
+        GlbAccessor &accessor = result.indices;
+        if (!ResolveAccessor(gltf_, indices, bin_size_, &accessor) ||
+            accessor.components != 1 ||
+            (accessor.component_type != kUnsignedByte &&
+             accessor.component_type != kUnsignedShort &&
+             accessor.component_type != kUnsignedInt) ||
+            !ValidIndices(bin_, accessor, kVertices))
+          return false;
+        accessor.count -= accessor.count % 3;
+        if (accessor.count == 0) continue;
+      } else if (kVertices < 3) {
+        continue;
+      }
+
+      Eigen::Map<Eigen::Matrix4f>(result.transform) = world;
+      AddBounds(primitive, result);
+      primitives_->push_back(result);
+    }
+    return true;
+  }
+
+  /**
+   * @brief AddBounds Grows the scene bounds with the transformed corners of
+   * the primitive box, taken from the accessor or, lacking it, computed.
+   */
+  void AddBounds(const JsonValue &primitive, const GlbPrimitive &result) {
+    const size_t kPosition = static_cast<size_t>(
+        primitive.Find("attributes")->Number("POSITION", 0));
+    const JsonValue *kAccessor = Item(gltf_, "accessors", kPosition);
+    const JsonValue *kMin = kAccessor->Find("min");
+    const JsonValue *kMax = kAccessor->Find("max");
+
+    Eigen::Vector3f min, max;
+    if (kMin != nullptr && kMax != nullptr && kMin->Size() == 3 &&
+        kMax->Size() == 3 && !result.positions.normalized) {
+      for (int i = 0; i < 3; ++i) {
+        min[i] = static_cast<float>(kMin->items[i].number);
+        max[i] = static_cast<float>(kMax->items[i].number);
+      }
+    } else {
+      min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+      max = -min;
+      const GlbAccessor &kPositions = result.positions;
+      for (size_t i = 0; i < kPositions.count; ++i) {
+        const char *kElement = bin_ + kPositions.offset + i * kPositions.stride;
+        for (int j = 0; j < 3; ++j) {
+          const float kValue = ReadComponent(kElement, kPositions, j);
+          min[j] = std::min(min[j], kValue);
+          max[j] = std::max(max[j], kValue);
+        }
+      }
+    }
+
+    const Eigen::Map<const Eigen::Matrix4f> kWorld(result.transform);
+    for (int corner = 0; corner < 8; ++corner) {
+      const Eigen::Vector4f kPoint(corner & 1 ? max[0] : min[0],
+                                   corner & 2 ? max[1] : min[1],
+                                   corner & 4 ? max[2] : min[2], 1.0f);
+      const Eigen::Vector3f kWorldPoint = (kWorld * kPoint).head<3>();
+      min_ = min_.cwiseMin(kWorldPoint);
+      max_ = max_.cwiseMax(kWorldPoint);
+    }
+  }
+
+  const JsonValue &gltf_;
+  const char *bin_;
+  size_t bin_size_;
+  std::vector<GlbPrimitive> *primitives_;
+  Eigen::Vector3f min_;
+  Eigen::Vector3f max_;
+};
+
+bool Aliasable(const GlbPrimitive &primitive) {
+  const GlbAccessor &kPositions = primitive.positions;
+  const GlbAccessor &kNormals = primitive.normals;
+  const GlbAccessor &kIndices = primitive.indices;
+  return kPositions.component_type == kFloat && kPositions.stride % 4 == 0 &&
+         kPositions.offset % 4 == 0 && kNormals.present &&
+         kNormals.component_type == kFloat && kNormals.stride % 4 == 0 &&
+         kNormals.offset % 4 == 0 && kIndices.present &&
+         kIndices.stride == ComponentSize(kIndices.component_type) &&
+         kIndices.offset % kIndices.stride == 0;
+}
+
+}  // namespace
+
+GlbFile::GlbFile()
+    : data_(nullptr),
+      size_(0),
+      aliasable_(false),
+      vertex_count_(0),
+      triangle_count_(0) {}
+
+bool GlbFile::Open(const std::string &filename) {
+  Close();
+  const auto kStart = std::chrono::steady_clock::now();
+  if (!file_.Open(filename)) return false;
+
+  const char *kFile = file_.data();
+  const size_t kSize = file_.size();
+  uint32_t header[3], json_header[2];
+  if (kSize < kGlbHeaderSize + kChunkHeaderSize) return false;
+  memcpy(header, kFile, sizeof(header));
+  memcpy(json_header, kFile + kGlbHeaderSize, sizeof(json_header));
+  if (header[0] != kGlbMagic || header[1] != kGlbVersion ||
+      json_header[1] != kJsonChunk ||
+      json_header[0] > kSize - kGlbHeaderSize - kChunkHeaderSize) {
+    std::cout << "\tNot a glTF 2.0 binary file" << std::endl;
+    return false;
+  }
+
+  const char *kJson = kFile + kGlbHeaderSize + kChunkHeaderSize;
+  const char *kJsonEnd = kJson + json_header[0];
+  JsonValue gltf;
+  if (!ParseJson(kJson, kJsonEnd, &gltf)) {
+    std::cout << "\tError parsing the JSON chunk" << std::endl;
+    return false;
+  }
+
+  // The binary chunk is optional, and always follows the JSON one.
+  const char *bin = nullptr;
+  size_t bin_size = 0;
+  const size_t kJsonPadded = (json_header[0] + 3) & ~size_t(3);
+  const size_t kBinHeader = kGlbHeaderSize + kChunkHeaderSize + kJsonPadded;
+  if (kSize >= kBinHeader + kChunkHeaderSize) {
+    uint32_t bin_header[2];
+    memcpy(bin_header, kFile + kBinHeader, sizeof(bin_header));
+    if (bin_header[1] == kBinChunk &&
+        bin_header[0] <= kSize - kBinHeader - kChunkHeaderSize) {
+      bin = kFile + kBinHeader + kChunkHeaderSize;
+      bin_size = bin_header[0];
+    }
+  }
+
+  SceneBuilder builder(gltf, bin, bin_size, &primitives_);
+  if (bin == nullptr || !builder.Build() || primitives_.empty()) {
+    std::cout << "\tError resolving the mesh primitives" << std::endl;
+    Close();
+    return false;
+  }
+  min_ = builder.min();
+  max_ = builder.max();
+
+  // Rebase the accessors on the span they reference, keeping 4-byte offsets
+  // 4-byte aligned.
+  size_t begin = bin_size, end = 0;
+  for (const GlbPrimitive &primitive : primitives_) {
+    for (const GlbAccessor *accessor :
+         {&primitive.positions, &primitive.normals, &primitive.indices}) {
+      if (!accessor->present) continue;
+      begin = std::min(begin, accessor->offset);
+      end = std::max(end, End(*accessor));
+    }
+  }
+  begin &= ~size_t(3);
+  data_ = bin + begin;
+  size_ = end - begin;
+
+  aliasable_ = true;
+  for (GlbPrimitive &primitive : primitives_) {
+    for (GlbAccessor *accessor :
+         {&primitive.positions, &primitive.normals, &primitive.indices})
+      if (accessor->present) accessor->offset -= begin;
+    aliasable_ = aliasable_ && Aliasable(primitive);
+    vertex_count_ += primitive.positions.count;
+    triangle_count_ += (primitive.indices.present ? primitive.indices.count
+                                                  : primitive.positions.count) /
+                       3;
+  }
+
+  const double kSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - kStart)
+                              .count();
+  std::cout << "Loading triangle mesh" << std::endl;
+  std::cout << "\tPrimitives = " << primitives_.size() << " ("
+            << (aliasable_ ? "aliased" : "copied") << ")" << std::endl;
+  std::cout << "\tVertices = " << vertex_count_ << std::endl;
+  std::cout << "\tFaces = " << triangle_count_ << std::endl;
+  std::cout << "\tRead GLB in " << kSeconds * 1000.0 << " ms" << std::endl;
+  return true;
+}
+
+void GlbFile::Close() {
+  file_.Close();
+  data_ = nullptr;
+  size_ = 0;
+  aliasable_ = false;
+  vertex_count_ = 0;
+  triangle_count_ = 0;
+  primitives_.clear();
+}
+
+bool GlbFile::ToTriangleMesh(TriangleMesh *mesh) const {
+  if (vertex_count_ > static_cast<size_t>(std::numeric_limits<int>::max()) ||
+      triangle_count_ * 3 >
+          static_cast<size_t>(std::numeric_limits<int>::max()))
+    return false;
+
+  // A reused mesh must not keep the colors, levels or bounds of the last
+  // model.
+  mesh->Clear();
+  mesh->vertices_.resize(vertex_count_ * 3);
+  mesh->normals_.resize(vertex_count_ * 3);
+  mesh->faces_.resize(triangle_count_ * 3);
+
+  bool all_normals = true;
+  size_t first_vertex = 0, first_index = 0;
+  for (const GlbPrimitive &primitive : primitives_) {
+    const GlbAccessor &kPositions = primitive.positions;
+    const GlbAccessor &kNormals = primitive.normals;
+    const GlbAccessor &kIndices = primitive.indices;
+    const Eigen::Map<const Eigen::Matrix4f> kWorld(primitive.transform);
+    const Eigen::Matrix3f kNormalMatrix =
+        kWorld.topLeftCorner<3, 3>().inverse().transpose();
+    all_normals = all_normals && kNormals.present;
+
+    float *vertices = &mesh->vertices_[first_vertex * 3];
+    float *normals = &mesh->normals_[first_vertex * 3];
+    ParallelForRange(
+        0, kPositions.count, kElementBlock, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            const char *kElement =
+                data_ + kPositions.offset + i * kPositions.stride;
+            Eigen::Vector4f point(0.0f, 0.0f, 0.0f, 1.0f);
+            for (int j = 0; j < 3; ++j)
+              point[j] = ReadComponent(kElement, kPositions, j);
+            Eigen::Map<Eigen::Vector3f>(vertices + i * 3) =
+                (kWorld * point).head<3>();
+            if (!kNormals.present) continue;
+
+            kElement = data_ + kNormals.offset + i * kNormals.stride;
+            Eigen::Vector3f normal;
+            for (int j = 0; j < 3; ++j)
+              normal[j] = ReadComponent(kElement, kNormals, j);
+            Eigen::Map<Eigen::Vector3f>(normals + i * 3) =
+                (kNormalMatrix * normal).normalized();
+          }
+        });
+
+    // Primitives without indices list their vertices in order.
+    const size_t kCorners = kIndices.present ? kIndices.count
+                                             : kPositions.count / 3 * 3;
+    int *faces = &mesh->faces_[first_index];
+    ParallelForRange(0, kCorners, kElementBlock, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        const size_t kIndex =
+            kIndices.present ? ReadIndexValue(data_, kIndices, i) : i;
+        faces[i] = static_cast<int>(first_vertex + kIndex);
+      }
+    });
+    first_vertex += kPositions.count;
+    first_index += kCorners;
+  }
+
+  if (!all_normals) {
+    mesh->normals_.clear();
+    ComputeVertexNormals(mesh->vertices_, mesh->faces_, &mesh->normals_);
+    std::cout << "\tGenerated normals " << std::endl;
+  }
+  ComputeBoundingBox(mesh->vertices_, mesh);
+  mesh->prepareVertexBuffer();
+  std::cout << "\tPrepared vertex buffer " << std::endl;
+  return true;
+}
+
+}  // namespace data_representation
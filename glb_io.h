@@ -0,0 +1,129 @@
+// Author: Marc Comino 2020
+
+#ifndef GLB_IO_H_
+#define GLB_IO_H_
+
+#include <triangle_mesh.h>
+
+#include <stddef.h>
+
+#include <eigen3/Eigen/Geometry>
+#include <string>
+#include <vector>
+
+#include "./mapped_file.h"
+
+namespace data_representation {
+
+/**
+ * @brief GlbAccessor Where the elements of a glTF accessor are stored. Offsets
+ * are relative to GlbFile::data(). component_type keeps the glTF value, which
+ * is the OpenGL enum of the same type.
+ */
+struct GlbAccessor {
+  bool present = false;
+  size_t offset = 0;
+  size_t stride = 0;
+  size_t count = 0;
+  int component_type = 0;
+  int components = 0;
+  bool normalized = false;
+};
+
+/**
+ * @brief GlbPrimitive A triangle list of one mesh instance of the scene.
+ */
+struct GlbPrimitive {
+  GlbAccessor positions;
+  GlbAccessor normals;
+  GlbAccessor indices;
+
+  /**
+   * @brief transform Column-major world transform of the node that
+   * instantiates the mesh.
+   */
+  float transform[16];
+};
+
+/**
+ * @brief GlbFile A binary glTF 2.0 file mapped in memory. The primitives of all
+ * the meshes of the default scene reference the binary chunk in place, so
+ * their attributes and indices can be handed to OpenGL without being copied.
+ */
+class GlbFile {
+ public:
+  GlbFile();
+
+  GlbFile(const GlbFile &) = delete;
+  GlbFile &operator=(const GlbFile &) = delete;
+
+  /**
+   * @brief Open Maps the file, parses its JSON chunk and resolves the
+   * triangle primitives of the scene. Points, lines and strips are skipped.
+   * Buffers other than the binary chunk and sparse accessors are not
+   * supported.
+   * @param filename The path to the GLB file.
+   * @return Whether it is a valid GLB file with at least one triangle.
+   */
+  bool Open(const std::string &filename);
+
+  /**
+   * @brief Close Unmaps the file.
+   */
+  void Close();
+
+  /**
+   * @brief aliasable Whether every primitive can be drawn straight from
+   * data(): float positions and normals, and unsigned indices.
+   */
+  bool aliasable() const { return aliasable_; }
+
+  /**
+   * @brief data The span of the binary chunk referenced by the primitives,
+   * starting at a 4-byte aligned offset of the chunk.
+   */
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+  const std::vector<GlbPrimitive> &primitives() const { return primitives_; }
+
+  /**
+   * @brief vertex_count Vertices of all primitives, instances included.
+   */
+  size_t vertex_count() const { return vertex_count_; }
+
+  /**
+   * @brief triangle_count Triangles of all primitives, instances included.
+   */
+  size_t triangle_count() const { return triangle_count_; }
+
+  /**
+   * @brief min World space bounding box of the scene.
+   */
+  const Eigen::Vector3f &min() const { return min_; }
+  const Eigen::Vector3f &max() const { return max_; }
+
+  /**
+   * @brief ToTriangleMesh Copies every primitive, transformed to world space,
+   * into a single mesh. It is the path for files that are not aliasable.
+   * Normals are computed for the whole mesh when a primitive has none.
+   * @param mesh The resulting representation with per-vertex normals.
+   * @return Whether the copy succeeded.
+   */
+  bool ToTriangleMesh(TriangleMesh *mesh) const;
+
+ private:
+  MappedFile file_;
+  const char *data_;
+  size_t size_;
+  bool aliasable_;
+  size_t vertex_count_;
+  size_t triangle_count_;
+  Eigen::Vector3f min_;
+  Eigen::Vector3f max_;
+  std::vector<GlbPrimitive> primitives_;
+};
+
+}  // namespace data_representation
+
+#endif  // GLB_IO_H_
@@ -8,9 +8,12 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
 
-#include "./mesh_io.h"
+#include "./glb_io.h"
+#include "./model_loader.h"
 #include "./triangle_mesh.h"
+#include "./vertex_buffer.h"
 
 namespace {
 
@@ -18,6 +21,18 @@ const double kFieldOfView = 60;
 const double kZNear = 0.0001;
 const double kZFar = 10;
 
+/**
+ * @brief kLodPixelError Screen space error in pixels that a level of detail
+ * may have.
+ */
+const double kLodPixelError = 1.0;
+
+/**
+ * @brief kLodHysteresis Fraction of kLodPixelError below which the error of
+ * a coarser level must project before it replaces the one drawn.
+ */
+const double kLodHysteresis = 0.75;
+
 const char kReflectionVertexShaderFile[] = "../shaders/reflection.vert";
 const char kReflectionFragmentShaderFile[] = "../shaders/reflection.frag";
 const char kBRDFVertexShaderFile[] = "../shaders/brdf.vert";
@@ -119,65 +134,413 @@ bool LoadProgram(const std::string &vertex, const std::string &fragment,
   return res;
 }
 
+/**
+ * @brief SetAttributePointer Points a vertex attribute at values of the given
+ * format in the bound vertex buffer.
+ */
+void SetAttributePointer(GLuint index, data_representation::VertexFormat format,
+                         GLsizei stride, GLintptr offset) {
+  switch (format) {
+    case data_representation::VertexFormat::kFloat3:
+      glVertexAttribPointer(index, 3, GL_FLOAT, GL_FALSE, stride,
+                            (void *)offset);
+      break;
+    case data_representation::VertexFormat::kHalf3:
+      glVertexAttribPointer(index, 3, GL_HALF_FLOAT, GL_FALSE, stride,
+                            (void *)offset);
+      break;
+    case data_representation::VertexFormat::kUnorm16x3:
+      glVertexAttribPointer(index, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                            (void *)offset);
+      break;
+    case data_representation::VertexFormat::kSnorm10x3:
+      // Packed formats always have four components, w is zero here.
+      glVertexAttribPointer(index, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride,
+                            (void *)offset);
+      break;
+  }
+}
+
+/**
+ * @brief CacheRatio Formats a ratio measured on an index buffer, preceded by
+ * the ratio before the loader reordered it when it did. Zero ratios were not
+ * measured.
+ */
+QString CacheRatio(double input, double ratio) {
+  if (ratio == 0.0) return "-";
+  if (input == 0.0) return QString::number(ratio, 'f', 2);
+  return QString::number(input, 'f', 2) + " -> " +
+         QString::number(ratio, 'f', 2);
+}
+
 }  // namespace
 
 GLWidget::GLWidget(QWidget *parent)
     : QGLWidget(parent),
+      modelVAO(0),
+      modelVBO(0),
+      modelEBO(0),
+      lod_level_(0),
+      model_generation_(0),
+      stream_vbo_(0),
+      stream_ebo_(0),
+      position_format_(data_representation::VertexFormat::kFloat3),
+      normal_format_(data_representation::VertexFormat::kFloat3),
+      arrangement_(data_representation::VertexArrangement::kInterleaved),
       initialized_(false),
       width_(0.0),
       height_(0.0),
       reflection_(true),
       fresnel_(0.2, 0.2, 0.2) {
   setFocusPolicy(Qt::StrongFocus);
+
+  // The loader thread reports through signals, which Qt queues to this
+  // widget's thread.
+  connect(this, &GLWidget::ModelRead, this, &GLWidget::FinishLoad,
+          Qt::QueuedConnection);
+  connect(this, &GLWidget::WindowRead, this, &GLWidget::DrainStream,
+          Qt::QueuedConnection);
+  connect(this, &GLWidget::LodsRead, this, &GLWidget::FinishLods,
+          Qt::QueuedConnection);
+  loader_ = std::make_unique<data_representation::ModelLoader>(
+      [this](unsigned, const std::string &stage) {
+        emit SetProgress(QString(stage.c_str()));
+      },
+      [this](unsigned generation, bool success) {
+        emit ModelRead(generation, success);
+      },
+      [this](unsigned generation) { emit WindowRead(generation); },
+      [this](unsigned generation) { emit LodsRead(generation); });
 }
 
 GLWidget::~GLWidget() {
+  // Stop the loader first, its callbacks use the widget.
+  loader_.reset();
+  if (modelVAO != 0) {
+    glDeleteVertexArrays(1, &modelVAO);
+    glDeleteBuffers(1, &modelVBO);
+    glDeleteBuffers(1, &modelEBO);
+  }
+  if (stream_vbo_ != 0) {
+    glDeleteBuffers(1, &stream_vbo_);
+    glDeleteBuffers(1, &stream_ebo_);
+  }
   if (initialized_) {
     glDeleteTextures(1, &specular_map_);
     glDeleteTextures(1, &diffuse_map_);
   }
 }
 
-bool GLWidget::LoadModel(const QString &filename) {
+bool GLWidget::LoadModel(
+    const QString &filename, data_representation::NormalPolicy normals,
+    const data_representation::MeshOptimization &optimization) {
   std::string file = filename.toUtf8().constData();
   size_t pos = file.find_last_of(".");
   std::string type = file.substr(pos + 1);
+  if (pos == std::string::npos ||
+      (type.compare("ply") != 0 && type.compare("obj") != 0 &&
+       type.compare("stl") != 0 && type.compare("glb") != 0 &&
+       type.compare("qmesh") != 0)) {
+    std::cerr << "ERROR loading model " + file << std::endl;
+    return false;
+  }
 
+  loading_filename_ = filename;
+  loader_->Load(file, normals, optimization);
+  return true;
+}
+
+void GLWidget::SetVertexLayout(
+    data_representation::VertexFormat position,
+    data_representation::VertexFormat normal,
+    data_representation::VertexArrangement arrangement) {
+  position_format_ = position;
+  normal_format_ = normal;
+  arrangement_ = arrangement;
+  if (mesh_ == nullptr || mesh_->vertex_count() == 0) return;
+
+  makeCurrent();
+  UploadMesh(*mesh_);
+  SelectLod(lod_level_);
+  updateGL();
+}
+
+void GLWidget::FinishLoad(unsigned generation, bool success) {
+  if (!loader_->current(generation)) return;
+  if (!success) {
+    emit SetProgress("Failed");
+    emit LoadFailed(loading_filename_);
+    return;
+  }
+  std::unique_ptr<data_representation::LoadedModel> loaded =
+      loader_->Take(generation);
+  if (loaded == nullptr) return;
+
+  makeCurrent();
   std::unique_ptr<data_representation::TriangleMesh> mesh =
       std::make_unique<data_representation::TriangleMesh>();
+  size_t faces = 0, vertices = 0;
+  model_lods_.clear();
+  switch (loaded->source) {
+    case data_representation::LoadedModel::Source::kCache:
+      mesh->min_ = loaded->cache.min();
+      mesh->max_ = loaded->cache.max();
+      UploadModel(loaded->cache.vertex_buffer(),
+                  loaded->cache.vertex_buffer_size() * sizeof(float),
+                  data_representation::kInterleavedLayout,
+                  Eigen::Matrix4f::Identity(), loaded->cache.indices(),
+                  loaded->cache.index_count());
+      model_lods_ = loaded->cache.lods();
+      faces = loaded->cache.index_count() / 3;
+      vertices = loaded->cache.vertex_count();
+      break;
+    case data_representation::LoadedModel::Source::kGlb:
+      mesh->min_ = loaded->glb.min();
+      mesh->max_ = loaded->glb.max();
+      UploadGlb(loaded->glb);
+      faces = loaded->glb.triangle_count();
+      vertices = loaded->glb.vertex_count();
+      break;
+    case data_representation::LoadedModel::Source::kMesh:
+      mesh = std::move(loaded->mesh);
+      UploadMesh(*mesh);
+      model_lods_ = mesh->lods_;
+      faces = mesh->triangle_count();
+      vertices = mesh->vertex_count();
+      break;
+    case data_representation::LoadedModel::Source::kStream:
+      DrainStream(generation);
+      mesh->min_ = loaded->stream.min;
+      mesh->max_ = loaded->stream.max;
+      UseStreamedModel(loaded->stream.triangle_count * 3);
+      faces = loaded->stream.triangle_count;
+      vertices = loaded->stream.vertex_count;
+      break;
+  }
+  mesh_.reset(mesh.release());
+  model_generation_ = generation;
+  camera_.UpdateModel(mesh_->min_, mesh_->max_);
+  // The index buffer holds every level, the full one is drawn first.
+  if (!model_lods_.empty()) faces = model_lods_[0].index_count / 3;
+  SelectLod(0);
+
+  emit SetFaces(QString(std::to_string(faces).c_str()));
+  emit SetVertices(QString(std::to_string(vertices).c_str()));
+  emit SetAcmr(CacheRatio(loaded->vertex_cache_input.acmr,
+                          loaded->vertex_cache.acmr));
+  emit SetAtvr(CacheRatio(loaded->vertex_cache_input.atvr,
+                          loaded->vertex_cache.atvr));
+  emit SetOverfetch(CacheRatio(loaded->vertex_cache_input.overfetch,
+                               loaded->vertex_cache.overfetch));
+  emit SetOverdraw(CacheRatio(loaded->overdraw_input, loaded->overdraw));
+  emit SetProgress("Ready");
+  std::cerr << "Model loaded " + loaded->filename << std::endl;
+  updateGL();
+}
+
+void GLWidget::FinishLods(unsigned generation) {
+  if (generation != model_generation_ || mesh_ == nullptr) return;
+  std::unique_ptr<data_representation::LoadedLods> lods =
+      loader_->TakeLods(generation);
+  if (lods == nullptr) return;
+
+  // The vertex buffer already holds every vertex the levels use, only the
+  // index buffer grows.
+  makeCurrent();
+  mesh_->faces_.swap(lods->faces);
+  mesh_->lods_.swap(lods->lods);
+  model_lods_ = mesh_->lods_;
+  glBindVertexArray(modelVAO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh_->faces_.size() * sizeof(int),
+               mesh_->faces_.data(), GL_STATIC_DRAW);
+  glBindVertexArray(0);
+  SelectLod(0);
+  updateGL();
+}
+
+void GLWidget::UploadModel(const void *vertices, size_t vertex_bytes,
+                           const data_representation::VertexLayout &layout,
+                           const Eigen::Matrix4f &dequantization,
+                           const int *indices, size_t index_count) {
+  if (modelVAO == 0) {
+    glGenVertexArrays(1, &modelVAO);
+    glGenBuffers(1, &modelVBO);
+    glGenBuffers(1, &modelEBO);
+  }
+  glBindVertexArray(modelVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
+  glBufferData(GL_ARRAY_BUFFER, vertex_bytes, vertices, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(kVertexAttributeIdx);
+  glEnableVertexAttribArray(kNormalAttributeIdx);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(int), indices,
+               GL_STATIC_DRAW);
+  glBindVertexArray(0);
+  SetModelRange(layout, dequantization, index_count);
+}
+
+void GLWidget::UploadMesh(const data_representation::TriangleMesh &mesh) {
+  const size_t kVertices = mesh.vertex_count();
+  const data_representation::VertexLayout kLayout =
+      data_representation::MakeVertexLayout(position_format_, normal_format_,
+                                            arrangement_, kVertices);
+  const bool kFloat =
+      position_format_ == data_representation::VertexFormat::kFloat3 &&
+      normal_format_ == data_representation::VertexFormat::kFloat3 &&
+      arrangement_ == data_representation::VertexArrangement::kInterleaved;
+
+  // The float interleaved layout is the mesh buffer itself.
+  std::vector<unsigned char> encoded;
+  Eigen::Matrix4f dequantization = Eigen::Matrix4f::Identity();
+  if (!kFloat) dequantization = mesh.EncodeVertexBuffer(kLayout, &encoded);
+  const size_t kBytes = data_representation::VertexBufferSize(kLayout,
+                                                              kVertices);
+  std::cout << "Model has " << kVertices << " vertices in "
+            << kBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+  UploadModel(kFloat ? static_cast<const void *>(mesh.buffer_.data())
+                     : static_cast<const void *>(encoded.data()),
+              kBytes, kLayout, dequantization, mesh.faces_.data(),
+              mesh.faces_.size());
+}
 
-  bool res = false;
-  if (type.compare("ply") == 0) {
-    res = data_representation::ReadFromPly(file, mesh.get());
+void GLWidget::SetModelRange(const data_representation::VertexLayout &layout,
+                             const Eigen::Matrix4f &dequantization,
+                             size_t index_count) {
+  DrawRange range;
+  range.position_format = layout.position.format;
+  range.position_offset = layout.position.offset;
+  range.position_stride = static_cast<GLsizei>(layout.position.stride);
+  range.normal_format = layout.normal.format;
+  range.normal_offset = layout.normal.offset;
+  range.normal_stride = static_cast<GLsizei>(layout.normal.stride);
+  range.index_type = GL_UNSIGNED_INT;
+  range.index_offset = 0;
+  range.index_count = static_cast<GLsizei>(index_count);
+  range.transform.setIdentity();
+  range.dequantization = dequantization;
+  model_ranges_.assign(1, range);
+}
+
+void GLWidget::SelectLod(size_t level) {
+  lod_level_ = level;
+  if (model_lods_.empty()) {
+    emit SetLod("-");
+    return;
   }
-  std::cout << "..................." << std::endl;
-  if (res) {
-    mesh_.reset(mesh.release());
-    camera_.UpdateModel(mesh_->min_, mesh_->max_);
-    std::cout << "Model has " <<  mesh_->buffer_.size() << " elements in buffer" << std::endl;
-    // TODO(students): Create / Initialize buffers.
+  const data_representation::MeshLod &kLod = model_lods_[level];
+  model_ranges_[0].index_offset =
+      static_cast<GLintptr>(kLod.first_index * sizeof(int));
+  model_ranges_[0].index_count = static_cast<GLsizei>(kLod.index_count);
+  emit SetLod(QString((std::to_string(level) + " (" +
+                       std::to_string(kLod.index_count / 3) + ")")
+                          .c_str()));
+}
+
+void GLWidget::UpdateLod() {
+  if (model_lods_.empty()) return;
+  const double kPixels = camera_.ProjectedSize(1.0);
+  size_t level = lod_level_;
+  while (level > 0 && model_lods_[level].error * kPixels > kLodPixelError)
+    --level;
+  while (level + 1 < model_lods_.size() &&
+         model_lods_[level + 1].error * kPixels <=
+             kLodPixelError * kLodHysteresis)
+    ++level;
+  if (level != lod_level_) SelectLod(level);
+}
+
+void GLWidget::DrainStream(unsigned generation) {
+  makeCurrent();
+  data_representation::StreamWindow window;
+  while (loader_->TakeWindow(generation, &window)) {
+    switch (window.kind) {
+      case data_representation::StreamWindow::Kind::kBegin:
+        if (stream_vbo_ == 0) {
+          glGenBuffers(1, &stream_vbo_);
+          glGenBuffers(1, &stream_ebo_);
+        }
+        // The copy target does not disturb the bindings of the model VAO.
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream_vbo_);
+        glBufferData(GL_COPY_WRITE_BUFFER, window.vertex_bytes, nullptr,
+                     GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream_ebo_);
+        glBufferData(GL_COPY_WRITE_BUFFER, window.index_bytes, nullptr,
+                     GL_STATIC_DRAW);
+        break;
+      case data_representation::StreamWindow::Kind::kVertices:
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream_vbo_);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, window.offset,
+                        window.data.size(), window.data.data());
+        break;
+      case data_representation::StreamWindow::Kind::kIndices:
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream_ebo_);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, window.offset,
+                        window.data.size(), window.data.data());
+        break;
+    }
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GLWidget::UseStreamedModel(size_t index_count) {
+  if (modelVAO == 0) {
     glGenVertexArrays(1, &modelVAO);
     glGenBuffers(1, &modelVBO);
     glGenBuffers(1, &modelEBO);
-    glBindVertexArray(modelVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
-    glBufferData(GL_ARRAY_BUFFER, mesh_->buffer_.size()* sizeof(float), &mesh_->buffer_[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh_->faces_.size() * sizeof(int), &mesh_->faces_[0], GL_STATIC_DRAW);
-    // END.
+  }
+  std::swap(modelVBO, stream_vbo_);
+  std::swap(modelEBO, stream_ebo_);
+
+  glBindVertexArray(modelVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
+  glEnableVertexAttribArray(kVertexAttributeIdx);
+  glEnableVertexAttribArray(kNormalAttributeIdx);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelEBO);
+  glBindVertexArray(0);
+  SetModelRange(data_representation::kInterleavedLayout,
+                Eigen::Matrix4f::Identity(), index_count);
+
+  // Free the previous model, its buffers are reused by the next stream.
+  glBindBuffer(GL_COPY_WRITE_BUFFER, stream_vbo_);
+  glBufferData(GL_COPY_WRITE_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, stream_ebo_);
+  glBufferData(GL_COPY_WRITE_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
 
-    emit SetFaces(QString(std::to_string(mesh_->faces_.size() / 3).c_str()));
-    emit SetVertices(
-        QString(std::to_string(mesh_->vertices_.size() / 3).c_str()));
-    std::cerr << "Model loaded " + file << std::endl;
-    return true;
+void GLWidget::UploadGlb(const data_representation::GlbFile &glb) {
+  if (modelVAO == 0) {
+    glGenVertexArrays(1, &modelVAO);
+    glGenBuffers(1, &modelVBO);
+    glGenBuffers(1, &modelEBO);
+  }
+  glBindVertexArray(modelVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
+  glBufferData(GL_ARRAY_BUFFER, glb.size(), glb.data(), GL_STATIC_DRAW);
+  glEnableVertexAttribArray(kVertexAttributeIdx);
+  glEnableVertexAttribArray(kNormalAttributeIdx);
+  // Indices are read from the same buffer, where the file put them.
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelVBO);
+  glBindVertexArray(0);
+
+  model_ranges_.clear();
+  for (const data_representation::GlbPrimitive &primitive : glb.primitives()) {
+    DrawRange range;
+    range.position_format = data_representation::VertexFormat::kFloat3;
+    range.position_offset = primitive.positions.offset;
+    range.position_stride = static_cast<GLsizei>(primitive.positions.stride);
+    range.normal_format = data_representation::VertexFormat::kFloat3;
+    range.normal_offset = primitive.normals.offset;
+    range.normal_stride = static_cast<GLsizei>(primitive.normals.stride);
+    // glTF component types are the OpenGL enums.
+    range.index_type = static_cast<GLenum>(primitive.indices.component_type);
+    range.index_offset = primitive.indices.offset;
+    range.index_count = static_cast<GLsizei>(primitive.indices.count);
+    range.transform = Eigen::Map<const Eigen::Matrix4f>(primitive.transform);
+    range.dequantization.setIdentity();
+    model_ranges_.push_back(range);
   }
-  std::cerr << "ERROR loading model " + file << std::endl;
-  return false;
 }
 
 bool GLWidget::LoadSpecularMap(const QString &dir) {
@@ -305,8 +668,10 @@ void GLWidget::initializeGL() {
 
   loadCubemapFileHDR("../textures/Tropical_Beach/Tropical_Beach_3k.hdr");
 
-  LoadModel("../models/sphere.ply");
-  std::cerr << "Default model loaded OK" << std::endl;
+  LoadModel("../models/sphere.ply",
+            data_representation::NormalPolicy::kWhenMissing,
+            data_representation::MeshOptimization());
+  std::cerr << "Default model requested" << std::endl;
 }
 bool GLWidget::loadCubemapFileHDR(const QString &path)
 {
@@ -699,8 +1064,9 @@ void GLWidget::paintGL() {
     normal = normal.inverse().transpose();
 
     if (mesh_ != nullptr) {
+      UpdateLod();
       GLint projection_location, view_location, model_location,
-          normal_matrix_location, env_map_location,
+          dequantization_location, normal_matrix_location, env_map_location,
           prefilter_map_location,brdf_lut_location,camera_position_location;
 
       if (reflection_) {
@@ -709,6 +1075,8 @@ void GLWidget::paintGL() {
             reflection_program_->uniformLocation("projection");
         view_location = reflection_program_->uniformLocation("view");
         model_location = reflection_program_->uniformLocation("model");
+        dequantization_location =
+            reflection_program_->uniformLocation("dequantization");
         normal_matrix_location =
             reflection_program_->uniformLocation("normal_matrix");
         env_map_location =
@@ -719,6 +1087,8 @@ void GLWidget::paintGL() {
         projection_location = pbr_program_->uniformLocation("projection");
         view_location = pbr_program_->uniformLocation("view");
         model_location = pbr_program_->uniformLocation("model");
+        dequantization_location =
+            pbr_program_->uniformLocation("dequantization");
         normal_matrix_location =
             pbr_program_->uniformLocation("normal_matrix");
         env_map_location = pbr_program_->uniformLocation("irradiance_map");
@@ -759,7 +1129,25 @@ void GLWidget::paintGL() {
 
 
       glBindVertexArray(modelVAO);
-      glDrawElements(GL_TRIANGLES, mesh_->faces_.size(), GL_UNSIGNED_INT, 0);
+      glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
+      for (const DrawRange &range : model_ranges_) {
+        const Eigen::Matrix4f kRangeModel = model * range.transform;
+        const Eigen::Matrix3f kRangeNormal = (view * kRangeModel)
+                                                 .topLeftCorner<3, 3>()
+                                                 .inverse()
+                                                 .transpose();
+        glUniformMatrix4fv(model_location, 1, GL_FALSE, kRangeModel.data());
+        glUniformMatrix4fv(dequantization_location, 1, GL_FALSE,
+                           range.dequantization.data());
+        glUniformMatrix3fv(normal_matrix_location, 1, GL_FALSE,
+                           kRangeNormal.data());
+        SetAttributePointer(kVertexAttributeIdx, range.position_format,
+                            range.position_stride, range.position_offset);
+        SetAttributePointer(kNormalAttributeIdx, range.normal_format,
+                            range.normal_stride, range.normal_offset);
+        glDrawElements(GL_TRIANGLES, range.index_count, range.index_type,
+                       (void *)range.index_offset);
+      }
       glBindVertexArray(0);
 
     //DEBUG BRDF 2D texture
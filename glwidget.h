@@ -11,9 +11,14 @@
 #include <QString>
 
 #include <memory>
+#include <vector>
 
 #include "./camera.h"
+#include "./glb_io.h"
+#include "./mesh_optimizer.h"
+#include "./model_loader.h"
 #include "./triangle_mesh.h"
+#include "./vertex_buffer.h"
 
 class GLWidget : public QGLWidget {
   Q_OBJECT
@@ -23,12 +28,36 @@ class GLWidget : public QGLWidget {
   ~GLWidget();
 
   /**
-   * @brief LoadModel Loads a PLY model at the filename path into the mesh_ data
-   * structure.
-   * @param filename Path to the PLY model.
-   * @return Whether it was able to load the model.
+   * @brief LoadModel Starts loading a PLY, OBJ, STL, GLB or qmesh model at the
+   * filename path into the mesh_ data structure. The model is read by the
+   * loader thread and uploaded by FinishLoad, and the current model keeps
+   * rendering meanwhile. A later call cancels a load in flight. A valid mesh
+   * cache next to the model is mapped and uploaded directly; otherwise the
+   * model is parsed and its cache is written. GLB buffers are uploaded
+   * straight from the mapped file when their layout allows it.
+   * @param filename Path to the model.
+   * @param normals When the normals of the model are computed. The cache is
+   * bypassed for any policy but the default kWhenMissing.
+   * @param optimization Optional stages run on parsed meshes. The cache is
+   * bypassed for any but the default ones.
+   * @return Whether the format is supported. Read errors are reported later
+   * through LoadFailed.
    */
-  bool LoadModel(const QString &filename);
+  bool LoadModel(const QString &filename,
+                 data_representation::NormalPolicy normals,
+                 const data_representation::MeshOptimization &optimization);
+
+  /**
+   * @brief SetVertexLayout Chooses the vertex buffer layout of models read
+   * into a mesh, and uploads the current one again if it is such a model.
+   * Cached, streamed and GLB models keep the float layout of their files.
+   * @param position Format of the positions.
+   * @param normal Format of the normals.
+   * @param arrangement Whether the attributes are interleaved.
+   */
+  void SetVertexLayout(data_representation::VertexFormat position,
+                       data_representation::VertexFormat normal,
+                       data_representation::VertexArrangement arrangement);
 
   /**
    * @brief LoadSpecularMap Will load load a cube map that will be used for the
@@ -77,6 +106,65 @@ class GLWidget : public QGLWidget {
   void resizeGL(int w, int h);
 
   void reloadShaders();
+
+  /**
+   * @brief UploadModel Fills the model vertex and index buffers, creating them
+   * on first use.
+   * @param vertices The vertex buffer.
+   * @param vertex_bytes Size of the vertex buffer.
+   * @param layout Attribute table of the vertex buffer.
+   * @param dequantization Maps the decoded positions to model space.
+   * @param indices Triangle vertex indices.
+   * @param index_count Number of indices.
+   */
+  void UploadModel(const void *vertices, size_t vertex_bytes,
+                   const data_representation::VertexLayout &layout,
+                   const Eigen::Matrix4f &dequantization, const int *indices,
+                   size_t index_count);
+
+  /**
+   * @brief UploadMesh Encodes the vertices of a mesh in the layout chosen by
+   * SetVertexLayout and uploads them with its faces.
+   */
+  void UploadMesh(const data_representation::TriangleMesh &mesh);
+
+  /**
+   * @brief UploadGlb Copies the span of the GLB binary chunk referenced by
+   * its primitives into modelVBO, which also serves as the index buffer, and
+   * makes every primitive a draw range.
+   * @param glb An aliasable GLB file.
+   */
+  void UploadGlb(const data_representation::GlbFile &glb);
+
+  /**
+   * @brief UseStreamedModel Makes the buffers filled by a finished stream the
+   * model buffers.
+   * @param index_count Number of indices in the streamed index buffer.
+   */
+  void UseStreamedModel(size_t index_count);
+
+  /**
+   * @brief SetModelRange Draws the whole model with a single range over int
+   * indices and a vertex buffer with the given layout.
+   */
+  void SetModelRange(const data_representation::VertexLayout &layout,
+                     const Eigen::Matrix4f &dequantization,
+                     size_t index_count);
+
+  /**
+   * @brief SelectLod Draws the given level of detail of model_lods_, if the
+   * model has any.
+   */
+  void SelectLod(size_t level);
+
+  /**
+   * @brief UpdateLod Selects the coarsest level of detail whose error projects
+   * to at most kLodPixelError pixels with the current camera. A coarser level
+   * than the one drawn is only taken once its error is kLodHysteresis times
+   * smaller, so the level does not flicker at the threshold.
+   */
+  void UpdateLod();
+
   void mousePressEvent(QMouseEvent *event);
   void mouseMoveEvent(QMouseEvent *event);
   void mouseReleaseEvent(QMouseEvent *event);
@@ -116,6 +204,16 @@ class GLWidget : public QGLWidget {
    */
   std::unique_ptr<data_representation::TriangleMesh> mesh_;
 
+  /**
+   * @brief loader_ Reads models in the background.
+   */
+  std::unique_ptr<data_representation::ModelLoader> loader_;
+
+  /**
+   * @brief loading_filename_ The model of the latest LoadModel call.
+   */
+  QString loading_filename_;
+
   /**
    * @brief diffuse_map_ Diffuse cubemap texture.
    */
@@ -134,6 +232,82 @@ class GLWidget : public QGLWidget {
 GLuint modelVAO;
 GLuint modelVBO;
 GLuint modelEBO;
+
+  /**
+   * @brief DrawRange A sub-range of the model buffers drawn with one call.
+   * Offsets are in bytes.
+   */
+  struct DrawRange {
+    data_representation::VertexFormat position_format;
+    GLintptr position_offset;
+    GLsizei position_stride;
+    data_representation::VertexFormat normal_format;
+    GLintptr normal_offset;
+    GLsizei normal_stride;
+    GLenum index_type;
+    GLintptr index_offset;
+    GLsizei index_count;
+
+    /**
+     * @brief transform Model space transform of the range.
+     */
+    Eigen::Matrix<float, 4, 4, Eigen::DontAlign> transform;
+
+    /**
+     * @brief dequantization Maps the decoded positions of the range to model
+     * space, before transform. Normals are not affected.
+     */
+    Eigen::Matrix<float, 4, 4, Eigen::DontAlign> dequantization;
+  };
+
+  /**
+   * @brief model_ranges_ The draw calls that render the model.
+   */
+  std::vector<DrawRange> model_ranges_;
+
+  /**
+   * @brief model_lods_ The ranges of the index buffer holding the levels of
+   * detail of the model, empty if it has a single one.
+   */
+  std::vector<data_representation::MeshLod> model_lods_;
+
+  /**
+   * @brief lod_level_ The level of detail of model_lods_ drawn.
+   */
+  size_t lod_level_;
+
+  /**
+   * @brief model_generation_ The loader request the model shown came from.
+   */
+  unsigned model_generation_;
+
+  /**
+   * @brief stream_vbo_ Vertex buffer a streamed model is uploaded to, swapped
+   * with modelVBO once complete so the current model keeps rendering.
+   */
+  GLuint stream_vbo_;
+
+  /**
+   * @brief stream_ebo_ Index buffer a streamed model is uploaded to.
+   */
+  GLuint stream_ebo_;
+
+  /**
+   * @brief position_format_ Format of the positions of uploaded meshes.
+   */
+  data_representation::VertexFormat position_format_;
+
+  /**
+   * @brief normal_format_ Format of the normals of uploaded meshes.
+   */
+  data_representation::VertexFormat normal_format_;
+
+  /**
+   * @brief arrangement_ Whether the attributes of uploaded meshes are
+   * interleaved.
+   */
+  data_representation::VertexArrangement arrangement_;
+
 GLuint skyboxVAO;
 GLuint skyboxVBO;
 
@@ -194,7 +368,24 @@ GLuint brdfLUTTexture;
 
   void SetMetalness(double);
 
+ private slots:
+  /**
+   * @brief FinishLoad Uploads the model read by the loader for request
+   * generation, unless a newer request superseded it.
+   */
+  void FinishLoad(unsigned generation, bool success);
+
+  /**
+   * @brief DrainStream Uploads the queued windows of the stream of request
+   * generation.
+   */
+  void DrainStream(unsigned generation);
 
+  /**
+   * @brief FinishLods Adds the levels of detail built by the loader to the
+   * model of request generation, if it is still the one shown.
+   */
+  void FinishLods(unsigned generation);
 
  signals:
   /**
@@ -207,10 +398,69 @@ GLuint brdfLUTTexture;
    */
   void SetVertices(QString);
 
+  /**
+   * @brief SetAcmr Signal that updates the interface label "ACMR" with the
+   * vertex cache misses per triangle.
+   */
+  void SetAcmr(QString);
+
+  /**
+   * @brief SetAtvr Signal that updates the interface label "ATVR" with the
+   * vertex cache misses per vertex.
+   */
+  void SetAtvr(QString);
+
+  /**
+   * @brief SetOverfetch Signal that updates the interface label "Fetch" with
+   * the bytes fetched per byte of vertex.
+   */
+  void SetOverfetch(QString);
+
+  /**
+   * @brief SetOverdraw Signal that updates the interface label "Overdraw"
+   * with the fragments shaded per covered pixel.
+   */
+  void SetOverdraw(QString);
+
+  /**
+   * @brief SetLod Signal that updates the interface label "LOD" with the
+   * level of detail drawn and its number of triangles.
+   */
+  void SetLod(QString);
+
   /**
    * @brief SetFaces Signal that updates the interface label "Framerate".
    */
   void SetFramerate(QString);
+
+  /**
+   * @brief SetProgress Signal that updates the interface label "Loading" with
+   * the stage of the model load.
+   */
+  void SetProgress(QString);
+
+  /**
+   * @brief LoadFailed Signal emitted when the model at filename could not be
+   * read.
+   */
+  void LoadFailed(QString filename);
+
+  /**
+   * @brief ModelRead Emitted from the loader thread when a request finishes.
+   */
+  void ModelRead(unsigned generation, bool success);
+
+  /**
+   * @brief WindowRead Emitted from the loader thread when a stream window is
+   * queued.
+   */
+  void WindowRead(unsigned generation);
+
+  /**
+   * @brief LodsRead Emitted from the loader thread when the levels of detail
+   * of a model are ready.
+   */
+  void LodsRead(unsigned generation);
 };
 
 #endif  //  GLWIDGET_H_
@@ -0,0 +1,239 @@
+// Author: Marc Comino 2020
+
+#include <json.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+#include "./text_parser.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kMaxDepth Nesting limit, so hostile files cannot exhaust the stack.
+ */
+const int kMaxDepth = 64;
+
+class JsonParser {
+ public:
+  JsonParser(const char *begin, const char *end) : p_(begin), end_(end) {}
+
+  bool ParseDocument(JsonValue *value) {
+    if (!ParseValue(value, 0)) return false;
+    SkipBlanks();
+    // GLB pads the chunk with spaces, but some writers use zeros.
+    while (p_ < end_ && *p_ == '\0') ++p_;
+    return p_ == end_;
+  }
+
+ private:
+  void SkipBlanks() {
+    while (p_ < end_ &&
+           (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+      ++p_;
+  }
+
+  bool Consume(const char *literal) {
+    const size_t kLength = strlen(literal);
+    if (static_cast<size_t>(end_ - p_) < kLength ||
+        strncmp(p_, literal, kLength) != 0)
+      return false;
+    p_ += kLength;
+    return true;
+  }
+
+  bool ParseValue(JsonValue *value, int depth) {
+    if (depth > kMaxDepth) return false;
+    SkipBlanks();
+    if (p_ == end_) return false;
+
+    switch (*p_) {
+      case '{':
+        value->type = JsonValue::Type::kObject;
+        return ParseObject(value, depth);
+      case '[':
+        value->type = JsonValue::Type::kArray;
+        return ParseArray(value, depth);
+      case '"':
+        value->type = JsonValue::Type::kString;
+        return ParseString(&value->string);
+      case 't':
+        value->type = JsonValue::Type::kBool;
+        value->boolean = true;
+        return Consume("true");
+      case 'f':
+        value->type = JsonValue::Type::kBool;
+        value->boolean = false;
+        return Consume("false");
+      case 'n':
+        value->type = JsonValue::Type::kNull;
+        return Consume("null");
+      default:
+        value->type = JsonValue::Type::kNumber;
+        return ParseNumber(&value->number);
+    }
+  }
+
+  bool ParseObject(JsonValue *value, int depth) {
+    ++p_;
+    SkipBlanks();
+    if (p_ < end_ && *p_ == '}') {
+      ++p_;
+      return true;
+    }
+    while (true) {
+      SkipBlanks();
+      value->members.emplace_back();
+      if (p_ == end_ || *p_ != '"' ||
+          !ParseString(&value->members.back().first))
+        return false;
+      SkipBlanks();
+      if (p_ == end_ || *p_++ != ':') return false;
+      if (!ParseValue(&value->members.back().second, depth + 1)) return false;
+      SkipBlanks();
+      if (p_ == end_) return false;
+      const char kNext = *p_++;
+      if (kNext == '}') return true;
+      if (kNext != ',') return false;
+    }
+  }
+
+  bool ParseArray(JsonValue *value, int depth) {
+    ++p_;
+    SkipBlanks();
+    if (p_ < end_ && *p_ == ']') {
+      ++p_;
+      return true;
+    }
+    while (true) {
+      value->items.emplace_back();
+      if (!ParseValue(&value->items.back(), depth + 1)) return false;
+      SkipBlanks();
+      if (p_ == end_) return false;
+      const char kNext = *p_++;
+      if (kNext == ']') return true;
+      if (kNext != ',') return false;
+    }
+  }
+
+  /**
+   * @brief ParseString Unescapes a string. \u escapes are encoded as UTF-8;
+   * glTF only uses them in names, which the loader ignores.
+   */
+  bool ParseString(std::string *string) {
+    ++p_;
+    while (p_ < end_ && *p_ != '"') {
+      if (*p_ != '\\') {
+        string->push_back(*p_++);
+        continue;
+      }
+      if (++p_ == end_) return false;
+      const char kEscape = *p_++;
+      switch (kEscape) {
+        case '"':
+        case '\\':
+        case '/':
+          string->push_back(kEscape);
+          break;
+        case 'b':
+          string->push_back('\b');
+          break;
+        case 'f':
+          string->push_back('\f');
+          break;
+        case 'n':
+          string->push_back('\n');
+          break;
+        case 'r':
+          string->push_back('\r');
+          break;
+        case 't':
+          string->push_back('\t');
+          break;
+        case 'u': {
+          if (end_ - p_ < 4) return false;
+          unsigned code = 0;
+          for (int i = 0; i < 4; ++i, ++p_) {
+            const char c = *p_;
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+              code |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+              code |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+              code |= c - 'A' + 10;
+            } else {
+              return false;
+            }
+          }
+          if (code < 0x80) {
+            string->push_back(static_cast<char>(code));
+          } else if (code < 0x800) {
+            string->push_back(static_cast<char>(0xC0 | code >> 6));
+            string->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+          } else {
+            string->push_back(static_cast<char>(0xE0 | code >> 12));
+            string->push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+            string->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+          }
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    if (p_ == end_) return false;
+    ++p_;
+    return true;
+  }
+
+  /**
+   * @brief ParseNumber Integers, which is what offsets and counts are, are
+   * parsed exactly. Anything else only needs float precision.
+   */
+  bool ParseNumber(double *number) {
+    const char *start = p_;
+    int64_t integer;
+    const char *c = p_;
+    if (ParseInt(&c, end_, &integer) &&
+        (c == end_ || (*c != '.' && *c != 'e' && *c != 'E'))) {
+      *number = static_cast<double>(integer);
+      p_ = c;
+      return true;
+    }
+    float real;
+    if (!ParseFloat(&p_, end_, &real) || p_ == start) return false;
+    *number = real;
+    return true;
+  }
+
+  const char *p_;
+  const char *end_;
+};
+
+}  // namespace
+
+const JsonValue *JsonValue::Find(const std::string &key) const {
+  if (type != Type::kObject) return nullptr;
+  for (const auto &member : members)
+    if (member.first == key) return &member.second;
+  return nullptr;
+}
+
+double JsonValue::Number(const std::string &key, double fallback) const {
+  const JsonValue *value = Find(key);
+  return value != nullptr && value->type == Type::kNumber ? value->number
+                                                          : fallback;
+}
+
+bool ParseJson(const char *begin, const char *end, JsonValue *value) {
+  *value = JsonValue();
+  JsonParser parser(begin, end);
+  return parser.ParseDocument(value);
+}
+
+}  // namespace data_representation
@@ -0,0 +1,55 @@
+// Author: Marc Comino 2020
+
+#ifndef JSON_H_
+#define JSON_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief JsonValue A parsed JSON document node. Only the fields matching type
+ * are meaningful.
+ */
+struct JsonValue {
+  enum class Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  Type type = Type::kNull;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+  std::vector<JsonValue> items;
+  std::vector<std::pair<std::string, JsonValue>> members;
+
+  /**
+   * @brief Find Returns the member named key of an object, or nullptr.
+   */
+  const JsonValue *Find(const std::string &key) const;
+
+  /**
+   * @brief Number Returns the numeric member named key of an object, or
+   * fallback when it is missing or not a number.
+   */
+  double Number(const std::string &key, double fallback) const;
+
+  /**
+   * @brief Size Number of items of an array, zero for any other type.
+   */
+  size_t Size() const { return type == Type::kArray ? items.size() : 0; }
+};
+
+/**
+ * @brief ParseJson Parses the JSON document in [begin, end). Trailing
+ * whitespace, including the padding of GLB chunks, is accepted.
+ * @param value The root value of the document.
+ * @return Whether the text is a well formed document.
+ */
+bool ParseJson(const char *begin, const char *end, JsonValue *value);
+
+}  // namespace data_representation
+
+#endif  // JSON_H_
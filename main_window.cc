@@ -2,9 +2,17 @@
 
 #include <main_window.h>
 
+#include <QApplication>
+#include <QDir>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
+#include "./mesh_optimizer.h"
+#include "./model_loader.h"
+#include "./qmesh_io.h"
+#include "./triangle_mesh.h"
 #include "./ui_main_window.h"
+#include "./vertex_buffer.h"
 
 namespace gui {
 
@@ -22,15 +30,54 @@ void MainWindow::on_actionQuit_triggered() { close(); }
 void MainWindow::on_actionLoad_triggered() {
   QString filename;
 
-  filename = QFileDialog::getOpenFileName(this, tr("Load model"), "./",
-                                          tr("PLY Files ( *.ply )"));
+  filename = QFileDialog::getOpenFileName(
+      this, tr("Load model"), "./",
+      tr("Models ( *.ply *.obj *.stl *.glb *.qmesh )"));
   if (!filename.isNull()) {
-    if (!ui->glwidget->LoadModel(filename))
+    // In the order of the items of combo_normals.
+    const data_representation::NormalPolicy kPolicies[3] = {
+        data_representation::NormalPolicy::kWhenMissing,
+        data_representation::NormalPolicy::kAlways,
+        data_representation::NormalPolicy::kNever};
+    const int kPolicy = ui->combo_normals->currentIndex();
+    if (!ui->glwidget->LoadModel(filename, kPolicies[kPolicy],
+                                 ChosenOptimization()))
       QMessageBox::warning(this, tr("Error"),
                            tr("The file could not be opened"));
   }
 }
 
+void MainWindow::on_actionCompress_triggered() {
+  QString source = QFileDialog::getOpenFileName(
+      this, tr("Compress model"), "./",
+      tr("Models ( *.ply *.obj *.stl *.glb )"));
+  if (source.isNull()) return;
+
+  QFileInfo info(source);
+  QString target = QFileDialog::getSaveFileName(
+      this, tr("Save compressed model"),
+      info.dir().filePath(info.completeBaseName() + ".qmesh"),
+      tr("Compressed models ( *.qmesh )"));
+  if (target.isNull()) return;
+
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+  data_representation::TriangleMesh mesh;
+  bool compressed = data_representation::ReadModel(
+      source.toUtf8().constData(), &mesh,
+      data_representation::NormalPolicy::kWhenMissing);
+  // The loader keeps the order of qmesh files, so it is optimized here. The
+  // cache order also keeps the index deltas of the blocks small.
+  if (compressed) {
+    data_representation::OptimizeMesh(&mesh, ChosenOptimization());
+    compressed =
+        data_representation::WriteToQmesh(target.toUtf8().constData(), mesh);
+  }
+  QApplication::restoreOverrideCursor();
+  if (!compressed)
+    QMessageBox::warning(this, tr("Error"),
+                         tr("The model could not be compressed"));
+}
+
 void MainWindow::on_actionLoad_Specular_triggered() {
   QString filename;
 
@@ -53,4 +100,41 @@ void MainWindow::on_actionLoad_Diffuse_triggered() {
   }
 }
 
+void MainWindow::on_glwidget_LoadFailed(QString filename) {
+  QMessageBox::warning(this, tr("Error"),
+                       tr("The file %1 could not be opened").arg(filename));
+}
+
+void MainWindow::on_combo_layout_currentIndexChanged(int) {
+  ApplyVertexLayout();
+}
+
+void MainWindow::on_check_streams_toggled(bool) { ApplyVertexLayout(); }
+
+void MainWindow::ApplyVertexLayout() {
+  // In the order of the items of combo_layout.
+  const data_representation::VertexFormat kPositions[3] = {
+      data_representation::VertexFormat::kFloat3,
+      data_representation::VertexFormat::kHalf3,
+      data_representation::VertexFormat::kUnorm16x3};
+  const int kLayout = ui->combo_layout->currentIndex();
+  ui->glwidget->SetVertexLayout(
+      kPositions[kLayout],
+      kLayout == 0 ? data_representation::VertexFormat::kFloat3
+                   : data_representation::VertexFormat::kSnorm10x3,
+      ui->check_streams->isChecked()
+          ? data_representation::VertexArrangement::kSeparate
+          : data_representation::VertexArrangement::kInterleaved);
+}
+
+data_representation::MeshOptimization MainWindow::ChosenOptimization() const {
+  data_representation::MeshOptimization optimization;
+  // The minimum of spin_overdraw, below 1, turns the stage off.
+  optimization.overdraw_threshold =
+      static_cast<float>(ui->spin_overdraw->value());
+  optimization.vertex_fetch = ui->check_fetch->isChecked();
+  optimization.lods = ui->check_lods->isChecked();
+  return optimization;
+}
+
 }  //  namespace gui
@@ -9,6 +9,10 @@ namespace Ui {
 class MainWindow;
 }
 
+namespace data_representation {
+struct MeshOptimization;
+}
+
 namespace gui {
 
 class MainWindow : public QMainWindow {
@@ -31,6 +35,12 @@ class MainWindow : public QMainWindow {
    */
   void on_actionLoad_triggered();
 
+  /**
+   * @brief on_actionCompress_triggered Opens file dialogs to store a model in
+   * the quantized qmesh container, reordered with the chosen optimizations.
+   */
+  void on_actionCompress_triggered();
+
   /**
    * @brief on_actionLoad_Specular_triggered Opens a file dialog to load a cube
    * map that will be used for the specular component.
@@ -43,7 +53,35 @@ class MainWindow : public QMainWindow {
    */
   void on_actionLoad_Diffuse_triggered();
 
+  /**
+   * @brief on_glwidget_LoadFailed Warns that the model at filename could not
+   * be loaded.
+   */
+  void on_glwidget_LoadFailed(QString filename);
+
+  /**
+   * @brief on_combo_layout_currentIndexChanged Changes the vertex formats.
+   */
+  void on_combo_layout_currentIndexChanged(int index);
+
+  /**
+   * @brief on_check_streams_toggled Switches between interleaved and separate
+   * vertex attribute streams.
+   */
+  void on_check_streams_toggled(bool checked);
+
  private:
+  /**
+   * @brief ApplyVertexLayout Hands the layout chosen in the interface to the
+   * viewer.
+   */
+  void ApplyVertexLayout();
+
+  /**
+   * @brief ChosenOptimization The mesh optimizations chosen in the interface.
+   */
+  data_representation::MeshOptimization ChosenOptimization() const;
+
   Ui::MainWindow *ui;
 };
 
@@ -0,0 +1,121 @@
+// Author: Marc Comino 2020
+
+#include <mapped_file.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+namespace data_representation {
+
+MappedFile::MappedFile()
+    : data_(nullptr), size_(0), mapped_(false), writable_(false) {}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string &filename, bool copy_on_write) {
+  Close();
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    const size_t kSize = static_cast<size_t>(info.st_size);
+    const int kProtection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *address = mmap(nullptr, kSize, kProtection, MAP_PRIVATE, fd, 0);
+    if (address != MAP_FAILED) {
+      madvise(address, kSize, MADV_SEQUENTIAL);
+      data_ = static_cast<char *>(address);
+      size_ = kSize;
+      mapped_ = true;
+    }
+  }
+  close(fd);
+  if (mapped_) {
+    writable_ = copy_on_write;
+    return true;
+  }
+
+  std::ifstream fin(filename.c_str(),
+                    std::ios_base::in | std::ios_base::binary);
+  if (!fin.is_open() || !fin.good()) return false;
+
+  fin.seekg(0, std::ios_base::end);
+  const std::streamoff kSize = fin.tellg();
+  if (kSize <= 0) return false;
+  fin.seekg(0, std::ios_base::beg);
+
+  buffer_.resize(static_cast<size_t>(kSize));
+  fin.read(buffer_.data(), kSize);
+  if (!fin) {
+    buffer_.clear();
+    return false;
+  }
+
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+  writable_ = copy_on_write;
+  return true;
+}
+
+bool MappedFile::CreateTemporary(size_t size) {
+  Close();
+  if (size == 0) return false;
+
+  const char *kDirectory = getenv("TMPDIR");
+  std::string path = kDirectory != nullptr && kDirectory[0] != '\0'
+                         ? kDirectory
+                         : "/tmp";
+  path += "/frr_scratch_XXXXXX";
+  int fd = mkstemp(&path[0]);
+  if (fd >= 0) {
+    unlink(path.c_str());
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+      void *address =
+          mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (address != MAP_FAILED) {
+        data_ = static_cast<char *>(address);
+        size_ = size;
+        mapped_ = true;
+      }
+    }
+    close(fd);
+  }
+
+  // Without a scratch file the space is simply allocated.
+  if (!mapped_) {
+    buffer_.assign(size, 0);
+    data_ = buffer_.data();
+    size_ = size;
+  }
+  writable_ = true;
+  return true;
+}
+
+void MappedFile::Release(size_t offset, size_t size) {
+  if (!mapped_ || offset >= size_) return;
+
+  const size_t kPage = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const size_t kBegin = offset / kPage * kPage;
+  const size_t kEnd = std::min(size_, offset + size) / kPage * kPage;
+  if (kEnd > kBegin) madvise(data_ + kBegin, kEnd - kBegin, MADV_DONTNEED);
+}
+
+void MappedFile::Close() {
+  if (mapped_) munmap(data_, size_);
+
+  std::vector<char>().swap(buffer_);
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+  writable_ = false;
+}
+
+}  // namespace data_representation
@@ -0,0 +1,99 @@
+// Author: Marc Comino 2020
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief The MappedFile class Read-only view of a whole file. The file is
+ * memory mapped when possible, otherwise it is read into an owned buffer so
+ * that callers can always parse it as a contiguous range of bytes.
+ */
+class MappedFile {
+ public:
+  /**
+   * @brief MappedFile Constructor of the class. The view starts empty.
+   */
+  MappedFile();
+
+  /**
+   * @brief ~MappedFile Destructor of the class. Calls Close.
+   */
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /**
+   * @brief Open Maps the file at the path filename, falling back to a buffered
+   * read if it can not be mapped.
+   * @param filename The path to the file.
+   * @param copy_on_write Whether the contents may be modified in memory through
+   * mutable_data. Changes are private and never reach the file.
+   * @return Whether the file contents are available.
+   */
+  bool Open(const std::string &filename, bool copy_on_write = false);
+
+  /**
+   * @brief CreateTemporary Maps a zero-filled scratch file of size bytes,
+   * writable through mutable_data. The file is unlinked right away, so its
+   * pages can be written back to disk under memory pressure instead of
+   * staying resident, and it disappears with the view.
+   * @param size Size of the scratch space in bytes.
+   * @return Whether the scratch space is available.
+   */
+  bool CreateTemporary(size_t size);
+
+  /**
+   * @brief Close Unmaps the file and releases the fallback buffer.
+   */
+  void Close();
+
+  /**
+   * @brief data Pointer to the first byte of the file.
+   */
+  const char *data() const { return data_; }
+
+  /**
+   * @brief mutable_data Pointer to the first byte of a copy-on-write or
+   * temporary view, or nullptr if the file was opened read-only.
+   */
+  char *mutable_data() { return writable_ ? data_ : nullptr; }
+
+  /**
+   * @brief Release Drops the resident pages of [offset, offset + size), which
+   * a streaming reader is done with. The contents stay readable and are paged
+   * in again if accessed. Does nothing for buffered files.
+   */
+  void Release(size_t offset, size_t size);
+
+  /**
+   * @brief size Size of the file in bytes.
+   */
+  size_t size() const { return size_; }
+
+  /**
+   * @brief mapped Whether the contents are memory mapped or buffered.
+   */
+  bool mapped() const { return mapped_; }
+
+ private:
+  char *data_;
+  size_t size_;
+  bool mapped_;
+  bool writable_;
+
+  /**
+   * @brief buffer_ Owned copy of the file used when mmap is not available.
+   */
+  std::vector<char> buffer_;
+};
+
+}  // namespace data_representation
+
+#endif  // MAPPED_FILE_H_
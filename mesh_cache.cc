@@ -0,0 +1,442 @@
+// Author: Marc Comino 2020
+
+#include <mesh_cache.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "./mapped_file.h"
+#include "./parallel.h"
+#include "./triangle_mesh.h"
+#include "./vertex_buffer.h"
+
+namespace data_representation {
+
+/**
+ * @brief MeshCacheHeader Cache file layout: this header followed by the vertex
+ * buffer, the index buffer and the table of levels of detail, each starting
+ * at a kSectionAlignment boundary.
+ * Values are stored in the native byte order, the cache is a local artifact.
+ */
+struct MeshCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+
+  /**
+   * @brief path_hash Hash of the canonical path of the source.
+   */
+  uint64_t path_hash;
+  uint64_t source_size;
+
+  /**
+   * @brief source_mtime Modification time of the source in nanoseconds.
+   */
+  int64_t source_mtime;
+  uint64_t content_hash;
+
+  uint64_t vertex_count;
+  uint64_t buffer_offset;
+  uint64_t buffer_floats;
+  uint64_t index_offset;
+  uint64_t index_count;
+  uint64_t lod_offset;
+  uint64_t lod_count;
+
+  float min[3];
+  float max[3];
+};
+
+namespace {
+
+/**
+ * @brief CachedLod Entry of the table of levels of detail.
+ */
+struct CachedLod {
+  uint64_t first_index;
+  uint64_t index_count;
+  float error;
+  uint32_t padding;
+};
+
+const char kCacheMagic[8] = {'F', 'R', 'R', 'M', 'E', 'S', 'H', '\0'};
+
+/**
+ * @brief kCacheVersion Must be bumped whenever the layout or the contents of
+ * the buffers change, so stale caches are rebuilt.
+ */
+const uint32_t kCacheVersion = 3;
+
+const char kCacheExtension[] = ".meshcache";
+
+const size_t kSectionAlignment = 64;
+
+/**
+ * @brief kHashBlock Bytes of the source hashed per task. The block size is
+ * fixed so the hash does not depend on the number of threads.
+ */
+const size_t kHashBlock = 1 << 22;
+
+/**
+ * @brief kIndexBlock Indices range checked per task.
+ */
+const size_t kIndexBlock = 1 << 16;
+
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+
+static_assert(std::is_trivially_copyable<MeshCacheHeader>::value,
+              "The cache header is written as raw bytes");
+static_assert(std::is_trivially_copyable<CachedLod>::value,
+              "The level table is written as raw bytes");
+
+uint64_t Rotate(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t Mix(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+/**
+ * @brief HashBytes Fast non-cryptographic 64-bit hash. Four independent lanes
+ * consume 32 bytes per iteration, which keeps it memory bound.
+ */
+uint64_t HashBytes(const char *data, size_t size, uint64_t seed) {
+  uint64_t lanes[4] = {seed + kPrime1, seed ^ kPrime2, seed - kPrime1,
+                       seed ^ kPrime3};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int lane = 0; lane < 4; ++lane) {
+      uint64_t value;
+      memcpy(&value, data + i + lane * 8, sizeof(value));
+      lanes[lane] = Rotate(lanes[lane] + value * kPrime2, 31) * kPrime1;
+    }
+  }
+
+  uint64_t hash = Rotate(lanes[0], 1) + Rotate(lanes[1], 7) +
+                  Rotate(lanes[2], 12) + Rotate(lanes[3], 18) + size;
+  for (; i < size; ++i)
+    hash = Rotate(hash ^ (static_cast<unsigned char>(data[i]) * kPrime3), 11) *
+           kPrime1;
+  return Mix(hash);
+}
+
+/**
+ * @brief HashContents Hashes fixed-size blocks of the data in parallel and
+ * then the list of block hashes.
+ */
+uint64_t HashContents(const char *data, size_t size) {
+  const size_t kBlocks = (size + kHashBlock - 1) / kHashBlock;
+  std::vector<uint64_t> hashes(kBlocks);
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kBegin = block * kHashBlock;
+    const size_t kSize = std::min(kHashBlock, size - kBegin);
+    hashes[block] = HashBytes(data + kBegin, kSize, block);
+  });
+  return HashBytes(reinterpret_cast<const char *>(hashes.data()),
+                   hashes.size() * sizeof(uint64_t), size);
+}
+
+bool HashFile(const std::string &filename, uint64_t *hash) {
+  MappedFile file;
+  if (!file.Open(filename)) return false;
+  *hash = HashContents(file.data(), file.size());
+  return true;
+}
+
+uint64_t HashPath(const std::string &filename) {
+  char resolved[PATH_MAX];
+  const char *path = realpath(filename.c_str(), resolved);
+  if (path == nullptr) path = filename.c_str();
+  return HashBytes(path, strlen(path), 0);
+}
+
+struct SourceInfo {
+  uint64_t size;
+  int64_t mtime;
+};
+
+bool StatSource(const std::string &filename, SourceInfo *info) {
+  struct stat status;
+  if (stat(filename.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+    return false;
+  info->size = static_cast<uint64_t>(status.st_size);
+  info->mtime = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 +
+                status.st_mtim.tv_nsec;
+  return true;
+}
+
+size_t AlignSection(size_t offset) {
+  return (offset + kSectionAlignment - 1) / kSectionAlignment *
+         kSectionAlignment;
+}
+
+/**
+ * @brief IsSectionInside Whether count elements of element_size bytes at the
+ * aligned offset fit in a file of the given size, checked without overflow.
+ */
+bool IsSectionInside(uint64_t offset, uint64_t count, size_t element_size,
+                     size_t size) {
+  return offset % kSectionAlignment == 0 && offset <= size &&
+         count <= (size - offset) / element_size;
+}
+
+/**
+ * @brief IsWellFormed Checks the header against the size of the cache file so
+ * a truncated or foreign file is never read out of bounds.
+ */
+bool IsWellFormed(const MeshCacheHeader &header, size_t size) {
+  if (memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0)
+    return false;
+  if (header.version != kCacheVersion) return false;
+  if (header.header_size != sizeof(MeshCacheHeader)) return false;
+  if (!IsSectionInside(header.buffer_offset, header.buffer_floats,
+                       sizeof(float), size) ||
+      !IsSectionInside(header.index_offset, header.index_count, sizeof(int),
+                       size) ||
+      !IsSectionInside(header.lod_offset, header.lod_count, sizeof(CachedLod),
+                       size))
+    return false;
+  if (header.vertex_count > static_cast<uint64_t>(INT_MAX) ||
+      header.buffer_floats != header.vertex_count * kInterleavedFloats)
+    return false;
+
+  // Every section lies inside the file, so the ends below cannot wrap.
+  const uint64_t kBufferEnd =
+      header.buffer_offset + header.buffer_floats * sizeof(float);
+  const uint64_t kIndexEnd =
+      header.index_offset + header.index_count * sizeof(int);
+  return header.buffer_offset >= sizeof(MeshCacheHeader) &&
+         kBufferEnd <= header.index_offset &&
+         kIndexEnd <= header.lod_offset && header.index_count % 3 == 0;
+}
+
+/**
+ * @brief HasValidIndices Checks in parallel that every index refers to one of
+ * the vertex_count vertices, as ValidateFaces does for parsed meshes.
+ */
+bool HasValidIndices(const int *indices, size_t count, uint64_t vertex_count) {
+  const int kVertices = static_cast<int>(vertex_count);
+  std::atomic<bool> valid(true);
+  ParallelForRange(0, count, kIndexBlock, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (indices[i] < 0 || indices[i] >= kVertices) {
+        valid = false;
+        return;
+      }
+    }
+  });
+  return valid;
+}
+
+/**
+ * @brief IsValidLod Checks that a level is a range of whole triangles inside
+ * the index buffer.
+ */
+bool IsValidLod(const CachedLod &lod, uint64_t index_count) {
+  return lod.first_index % 3 == 0 && lod.index_count % 3 == 0 &&
+         lod.first_index <= index_count &&
+         lod.index_count <= index_count - lod.first_index;
+}
+
+/**
+ * @brief RefreshModificationTime Stores the new modification time of a source
+ * whose contents did not change, so the next load skips hashing.
+ */
+void RefreshModificationTime(const std::string &cache, int64_t mtime) {
+  int fd = open(cache.c_str(), O_WRONLY);
+  if (fd < 0) return;
+  const ssize_t kWritten = pwrite(fd, &mtime, sizeof(mtime),
+                                  offsetof(MeshCacheHeader, source_mtime));
+  (void)kWritten;
+  close(fd);
+}
+
+void WritePadding(std::ofstream *fout, size_t from, size_t to) {
+  static const char kZeros[kSectionAlignment] = {};
+  fout->write(kZeros, static_cast<std::streamsize>(to - from));
+}
+
+}  // namespace
+
+MeshCache::MeshCache() : header_(nullptr) {}
+
+bool MeshCache::Open(const std::string &source) {
+  Close();
+
+  SourceInfo info;
+  if (!StatSource(source, &info)) return false;
+
+  const std::string kCache = MeshCachePath(source);
+  if (!file_.Open(kCache)) return false;
+
+  MeshCacheHeader header;
+  if (file_.size() < sizeof(header)) {
+    file_.Close();
+    return false;
+  }
+  memcpy(&header, file_.data(), sizeof(header));
+
+  if (!IsWellFormed(header, file_.size()) ||
+      header.path_hash != HashPath(source) ||
+      header.source_size != info.size) {
+    file_.Close();
+    return false;
+  }
+
+  if (header.source_mtime != info.mtime) {
+    uint64_t hash;
+    if (!HashFile(source, &hash) || hash != header.content_hash) {
+      file_.Close();
+      return false;
+    }
+    RefreshModificationTime(kCache, info.mtime);
+  }
+
+  // A corrupt cache must not reach the GPU or the vertex cache analysis.
+  const int *kIndices =
+      reinterpret_cast<const int *>(file_.data() + header.index_offset);
+  if (!HasValidIndices(kIndices, header.index_count, header.vertex_count)) {
+    file_.Close();
+    return false;
+  }
+  const CachedLod *kLods =
+      reinterpret_cast<const CachedLod *>(file_.data() + header.lod_offset);
+  for (uint64_t i = 0; i < header.lod_count; ++i) {
+    if (!IsValidLod(kLods[i], header.index_count)) {
+      file_.Close();
+      return false;
+    }
+  }
+
+  header_ = reinterpret_cast<const MeshCacheHeader *>(file_.data());
+  return true;
+}
+
+void MeshCache::Close() {
+  header_ = nullptr;
+  file_.Close();
+}
+
+const float *MeshCache::vertex_buffer() const {
+  return reinterpret_cast<const float *>(file_.data() + header_->buffer_offset);
+}
+
+size_t MeshCache::vertex_buffer_size() const { return header_->buffer_floats; }
+
+const int *MeshCache::indices() const {
+  return reinterpret_cast<const int *>(file_.data() + header_->index_offset);
+}
+
+size_t MeshCache::index_count() const { return header_->index_count; }
+
+std::vector<MeshLod> MeshCache::lods() const {
+  const CachedLod *kLods =
+      reinterpret_cast<const CachedLod *>(file_.data() + header_->lod_offset);
+  std::vector<MeshLod> lods(header_->lod_count);
+  for (size_t i = 0; i < lods.size(); ++i) {
+    lods[i].first_index = kLods[i].first_index;
+    lods[i].index_count = kLods[i].index_count;
+    lods[i].error = kLods[i].error;
+  }
+  return lods;
+}
+
+size_t MeshCache::vertex_count() const { return header_->vertex_count; }
+
+Eigen::Vector3f MeshCache::min() const {
+  return Eigen::Vector3f(header_->min[0], header_->min[1], header_->min[2]);
+}
+
+Eigen::Vector3f MeshCache::max() const {
+  return Eigen::Vector3f(header_->max[0], header_->max[1], header_->max[2]);
+}
+
+std::string MeshCachePath(const std::string &source) {
+  return source + kCacheExtension;
+}
+
+bool WriteMeshCache(const std::string &source, const TriangleMesh &mesh) {
+  SourceInfo info;
+  MeshCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  if (!StatSource(source, &info) || !HashFile(source, &header.content_hash))
+    return false;
+
+  memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+  header.version = kCacheVersion;
+  header.header_size = sizeof(MeshCacheHeader);
+  header.path_hash = HashPath(source);
+  header.source_size = info.size;
+  header.source_mtime = info.mtime;
+  header.vertex_count = mesh.vertices_.size() / 3;
+  header.buffer_offset = AlignSection(sizeof(MeshCacheHeader));
+  header.buffer_floats = mesh.buffer_.size();
+  header.index_offset = AlignSection(header.buffer_offset +
+                                     mesh.buffer_.size() * sizeof(float));
+  header.index_count = mesh.faces_.size();
+  header.lod_offset = AlignSection(header.index_offset +
+                                   mesh.faces_.size() * sizeof(int));
+  header.lod_count = mesh.lods_.size();
+  for (int i = 0; i < 3; ++i) {
+    header.min[i] = mesh.min_[i];
+    header.max[i] = mesh.max_[i];
+  }
+
+  const std::string kCache = MeshCachePath(source);
+  const std::string kTemporary = kCache + ".tmp" + std::to_string(getpid());
+  std::ofstream fout(kTemporary.c_str(),
+                     std::ios_base::out | std::ios_base::binary);
+  if (!fout.is_open()) return false;
+
+  fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  WritePadding(&fout, sizeof(header), header.buffer_offset);
+  fout.write(reinterpret_cast<const char *>(mesh.buffer_.data()),
+             static_cast<std::streamsize>(mesh.buffer_.size() * sizeof(float)));
+  WritePadding(&fout,
+               header.buffer_offset + mesh.buffer_.size() * sizeof(float),
+               header.index_offset);
+  fout.write(reinterpret_cast<const char *>(mesh.faces_.data()),
+             static_cast<std::streamsize>(mesh.faces_.size() * sizeof(int)));
+  WritePadding(&fout, header.index_offset + mesh.faces_.size() * sizeof(int),
+               header.lod_offset);
+  std::vector<CachedLod> lods(mesh.lods_.size());
+  for (size_t i = 0; i < lods.size(); ++i) {
+    memset(&lods[i], 0, sizeof(CachedLod));
+    lods[i].first_index = mesh.lods_[i].first_index;
+    lods[i].index_count = mesh.lods_[i].index_count;
+    lods[i].error = mesh.lods_[i].error;
+  }
+  fout.write(reinterpret_cast<const char *>(lods.data()),
+             static_cast<std::streamsize>(lods.size() * sizeof(CachedLod)));
+  fout.close();
+
+  if (!fout || rename(kTemporary.c_str(), kCache.c_str()) != 0) {
+    unlink(kTemporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace data_representation
@@ -0,0 +1,124 @@
+// Author: Marc Comino 2020
+
+#ifndef MESH_CACHE_H_
+#define MESH_CACHE_H_
+
+#include <eigen3/Eigen/Geometry>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "./mapped_file.h"
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+/**
+ * @brief MeshCacheHeader Fixed-size header at the start of a cache file.
+ */
+struct MeshCacheHeader;
+
+/**
+ * @brief The MeshCache class Read-only view of the preprocessed copy of a
+ * model, stored next to its source as <source>.meshcache. The cache holds the
+ * interleaved vertex buffer and the index buffer exactly as they are uploaded
+ * to the GPU, together with the levels of detail and the bounding box, so a
+ * cached model is mapped and handed to OpenGL without any parsing or
+ * processing.
+ */
+class MeshCache {
+ public:
+  /**
+   * @brief MeshCache Constructor of the class. The view starts empty.
+   */
+  MeshCache();
+
+  MeshCache(const MeshCache &) = delete;
+  MeshCache &operator=(const MeshCache &) = delete;
+
+  /**
+   * @brief Open Maps the cache of the model at the path source. The cache is
+   * only accepted if its version matches and it was built from the same path
+   * with the same size. If the modification time differs the source contents
+   * are hashed, so a copied or touched model still hits the cache. Caches
+   * whose buffers disagree with the vertex count or whose indices are out of
+   * range are rejected.
+   * @param source Path to the source model.
+   * @return Whether a valid cache is available.
+   */
+  bool Open(const std::string &source);
+
+  /**
+   * @brief Close Unmaps the cache.
+   */
+  void Close();
+
+  /**
+   * @brief vertex_buffer Interleaved position and normal floats.
+   */
+  const float *vertex_buffer() const;
+
+  /**
+   * @brief vertex_buffer_size Number of floats in the vertex buffer.
+   */
+  size_t vertex_buffer_size() const;
+
+  /**
+   * @brief indices Triangle vertex indices, three per face.
+   */
+  const int *indices() const;
+
+  /**
+   * @brief index_count Number of indices of all the levels of detail.
+   */
+  size_t index_count() const;
+
+  /**
+   * @brief lods The ranges of indices of the levels of detail, empty if the
+   * model has a single one.
+   */
+  std::vector<MeshLod> lods() const;
+
+  /**
+   * @brief vertex_count Number of vertices of the model.
+   */
+  size_t vertex_count() const;
+
+  /**
+   * @brief min The minimum point of the bounding box.
+   */
+  Eigen::Vector3f min() const;
+
+  /**
+   * @brief max The maximum point of the bounding box.
+   */
+  Eigen::Vector3f max() const;
+
+ private:
+  MappedFile file_;
+
+  /**
+   * @brief header_ Start of the mapped cache, nullptr if none is open.
+   */
+  const MeshCacheHeader *header_;
+};
+
+/**
+ * @brief MeshCachePath Path of the cache file of a model.
+ */
+std::string MeshCachePath(const std::string &source);
+
+/**
+ * @brief WriteMeshCache Stores the processed mesh as the cache of the model at
+ * the path source. The file is written under a temporary name and renamed, so
+ * readers never see a partial cache.
+ * @param source Path to the source model the mesh was loaded from.
+ * @param mesh The mesh, with its vertex buffer already prepared.
+ * @return Whether the cache was written.
+ */
+bool WriteMeshCache(const std::string &source, const TriangleMesh &mesh);
+
+}  // namespace data_representation
+
+#endif  // MESH_CACHE_H_
@@ -2,204 +2,760 @@
 
 #include <mesh_io.h>
 
-#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <algorithm>
-#include <fstream>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "./geometry_kernels.h"
+#include "./mapped_file.h"
+#include "./mesh_processing.h"
+#include "./parallel.h"
+#include "./ply_format.h"
+#include "./text_parser.h"
 #include "./triangle_mesh.h"
+#include "./vertex_buffer.h"
 
 namespace data_representation {
 
 namespace {
 
-template <typename T>
-void Add3Items(T i1, T i2, T i3, size_t index, std::vector<T> *vector) {
-  (*vector)[index] = i1;
-  (*vector)[index + 1] = i2;
-  (*vector)[index + 2] = i3;
+/**
+ * @brief kAsciiChunkSize Minimum amount of text handed to a parsing thread.
+ */
+const size_t kAsciiChunkSize = 1 << 20;
+
+/**
+ * @brief kWriteBlock Bytes of records encoded per write call.
+ */
+const size_t kWriteBlock = 1 << 24;
+
+/**
+ * @brief kFaceRecordSize Bytes per written face: an uchar count and three ints.
+ */
+const size_t kFaceRecordSize = sizeof(unsigned char) + 3 * sizeof(int);
+
+/**
+ * @brief WriteAll Writes the whole range, retrying after partial writes.
+ */
+bool WriteAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    const ssize_t kWritten = write(fd, data, std::min<size_t>(size, 1 << 30));
+    if (kWritten < 0 && errno == EINTR) continue;
+    if (kWritten <= 0) return false;
+    data += kWritten;
+    size -= static_cast<size_t>(kWritten);
+  }
+  return true;
 }
 
-bool ReadPlyHeader(std::ifstream *fin, int *vertices, int *faces) {
-  char line[100];
+/**
+ * @brief WriteRecords Encodes count records of stride bytes with encode(i,
+ * record) into large staging blocks, in parallel, and writes every block with
+ * a single call.
+ */
+template <typename Encoder>
+bool WriteRecords(int fd, size_t count, size_t stride, const Encoder &encode) {
+  const size_t kPerBlock = std::max<size_t>(1, kWriteBlock / stride);
+  std::vector<char> block(std::min(count, kPerBlock) * stride);
+  for (size_t begin = 0; begin < count; begin += kPerBlock) {
+    const size_t kEnd = std::min(count, begin + kPerBlock);
+    ParallelForRange(begin, kEnd, 1 << 14, [&](size_t first, size_t last) {
+      for (size_t i = first; i < last; ++i)
+        encode(i, block.data() + (i - begin) * stride);
+    });
+    if (!WriteAll(fd, block.data(), (kEnd - begin) * stride)) return false;
+  }
+  return true;
+}
 
-  fin->getline(line, 100);
-  if (strncmp(line, "ply", 3) != 0) return false;
+/**
+ * @brief StageClock Adds the time elapsed since the previous lap to a stage.
+ */
+class StageClock {
+ public:
+  StageClock() : last_(std::chrono::steady_clock::now()) {}
+
+  void Lap(double *stage) {
+    const auto kNow = std::chrono::steady_clock::now();
+    *stage += std::chrono::duration<double>(kNow - last_).count();
+    last_ = kNow;
+  }
 
-  *vertices = 0;
-  fin->getline(line, 100);
-  while (strncmp(line, "end_header", 10) != 0) {
-    if (strncmp(line, "element vertex", 14) == 0) *vertices = atoi(&line[15]);
-    fin->getline(line, 100);
-    if (strncmp(line, "element face", 12) == 0) *faces = atoi(&line[13]);
+ private:
+  std::chrono::steady_clock::time_point last_;
+};
+
+/**
+ * @brief HasScalars Whether the vertex element stores the three named scalar
+ * properties.
+ */
+bool HasScalars(const PlyElement &vertex, const char *const names[3]) {
+  for (int i = 0; i < 3; ++i) {
+    const int kProperty = vertex.FindProperty(names[i]);
+    if (kProperty < 0 || vertex.properties[kProperty].is_list()) return false;
   }
+  return true;
+}
 
-  if (*vertices <= 0) return false;
+bool HasColors(const PlyElement &vertex) {
+  const char *kNames[3] = {"red", "green", "blue"};
+  return HasScalars(vertex, kNames);
+}
 
-  std::cout << "Loading triangle mesh" << std::endl;
-  std::cout << "\tVertices = " << *vertices << std::endl;
-  std::cout << "\tFaces = " << *faces << std::endl;
+bool HasNormals(const PlyElement &vertex) {
+  const char *kNames[3] = {"nx", "ny", "nz"};
+  return HasScalars(vertex, kNames);
+}
 
+/**
+ * @brief FitsPayload Checks that the payload after the header can hold the
+ * declared records, each at least its binary size with empty lists, or one
+ * character and a separator per property in ASCII. Counts are checked before
+ * anything is allocated from them.
+ */
+bool FitsPayload(const PlyHeader &header, size_t file_size) {
+  if (header.header_size > file_size) return false;
+  // The last ASCII record needs no separator.
+  size_t left = file_size - header.header_size +
+                (header.format == PlyFormat::kAscii ? 1 : 0);
+  for (const PlyElement &element : header.elements) {
+    size_t record = 0;
+    for (const PlyProperty &property : element.properties) {
+      record += header.format == PlyFormat::kAscii
+                    ? 2
+                    : PlyTypeSize(property.is_list() ? property.count_type
+                                                     : property.type);
+    }
+    if (record == 0) continue;
+    if (element.count > left / record) return false;
+    left -= element.count * record;
+  }
   return true;
 }
 
-void ReadPlyVertices(std::ifstream *fin, TriangleMesh *mesh) {
-  const size_t kVertices = mesh->vertices_.size() / 3;
-  for (size_t i = 0; i < kVertices; ++i) {
-    float x, y, z;
-    fin->read(reinterpret_cast<char *>(&x), sizeof(float));
-    fin->read(reinterpret_cast<char *>(&y), sizeof(float));
-    fin->read(reinterpret_cast<char *>(&z), sizeof(float));
-
-    Add3Items(x, y, z, i * 3, &(mesh->vertices_));
-  }
-}
-
-void ReadPlyFaces(std::ifstream *fin, TriangleMesh *mesh) {
-  unsigned char vertex_per_face;
-
-  const size_t kFaces = mesh->faces_.size() / 3;
-  for (size_t i = 0; i < kFaces; ++i) {
-    int v1, v2, v3;
-    fin->read(reinterpret_cast<char *>(&vertex_per_face),
-              sizeof(unsigned char));
-    assert(vertex_per_face == 3);
-
-    fin->read(reinterpret_cast<char *>(&v1), sizeof(int));
-    fin->read(reinterpret_cast<char *>(&v2), sizeof(int));
-    fin->read(reinterpret_cast<char *>(&v3), sizeof(int));
-    Add3Items(v1, v2, v3, i * 3, &(mesh->faces_));
-  }
-}
-
-void ComputeVertexNormals(const std::vector<float> &vertices,
-                          const std::vector<int> &faces,
-                          std::vector<float> *normals) {
-  const size_t kFaces = faces.size();
-  std::vector<float> face_normals(kFaces, 0);
-
-  for (size_t i = 0; i < kFaces; i += 3) {
-    Eigen::Vector3d v1(vertices[faces[i] * 3], vertices[faces[i] * 3 + 1],
-                       vertices[faces[i] * 3 + 2]);
-    Eigen::Vector3d v2(vertices[faces[i + 1] * 3],
-                       vertices[faces[i + 1] * 3 + 1],
-                       vertices[faces[i + 1] * 3 + 2]);
-    Eigen::Vector3d v3(vertices[faces[i + 2] * 3],
-                       vertices[faces[i + 2] * 3 + 1],
-                       vertices[faces[i + 2] * 3 + 2]);
-    Eigen::Vector3d v1v2 = v2 - v1;
-    Eigen::Vector3d v1v3 = v3 - v1;
-    Eigen::Vector3d normal = v1v2.cross(v1v3);
-
-    if (normal.norm() < 0.00001) {
-      normal = Eigen::Vector3d(0.0, 0.0, 0.0);
-    } else {
-      normal.normalize();
+/**
+ * @brief SkipAsciiProperty Skips the tokens of a property in an ASCII record.
+ */
+bool SkipAsciiProperty(const char **p, const char *end,
+                       const PlyProperty &property) {
+  float value;
+  if (!property.is_list()) return ParseFloat(p, end, &value);
+
+  int64_t entries = 0;
+  if (!ParseInt(p, end, &entries)) return false;
+  for (int64_t i = 0; i < entries; ++i)
+    if (!ParseFloat(p, end, &value)) return false;
+  return true;
+}
+
+/**
+ * @brief ParseAsciiVertex Parses a vertex line, storing the values of the
+ * requested properties in order.
+ * @param properties Indices of the requested properties.
+ * @param count Number of requested properties.
+ * @param values The parsed values of the requested properties.
+ */
+bool ParseAsciiVertex(const char **p, const char *end,
+                      const PlyElement &vertex, const int *properties,
+                      size_t count, float *values) {
+  const int kLast = *std::max_element(properties, properties + count);
+  for (int k = 0; k <= kLast; ++k) {
+    const PlyProperty &kProperty = vertex.properties[k];
+    if (kProperty.is_list()) {
+      if (!SkipAsciiProperty(p, end, kProperty)) return false;
+      continue;
     }
 
-    for (size_t j = 0; j < 3; ++j) face_normals[i + j] = normal[j];
-  }
-
-  const size_t kVertices = vertices.size();
-  normals->resize(kVertices, 0);
-  for (size_t i = 0; i < kFaces; i += 3) {
-    for (size_t j = 0; j < 3; ++j) {
-      size_t idx = static_cast<size_t>(faces[i + j]);
-      Eigen::Vector3d v1(vertices[faces[i + j] * 3],
-                         vertices[faces[i + j] * 3 + 1],
-                         vertices[faces[i + j] * 3 + 2]);
-      Eigen::Vector3d v2(vertices[faces[i + (j + 1) % 3] * 3],
-                         vertices[faces[i + (j + 1) % 3] * 3 + 1],
-                         vertices[faces[i + (j + 1) % 3] * 3 + 2]);
-      Eigen::Vector3d v3(vertices[faces[i + (j + 2) % 3] * 3],
-                         vertices[faces[i + (j + 2) % 3] * 3 + 1],
-                         vertices[faces[i + (j + 2) % 3] * 3 + 2]);
-
-      Eigen::Vector3d v1v2 = v2 - v1;
-      Eigen::Vector3d v1v3 = v3 - v1;
-      double angle = acos(v1v2.dot(v1v3) / (v1v2.norm() * v1v3.norm()));
-
-      if (angle == angle) {
-        for (size_t k = 0; k < 3; ++k) {
-          (*normals)[idx * 3 + k] += face_normals[i + k] * angle;
-        }
-      }
+    float value;
+    if (!ParseFloat(p, end, &value)) return false;
+    for (size_t j = 0; j < count; ++j)
+      if (properties[j] == k) values[j] = value;
+  }
+  return true;
+}
+
+/**
+ * @brief CountAsciiTriangles Reads the length of the index list of a face line
+ * and computes the number of triangles of its fan.
+ */
+bool CountAsciiTriangles(const char **p, const char *end,
+                         const PlyElement &face, int list,
+                         size_t *triangles) {
+  for (int k = 0; k < list; ++k)
+    if (!SkipAsciiProperty(p, end, face.properties[k])) return false;
+
+  int64_t count = 0;
+  if (!ParseInt(p, end, &count) || count < 0) return false;
+
+  // Every index takes at least two characters, which bounds the length of a
+  // malformed list before any memory is allocated for it.
+  if (count > (SkipLine(*p, end) - *p + 1) / 2) return false;
+  *triangles = count > 2 ? static_cast<size_t>(count - 2) : 0;
+  return true;
+}
+
+/**
+ * @brief ParseAsciiPolygon Parses the index list of a face line and writes its
+ * triangle fan.
+ * @param triangles The number of triangles written.
+ */
+bool ParseAsciiPolygon(const char **p, const char *end, const PlyElement &face,
+                       int list, int *faces, size_t *triangles) {
+  for (int k = 0; k < list; ++k)
+    if (!SkipAsciiProperty(p, end, face.properties[k])) return false;
+
+  int64_t count = 0, first = 0, previous = 0;
+  if (!ParseInt(p, end, &count)) return false;
+
+  *triangles = 0;
+  for (int64_t j = 0; j < count; ++j) {
+    int64_t index = 0;
+    if (!ParseInt(p, end, &index)) return false;
+    if (j == 0) first = index;
+    if (j >= 2) {
+      faces[0] = static_cast<int>(first);
+      faces[1] = static_cast<int>(previous);
+      faces[2] = static_cast<int>(index);
+      faces += 3;
+      ++*triangles;
     }
+    previous = index;
   }
+  return true;
+}
+
+/**
+ * @brief WalkAsciiChunk Calls visit(element, index, &p, end) for every record
+ * line of a chunk, index being the position of the record in its element,
+ * and moves to the next line afterwards.
+ * @param line Index of the first line of the chunk.
+ * @param element_line Index of the first line of every element, followed by
+ * the total number of records.
+ * @return Whether every record was accepted by visit.
+ */
+template <typename Visitor>
+bool WalkAsciiChunk(const char *p, const char *end, size_t line,
+                    const std::vector<size_t> &element_line,
+                    const Visitor &visit) {
+  const size_t kRecords = element_line.back();
+  size_t element =
+      std::upper_bound(element_line.begin(), element_line.end(), line) -
+      element_line.begin() - 1;
+  for (; p < end && line < kRecords; ++line) {
+    while (line >= element_line[element + 1]) ++element;
+    if (!visit(element, line - element_line[element], &p, end)) return false;
+    p = SkipLine(p, end);
+  }
+  return true;
+}
 
-  const size_t kNormals = normals->size();
-  for (size_t i = 0; i < kNormals; i += 3) {
-    Eigen::Vector3d normal((*normals)[i], (*normals)[i + 1], (*normals)[i + 2]);
-    if (normal.norm() > 0) {
-      normal.normalize();
+/**
+ * @brief ReadPlyAscii Parses the body of an ASCII PLY file. The text is split
+ * into line-aligned chunks and a first parallel pass counts the lines of each
+ * chunk so that every chunk knows the index of its first record. Faces may be
+ * polygons, so a second pass counts the triangles of every chunk to size the
+ * face array exactly. A last parallel pass parses the numbers straight into
+ * the mesh arrays.
+ */
+bool ReadPlyAscii(const char *begin, const char *end, const PlyHeader &header,
+                  TriangleMesh *mesh) {
+  const size_t kVertex = header.FindElement("vertex");
+  const int kFace = header.FindElement("face");
+  const PlyElement &kVertices = header.elements[kVertex];
+  const bool kColors = !mesh->colors_.empty();
+  const bool kNormals = !mesh->normals_.empty();
+  const char *kNames[9] = {"x",    "y",  "z",  "red", "green",
+                           "blue", "nx", "ny", "nz"};
+  // Positions, then colors and normals when the mesh wants them.
+  int properties[9];
+  size_t requested = 0;
+  for (int i = 0; i < 9; ++i) {
+    if ((i >= 3 && i < 6 && !kColors) || (i >= 6 && !kNormals)) continue;
+    properties[requested++] = kVertices.FindProperty(kNames[i]);
+  }
+  const size_t kNormalValues = kColors ? 6 : 3;
+  const int kList = kFace < 0 ? -1 : FindPlyIndexList(header.elements[kFace]);
+
+  // Every element occupies a contiguous range of lines.
+  std::vector<size_t> element_line(header.elements.size() + 1, 0);
+  for (size_t i = 0; i < header.elements.size(); ++i)
+    element_line[i + 1] = element_line[i] + header.elements[i].count;
+
+  const std::vector<const char *> kBounds =
+      SplitLines(begin, end, kAsciiChunkSize, NumThreads() * 4);
+  const size_t kChunks = kBounds.size() - 1;
+
+  std::vector<size_t> first_line(kChunks + 1, 0);
+  ParallelFor(kChunks, [&](size_t chunk) {
+    const char *kBegin = kBounds[chunk];
+    const char *kEnd = kBounds[chunk + 1];
+    size_t lines = std::count(kBegin, kEnd, '\n');
+    if (kEnd > kBegin && *(kEnd - 1) != '\n') ++lines;
+    first_line[chunk + 1] = lines;
+  });
+  for (size_t i = 0; i < kChunks; ++i) first_line[i + 1] += first_line[i];
+
+  if (first_line[kChunks] < element_line.back()) {
+    std::cout << "\tTruncated file " << std::endl;
+    return false;
+  }
+
+  std::atomic<bool> valid(true);
+  std::vector<size_t> first_triangle(kChunks + 1, 0);
+  if (kFace >= 0) {
+    const size_t kFaceBegin = element_line[kFace];
+    const size_t kFaceEnd = element_line[kFace + 1];
+    ParallelFor(kChunks, [&](size_t chunk) {
+      if (first_line[chunk + 1] <= kFaceBegin ||
+          first_line[chunk] >= kFaceEnd)
+        return;
+
+      size_t triangles = 0;
+      const bool kCounted = WalkAsciiChunk(
+          kBounds[chunk], kBounds[chunk + 1], first_line[chunk], element_line,
+          [&](size_t element, size_t, const char **p, const char *kEnd) {
+            if (element != static_cast<size_t>(kFace)) return true;
+            size_t count = 0;
+            if (!CountAsciiTriangles(p, kEnd, header.elements[kFace], kList,
+                                     &count))
+              return false;
+            triangles += count;
+            return true;
+          });
+      if (!kCounted) valid = false;
+      first_triangle[chunk + 1] = triangles;
+    });
+  }
+  if (!valid) {
+    std::cout << "\tMalformed ASCII payload " << std::endl;
+    return false;
+  }
+  for (size_t i = 0; i < kChunks; ++i)
+    first_triangle[i + 1] += first_triangle[i];
+  mesh->faces_.resize(first_triangle[kChunks] * 3);
+
+  ParallelFor(kChunks, [&](size_t chunk) {
+    float *vertices = mesh->vertices_.data();
+    float *normals = mesh->normals_.data();
+    unsigned char *colors = mesh->colors_.data();
+    int *faces = mesh->faces_.data() + first_triangle[chunk] * 3;
+
+    const bool kParsed = WalkAsciiChunk(
+        kBounds[chunk], kBounds[chunk + 1], first_line[chunk], element_line,
+        [&](size_t element, size_t index, const char **p, const char *kEnd) {
+          if (element == kVertex) {
+            float values[9];
+            if (!ParseAsciiVertex(p, kEnd, kVertices, properties, requested,
+                                  values))
+              return false;
+            std::copy(values, values + 3, vertices + index * 3);
+            for (int j = 0; kColors && j < 3; ++j) {
+              colors[index * 3 + j] = PlyColorComponent(
+                  kVertices.properties[properties[3 + j]].type,
+                  values[3 + j]);
+            }
+            if (kNormals) {
+              std::copy(values + kNormalValues, values + kNormalValues + 3,
+                        normals + index * 3);
+            }
+          } else if (element == static_cast<size_t>(kFace)) {
+            size_t triangles = 0;
+            if (!ParseAsciiPolygon(p, kEnd, header.elements[kFace], kList,
+                                   faces, &triangles))
+              return false;
+            faces += triangles * 3;
+          }
+          return true;
+        });
+    if (!kParsed) valid = false;
+  });
+
+  if (!valid) std::cout << "\tMalformed ASCII payload " << std::endl;
+  return valid;
+}
+
+/**
+ * @brief kVertexBlock Vertices per task of the binary vertex passes, small
+ * enough for the records and the decoded values of a block to stay in cache.
+ */
+const size_t kVertexBlock = 1 << 16;
+
+/**
+ * @brief ReadPlyBinary Decodes the vertex and face elements of a binary little
+ * endian payload, skipping any other element. Every stage works on blocks
+ * while they are in cache: the bounding box is extended as the positions of a
+ * block are decoded, and the indices of a face block are validated and turned
+ * into face normals right after they are triangulated.
+ * @param builder If given, is created and fed every face for the normals.
+ */
+bool ReadPlyBinary(const char *begin, const char *end, const PlyHeader &header,
+                   TriangleMesh *mesh,
+                   std::unique_ptr<VertexNormalBuilder> *builder,
+                   StageClock *clock, PlyReadStages *stages) {
+  // Locate the payloads first; faces are counted on the way.
+  const PlyElement *vertex = nullptr;
+  const PlyElement *face = nullptr;
+  const char *vertex_data = nullptr;
+  const char *face_data = nullptr;
+  PlyFaceBlocks blocks;
+  const char *p = begin;
+  for (const PlyElement &element : header.elements) {
+    const char *next;
+    if (element.name == "face") {
+      face = &element;
+      face_data = p;
+      next = CountPlyTriangles(p, end, element, &blocks);
     } else {
-      normal = Eigen::Vector3d(0, 0, 0);
+      if (element.name == "vertex") {
+        vertex = &element;
+        vertex_data = p;
+      }
+      next = SkipPlyElement(p, end, element);
+    }
+    if (next == nullptr) {
+      std::cout << "\tTruncated file " << std::endl;
+      return false;
+    }
+    p = next;
+  }
+
+  const size_t kVertices = vertex->count;
+  const size_t kVertexBlocks = (kVertices + kVertexBlock - 1) / kVertexBlock;
+  std::vector<float> bounds(kVertexBlocks * 6);
+  std::atomic<bool> valid(true);
+  ParallelFor(kVertexBlocks, [&](size_t block) {
+    const size_t kFirst = block * kVertexBlock;
+    PlyElement window = *vertex;
+    window.count = std::min(kVertexBlock, kVertices - kFirst);
+    const char *kRecords = vertex_data + kFirst * vertex->stride;
+    float *positions = mesh->vertices_.data() + kFirst * 3;
+    if (!DecodePlyPositions(kRecords, window, positions) ||
+        (!mesh->colors_.empty() &&
+         !DecodePlyColors(kRecords, window,
+                          mesh->colors_.data() + kFirst * 3)) ||
+        (!mesh->normals_.empty() &&
+         !DecodePlyNormals(kRecords, window,
+                           mesh->normals_.data() + kFirst * 3))) {
+      valid = false;
+      return;
     }
 
-    for (size_t j = 0; j < 3; ++j) (*normals)[i + j] = normal[j];
+    float *min = &bounds[block * 6];
+    float *max = min + 3;
+    for (int k = 0; k < 3; ++k) {
+      min[k] = mesh->min_[k];
+      max[k] = mesh->max_[k];
+    }
+    ExtendBounds(positions, window.count, min, max);
+  });
+  if (!valid) return false;
+  for (size_t block = 0; block < kVertexBlocks; ++block) {
+    for (int k = 0; k < 3; ++k) {
+      mesh->min_[k] = std::min(mesh->min_[k], bounds[block * 6 + k]);
+      mesh->max_[k] = std::max(mesh->max_[k], bounds[block * 6 + 3 + k]);
+    }
   }
+  clock->Lap(&stages->vertices);
+  std::cout << "\tLoaded vertices and bounding box " << std::endl;
+
+  const size_t kTriangles = face == nullptr ? 0 : blocks.triangles;
+  mesh->faces_.resize(kTriangles * 3);
+  if (builder != nullptr) {
+    builder->reset(new VertexNormalBuilder(mesh->vertices_.data(), kVertices,
+                                           kTriangles));
+  }
+  if (face == nullptr) return true;
+
+  const int kVertexCount = static_cast<int>(kVertices);
+  std::atomic<bool> indexed(true);
+  int *faces = mesh->faces_.data();
+  ParallelFor(PlyFaceBlockCount(*face, blocks), [&](size_t block) {
+    size_t first, triangles;
+    if (!DecodePlyFaceBlock(face_data, *face, blocks, block, faces, &first,
+                            &triangles)) {
+      valid = false;
+      return;
+    }
+    for (size_t i = first * 3; i < (first + triangles) * 3; ++i) {
+      if (faces[i] < 0 || faces[i] >= kVertexCount) {
+        indexed = false;
+        return;
+      }
+    }
+    if (builder != nullptr) (*builder)->AddFaces(faces, first, triangles);
+  });
+  if (!valid) return false;
+  if (!indexed) {
+    std::cout << "\tFaces reference missing vertices " << std::endl;
+    return false;
+  }
+  clock->Lap(&stages->faces);
+  std::cout << "\tLoaded faces " << std::endl;
+  return true;
 }
 
-void ComputeBoundingBox(const std::vector<float> vertices, TriangleMesh *mesh) {
-  const size_t kVertices = vertices.size() / 3;
-  for (size_t i = 0; i < kVertices; ++i) {
-    mesh->min_[0] = std::min(mesh->min_[0], vertices[i * 3]);
-    mesh->min_[1] = std::min(mesh->min_[1], vertices[i * 3 + 1]);
-    mesh->min_[2] = std::min(mesh->min_[2], vertices[i * 3 + 2]);
+/**
+ * @brief FillVertexBuffer Last pass of the binary loader: gathers the normals
+ * of every vertex block, if a builder is given, and interleaves the block
+ * with its normals into the vertex buffer while both are in cache.
+ */
+void FillVertexBuffer(VertexNormalBuilder *builder, TriangleMesh *mesh) {
+  const size_t kVertices = mesh->vertices_.size() / 3;
+  mesh->buffer_.resize(kVertices * kInterleavedFloats);
+  ParallelFor((kVertices + kVertexBlock - 1) / kVertexBlock, [&](size_t block) {
+    const size_t kFirst = block * kVertexBlock;
+    const size_t kLast = std::min(kVertices, kFirst + kVertexBlock);
+    if (builder != nullptr)
+      builder->Gather(kFirst, kLast, mesh->normals_.data() + kFirst * 3);
+    InterleaveVertices(mesh->vertices_.data(), mesh->normals_.data(), kFirst,
+                       kLast,
+                       mesh->buffer_.data() + kFirst * kInterleavedFloats);
+  });
+}
 
-    mesh->max_[0] = std::max(mesh->max_[0], vertices[i * 3]);
-    mesh->max_[1] = std::max(mesh->max_[1], vertices[i * 3 + 1]);
-    mesh->max_[2] = std::max(mesh->max_[2], vertices[i * 3 + 2]);
+/**
+ * @brief SwapPlyPayload Reopens a big endian file as a private copy-on-write
+ * view and converts its elements to little endian in place, so that the
+ * regular binary decoders can be used on it.
+ */
+bool SwapPlyPayload(const std::string &filename, const PlyHeader &header,
+                    MappedFile *file) {
+  if (!file->Open(filename, true)) return false;
+
+  char *p = file->mutable_data() + header.header_size;
+  const char *kEnd = file->data() + file->size();
+  for (const PlyElement &element : header.elements) {
+    // Fixed-size elements we do not decode can be skipped without reading.
+    const bool kSkip = element.name != "vertex" && element.name != "face" &&
+                       element.stride > 0;
+    const char *kNext = kSkip ? SkipPlyElement(p, kEnd, element)
+                              : SwapPlyElement(p, kEnd, element);
+    if (kNext == nullptr) return false;
+    p += kNext - p;
   }
+  std::cout << "\tConverted big endian payload " << std::endl;
+  return true;
 }
 
 }  // namespace
 
 bool ReadFromPly(const std::string &filename, TriangleMesh *mesh) {
-  std::ifstream fin;
+  return ReadFromPly(filename, mesh, NormalPolicy::kWhenMissing);
+}
 
-  fin.open(filename.c_str(), std::ios_base::in | std::ios_base::binary);
-  if (!fin.is_open() || !fin.good()) return false;
+bool ReadFromPly(const std::string &filename, TriangleMesh *mesh,
+                 NormalPolicy policy) {
+  PlyReadStages stages;
+  return ReadFromPly(filename, mesh, policy, &stages);
+}
 
-  int vertices = 0, faces = 0;
-  if (!ReadPlyHeader(&fin, &vertices, &faces)) {
-    fin.close();
+bool ReadFromPly(const std::string &filename, TriangleMesh *mesh,
+                 NormalPolicy policy, PlyReadStages *stages) {
+  const auto kStart = std::chrono::steady_clock::now();
+  StageClock clock;
+
+  MappedFile file;
+  if (!file.Open(filename)) return false;
+
+  PlyHeader header;
+  const int kVertex = ReadPlyHeader(file.data(), file.size(), &header)
+                          ? header.FindElement("vertex")
+                          : -1;
+  const int kFace = kVertex < 0 ? -1 : header.FindElement("face");
+  if (kVertex < 0 || header.elements[kVertex].count == 0 ||
+      header.elements[kVertex].FindProperty("x") < 0 ||
+      header.elements[kVertex].FindProperty("y") < 0 ||
+      header.elements[kVertex].FindProperty("z") < 0 ||
+      (kFace >= 0 && FindPlyIndexList(header.elements[kFace]) < 0)) {
     std::cout << "\tError loading headers " << std::endl;
     return false;
   }
+  if (!FitsPayload(header, file.size())) {
+    std::cout << "\tPayload too small for the declared elements " << std::endl;
+    return false;
+  }
+
+  const size_t kVertices = header.elements[kVertex].count;
+  const size_t kFaces = kFace < 0 ? 0 : header.elements[kFace].count;
+  std::cout << "Loading triangle mesh" << std::endl;
+  std::cout << "\tVertices = " << kVertices << std::endl;
+  std::cout << "\tFaces = " << kFaces << std::endl;
+  clock.Lap(&stages->header);
   std::cout << "\tHeaders loaded " << std::endl;
-  mesh->vertices_.resize(static_cast<size_t>(vertices) * 3);
-  ReadPlyVertices(&fin, mesh);
-  std::cout << "\tLoaded vertices " << std::endl;
-  mesh->faces_.resize(static_cast<size_t>(faces) * 3);
-  ReadPlyFaces(&fin, mesh);
-  std::cout << "\tLoaded faces " << std::endl;
-  fin.close();
 
-  ComputeVertexNormals(mesh->vertices_, mesh->faces_, &mesh->normals_);
-  std::cout << "\tGenerated normals " << std::endl;
-  ComputeBoundingBox(mesh->vertices_, mesh);
-  std::cout << "\tGenerated bounding box " << std::endl;
-  mesh->prepareVertexBuffer();
+  // A reused mesh must not keep the colors, levels or bounds of the last
+  // model.
+  mesh->Clear();
+  mesh->vertices_.resize(kVertices * 3);
+  if (HasColors(header.elements[kVertex]))
+    mesh->colors_.resize(kVertices * 3);
+  const bool kFileNormals =
+      policy != NormalPolicy::kAlways && HasNormals(header.elements[kVertex]);
+  if (kFileNormals) mesh->normals_.resize(kVertices * 3);
+
+  const bool kAscii = header.format == PlyFormat::kAscii;
+  const bool kComputeNormals = !kFileNormals && policy != NormalPolicy::kNever;
+  std::unique_ptr<VertexNormalBuilder> builder;
+  // SwapPlyPayload maps the file again, so payload bounds are only taken
+  // from the mapping in use.
+  if (kAscii) {
+    if (!ReadPlyAscii(file.data() + header.header_size,
+                      file.data() + file.size(), header, mesh))
+      return false;
+    clock.Lap(&stages->vertices);
+    std::cout << "\tLoaded vertices and faces " << std::endl;
+  } else if (header.format == PlyFormat::kBinaryBigEndian &&
+             !SwapPlyPayload(filename, header, &file)) {
+    std::cout << "\tError converting big endian payload " << std::endl;
+    return false;
+  } else if (!ReadPlyBinary(file.data() + header.header_size,
+                            file.data() + file.size(), header, mesh,
+                            kComputeNormals ? &builder : nullptr, &clock,
+                            stages)) {
+    std::cout << "\tError loading payload " << std::endl;
+    return false;
+  }
+
+  if (mesh->faces_.size() != kFaces * 3) {
+    std::cout << "\tTriangulated " << kFaces << " faces into "
+              << mesh->faces_.size() / 3 << " triangles " << std::endl;
+  }
+
+  if (kAscii && !ValidateFaces(*mesh)) {
+    std::cout << "\tFaces reference missing vertices " << std::endl;
+    return false;
+  }
+  clock.Lap(&stages->faces);
+
+  const double kSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - kStart)
+                              .count();
+  std::cout << "\tRead " << file.size() / (1024.0 * 1024.0) << " MB in "
+            << kSeconds * 1000.0 << " ms ("
+            << file.size() / (kSeconds * 1e9) << " GB/s, "
+            << (file.mapped() ? "mapped" : "buffered") << ")" << std::endl;
+  file.Close();
+  clock.Lap(&stages->faces);
+
+  if (kFileNormals) {
+    std::cout << "\tRead normals from file " << std::endl;
+  } else if (!kComputeNormals) {
+    mesh->normals_.assign(kVertices * 3, 0.0f);
+    std::cout << "\tSkipped normals " << std::endl;
+  } else if (builder != nullptr) {
+    // The vertices gather their normals in the vertex buffer pass.
+    builder->Finish(mesh->faces_.data());
+    mesh->normals_.resize(kVertices * 3);
+    std::cout << "\tGenerated normal adjacency " << std::endl;
+  } else {
+    ComputeVertexNormals(mesh->vertices_, mesh->faces_, &mesh->normals_);
+    std::cout << "\tGenerated normals " << std::endl;
+  }
+  clock.Lap(&stages->normals);
+  if (kAscii) {
+    ComputeBoundingBox(mesh->vertices_, mesh);
+    clock.Lap(&stages->bounding_box);
+    std::cout << "\tGenerated bounding box " << std::endl;
+    mesh->prepareVertexBuffer();
+  } else {
+    FillVertexBuffer(builder.get(), mesh);
+  }
+  clock.Lap(&stages->vertex_buffer);
   std::cout << "\tPrepared vertex buffer " << std::endl;
   return true;
 }
 
-
 bool WriteToPly(const std::string &filename, const TriangleMesh &mesh) {
-  (void)filename;
-  (void)mesh;
+  return WriteToPly(filename, mesh, PlyWriteOptions());
+}
 
-  std::cerr << "Not yet implemented" << std::endl;
+bool WriteToPly(const std::string &filename, const TriangleMesh &mesh,
+                const PlyWriteOptions &options) {
+  const auto kStart = std::chrono::steady_clock::now();
+
+  const size_t kVertices = mesh.vertices_.size() / 3;
+  const size_t kFaces = mesh.triangle_count();
+  const bool kNormals =
+      options.normals && mesh.normals_.size() == mesh.vertices_.size();
+  const bool kColors =
+      options.colors && mesh.colors_.size() == mesh.vertices_.size();
+
+  std::ostringstream header;
+  header << "ply\n"
+         << "format binary_little_endian 1.0\n"
+         << "comment Generated by ViewerPBS\n"
+         << "element vertex " << kVertices << "\n"
+         << "property float x\nproperty float y\nproperty float z\n";
+  if (kNormals)
+    header << "property float nx\nproperty float ny\nproperty float nz\n";
+  if (kColors)
+    header << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+  header << "element face " << kFaces << "\n"
+         << "property list uchar int vertex_indices\n"
+         << "end_header\n";
+
+  int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::cerr << "Could not open " << filename << std::endl;
+    return false;
+  }
 
-  // TODO(students): Implement storing to PLY format.
+  const std::string kHeader = header.str();
+  bool res = WriteAll(fd, kHeader.data(), kHeader.size());
+
+  const size_t kVertexStride =
+      3 * sizeof(float) * (kNormals ? 2 : 1) + (kColors ? 3 : 0);
+  if (res && !kNormals && !kColors) {
+    // Bare positions already are the payload layout.
+    res = WriteAll(fd, reinterpret_cast<const char *>(mesh.vertices_.data()),
+                   mesh.vertices_.size() * sizeof(float));
+  } else if (res) {
+    res = WriteRecords(fd, kVertices, kVertexStride,
+                       [&](size_t i, char *record) {
+                         memcpy(record, &mesh.vertices_[i * 3],
+                                3 * sizeof(float));
+                         record += 3 * sizeof(float);
+                         if (kNormals) {
+                           memcpy(record, &mesh.normals_[i * 3],
+                                  3 * sizeof(float));
+                           record += 3 * sizeof(float);
+                         }
+                         if (kColors) memcpy(record, &mesh.colors_[i * 3], 3);
+                       });
+  }
 
-  // END.
+  res = res && WriteRecords(fd, kFaces, kFaceRecordSize,
+                            [&](size_t i, char *record) {
+                              record[0] = 3;
+                              memcpy(record + 1, &mesh.faces_[i * 3],
+                                     3 * sizeof(int));
+                            });
+
+  const off_t kBytes = lseek(fd, 0, SEEK_CUR);
+  res = close(fd) == 0 && res;
+  if (!res) {
+    std::cerr << "Error writing " << filename << std::endl;
+    return false;
+  }
 
-  return false;
+  const double kSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - kStart)
+                              .count();
+  std::cout << "Wrote " << kBytes / (1024.0 * 1024.0) << " MB in "
+            << kSeconds * 1000.0 << " ms (" << kBytes / (kSeconds * 1e9)
+            << " GB/s)" << std::endl;
+  return true;
 }
 
 }  // namespace data_representation
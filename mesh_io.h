@@ -7,26 +7,97 @@
 
 #include <string>
 
+#include "./mesh_processing.h"
+
 namespace data_representation {
 
 /**
  * @brief ReadFromPly Read the mesh stored in PLY format at the path filename
- * and stores the corresponding TriangleMesh representation
+ * and stores the corresponding TriangleMesh representation. Normals stored in
+ * the file are used, and computed only if it has none.
  * @param filename The path to the PLY mesh.
- * @param mesh The resulting representation with computed per-vertex normals.
+ * @param mesh The resulting representation with per-vertex normals.
  * @return Whether it was able to read the file.
  */
 bool ReadFromPly(const std::string &filename, TriangleMesh *mesh);
 
 /**
- * @brief WriteToPly Stores the mesh representation in PLY format at the path
- * filename.
+ * @brief ReadFromPly Same as above, choosing between the nx, ny, nz properties
+ * of the file and computed normals.
+ * @param filename The path to the PLY mesh.
+ * @param mesh The resulting representation with per-vertex normals.
+ * @param policy When normals are computed.
+ * @return Whether it was able to read the file.
+ */
+bool ReadFromPly(const std::string &filename, TriangleMesh *mesh,
+                 NormalPolicy policy);
+
+/**
+ * @brief PlyReadStages Seconds spent by ReadFromPly in each of its stages.
+ * ASCII files are parsed in a single pass, which is counted as vertices, and
+ * the conversion of big endian payloads is counted with the vertices too.
+ * Normals read from the file are decoded with the vertices. Binary files are
+ * read by a fused pipeline: the bounding box is computed with the vertices
+ * and the face normals with the faces, so bounding_box stays 0, and the last
+ * pass that gathers the vertex normals and fills the vertex buffer is counted
+ * as vertex_buffer.
+ */
+struct PlyReadStages {
+  double header = 0.0;
+  double vertices = 0.0;
+  double faces = 0.0;
+  double normals = 0.0;
+  double bounding_box = 0.0;
+  double vertex_buffer = 0.0;
+};
+
+/**
+ * @brief ReadFromPly Same as above, timing every stage.
+ * @param filename The path to the PLY mesh.
+ * @param mesh The resulting representation with per-vertex normals.
+ * @param policy When normals are computed.
+ * @param stages The time spent in each stage, added to the given values.
+ * @return Whether it was able to read the file.
+ */
+bool ReadFromPly(const std::string &filename, TriangleMesh *mesh,
+                 NormalPolicy policy, PlyReadStages *stages);
+
+/**
+ * @brief PlyWriteOptions Optional per-vertex properties stored by WriteToPly.
+ * A property is only written if the mesh has it.
+ */
+struct PlyWriteOptions {
+  /**
+   * @brief normals Whether to store the nx, ny, nz properties.
+   */
+  bool normals = true;
+
+  /**
+   * @brief colors Whether to store the red, green, blue properties.
+   */
+  bool colors = true;
+};
+
+/**
+ * @brief WriteToPly Stores the mesh representation in binary little endian PLY
+ * format at the path filename, with normals and colors if it has them.
  * @param filename The path where the mesh will be stored.
  * @param mesh The mesh to be stored.
  * @return Whether it was able to store the file.
  */
 bool WriteToPly(const std::string &filename, const TriangleMesh &mesh);
 
+/**
+ * @brief WriteToPly Stores the mesh representation in binary little endian PLY
+ * format at the path filename.
+ * @param filename The path where the mesh will be stored.
+ * @param mesh The mesh to be stored.
+ * @param options The optional properties to store.
+ * @return Whether it was able to store the file.
+ */
+bool WriteToPly(const std::string &filename, const TriangleMesh &mesh,
+                const PlyWriteOptions &options);
+
 }  // namespace data_representation
 
 #endif  // MESH_IO_H_
@@ -0,0 +1,579 @@
+// Author: Marc Comino 2020
+
+#include <mesh_optimizer.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "./geometry_kernels.h"
+#include "./parallel.h"
+#include "./radix_sort.h"
+#include "./vertex_buffer.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kClusterTriangles Triangles reordered together by one task.
+ */
+const size_t kClusterTriangles = 1 << 16;
+
+/**
+ * @brief kMortonBits Bits per axis of the cells that order the clusters.
+ */
+const int kMortonBits = 10;
+
+/**
+ * @brief SpreadBits Inserts two zero bits above each of the low kMortonBits
+ * bits, to interleave three coordinates into a Morton code.
+ */
+uint64_t SpreadBits(uint64_t value) {
+  value = (value | value << 16) & 0x030000FFULL;
+  value = (value | value << 8) & 0x0300F00FULL;
+  value = (value | value << 4) & 0x030C30C3ULL;
+  value = (value | value << 2) & 0x09249249ULL;
+  return value;
+}
+
+/**
+ * @brief SortByCell Orders the triangles by the Morton code of the cell of
+ * their centroid, so that consecutive triangles are close whatever order the
+ * file stored them in.
+ */
+void SortByCell(const std::vector<float> &vertices, std::vector<int> *faces) {
+  const size_t kTriangles = faces->size() / 3;
+  float min[3], max[3];
+  std::fill_n(min, 3, std::numeric_limits<float>::max());
+  std::fill_n(max, 3, std::numeric_limits<float>::lowest());
+  ExtendBounds(vertices.data(), vertices.size() / 3, min, max);
+
+  // Cubic cells, so that clusters are compact on flat models too.
+  const float kCells = static_cast<float>((1 << kMortonBits) - 1);
+  const float kExtent =
+      std::max(max[0] - min[0], std::max(max[1] - min[1], max[2] - min[2]));
+  const float kScale = kExtent > 0.0f ? kCells / (3.0f * kExtent) : 0.0f;
+
+  std::vector<uint64_t> keys(kTriangles);
+  std::vector<uint32_t> order(kTriangles);
+  const int *kFaces = faces->data();
+  ParallelForRange(0, kTriangles, kClusterTriangles, [&](size_t begin,
+                                                         size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      uint64_t key = 0;
+      for (int k = 0; k < 3; ++k) {
+        const float kSum = vertices[kFaces[i * 3] * size_t(3) + k] +
+                           vertices[kFaces[i * 3 + 1] * size_t(3) + k] +
+                           vertices[kFaces[i * 3 + 2] * size_t(3) + k];
+        const float kCell = (kSum - 3.0f * min[k]) * kScale;
+        // NaN coordinates end up in cell 0.
+        const uint64_t kIndex =
+            kCell >= 0.0f ? static_cast<uint64_t>(std::min(kCell, kCells)) : 0;
+        key |= SpreadBits(kIndex) << k;
+      }
+      keys[i] = key;
+      order[i] = static_cast<uint32_t>(i);
+    }
+  });
+  RadixSortPairs(&keys, &order, 3 * kMortonBits);
+
+  std::vector<int> sorted(faces->size());
+  ParallelForRange(0, kTriangles, kClusterTriangles, [&](size_t begin,
+                                                         size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      std::copy_n(kFaces + order[i] * size_t(3), 3, &sorted[i * 3]);
+  });
+  faces->swap(sorted);
+}
+
+/**
+ * @brief ClusterAdjacency The triangles of a cluster with its vertices
+ * renumbered from 0, and the triangles around every vertex.
+ */
+struct ClusterAdjacency {
+  std::vector<int> corners;
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> triangles;
+  size_t vertex_count;
+};
+
+void BuildAdjacency(const int *faces, size_t triangles,
+                    ClusterAdjacency *adjacency) {
+  // Sorting the corners by vertex numbers the vertices and groups the
+  // triangles around each of them in one pass.
+  const size_t kCorners = triangles * 3;
+  std::vector<uint64_t> keys(kCorners);
+  for (size_t i = 0; i < kCorners; ++i)
+    keys[i] = static_cast<uint64_t>(static_cast<uint32_t>(faces[i])) << 32 | i;
+  std::sort(keys.begin(), keys.end());
+
+  adjacency->corners.resize(kCorners);
+  adjacency->triangles.resize(kCorners);
+  adjacency->offsets.clear();
+  for (size_t i = 0; i < kCorners; ++i) {
+    if (i == 0 || keys[i] >> 32 != keys[i - 1] >> 32)
+      adjacency->offsets.push_back(static_cast<uint32_t>(i));
+    const uint32_t kCorner = static_cast<uint32_t>(keys[i]);
+    adjacency->corners[kCorner] =
+        static_cast<int>(adjacency->offsets.size() - 1);
+    adjacency->triangles[i] = kCorner / 3;
+  }
+  adjacency->vertex_count = adjacency->offsets.size();
+  adjacency->offsets.push_back(static_cast<uint32_t>(kCorners));
+}
+
+/**
+ * @brief TipsifyCluster Reorders the triangles of a cluster in place. Fans
+ * around a vertex are emitted while its remaining triangles fit in the
+ * cache; the next vertex is the candidate that stays longest in the cache,
+ * or else a vertex left behind on the dead-end stack, or the first vertex
+ * with triangles left in the input order of the triangles.
+ */
+void TipsifyCluster(int *faces, size_t triangles) {
+  ClusterAdjacency adjacency;
+  BuildAdjacency(faces, triangles, &adjacency);
+  const size_t kVertices = adjacency.vertex_count;
+  const int kCache = static_cast<int>(kVertexCacheSize);
+
+  std::vector<int> live(kVertices);
+  for (size_t v = 0; v < kVertices; ++v)
+    live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+  std::vector<int> cache_time(kVertices, 0);
+  std::vector<char> emitted(triangles, 0);
+  std::vector<int> dead_ends;
+  std::vector<int> candidates;
+  std::vector<uint32_t> order;
+  order.reserve(triangles);
+
+  int time = kCache + 1;
+  size_t cursor = 0;
+  int fan = triangles > 0 ? adjacency.corners[0] : -1;
+  while (fan >= 0) {
+    candidates.clear();
+    for (uint32_t a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1];
+         ++a) {
+      const uint32_t kTriangle = adjacency.triangles[a];
+      if (emitted[kTriangle]) continue;
+      emitted[kTriangle] = 1;
+      order.push_back(kTriangle);
+      for (int k = 0; k < 3; ++k) {
+        const int kVertex = adjacency.corners[kTriangle * 3 + k];
+        dead_ends.push_back(kVertex);
+        candidates.push_back(kVertex);
+        --live[kVertex];
+        if (time - cache_time[kVertex] > kCache) cache_time[kVertex] = time++;
+      }
+    }
+
+    // Prefer the candidate that entered the cache first among those whose
+    // fan still fits in it.
+    fan = -1;
+    int best = -1;
+    for (int vertex : candidates) {
+      if (live[vertex] <= 0) continue;
+      int priority = 0;
+      if (time - cache_time[vertex] + 2 * live[vertex] <= kCache)
+        priority = time - cache_time[vertex];
+      if (priority > best) {
+        best = priority;
+        fan = vertex;
+      }
+    }
+    while (fan < 0 && !dead_ends.empty()) {
+      const int kVertex = dead_ends.back();
+      dead_ends.pop_back();
+      if (live[kVertex] > 0) fan = kVertex;
+    }
+    while (fan < 0 && cursor < adjacency.corners.size()) {
+      if (live[adjacency.corners[cursor]] > 0)
+        fan = adjacency.corners[cursor];
+      ++cursor;
+    }
+  }
+
+  std::vector<int> reordered(triangles * 3);
+  for (size_t i = 0; i < triangles; ++i)
+    std::copy_n(faces + order[i] * 3, 3, &reordered[i * 3]);
+  std::copy(reordered.begin(), reordered.end(), faces);
+}
+
+/**
+ * @brief FifoCache A FIFO post-transform vertex cache that can be flushed.
+ */
+class FifoCache {
+ public:
+  FifoCache() { Clear(); }
+
+  void Clear() {
+    std::fill_n(entries_, kVertexCacheSize, -1);
+    next_ = 0;
+  }
+
+  /**
+   * @brief Load Uses the vertices of a triangle.
+   * @return The number of them that missed.
+   */
+  int Load(const int *triangle) {
+    int misses = 0;
+    for (int k = 0; k < 3; ++k) {
+      if (std::find(entries_, entries_ + kVertexCacheSize, triangle[k]) !=
+          entries_ + kVertexCacheSize)
+        continue;
+      entries_[next_] = triangle[k];
+      next_ = (next_ + 1) % kVertexCacheSize;
+      ++misses;
+    }
+    return misses;
+  }
+
+ private:
+  int entries_[kVertexCacheSize];
+  size_t next_;
+};
+
+/**
+ * @brief SplitClusters Appends the first triangle of every overdraw cluster
+ * of the triangles [first, last), see OptimizeOverdraw.
+ */
+void SplitClusters(const int *faces, size_t first, size_t last,
+                   float threshold, std::vector<size_t> *starts) {
+  // Runs start at the triangles that miss all their vertices, as a new fan
+  // does.
+  FifoCache cache;
+  std::vector<size_t> runs;
+  std::vector<size_t> run_misses;
+  for (size_t i = first; i < last; ++i) {
+    const int kMisses = cache.Load(faces + i * 3);
+    if (i == first || kMisses == 3) {
+      runs.push_back(i);
+      run_misses.push_back(0);
+    }
+    run_misses.back() += kMisses;
+  }
+  runs.push_back(last);
+
+  for (size_t r = 0; r + 1 < runs.size(); ++r) {
+    const float kLimit = threshold * run_misses[r] / (runs[r + 1] - runs[r]);
+    starts->push_back(runs[r]);
+    cache.Clear();
+    size_t start = runs[r];
+    int misses = 0;
+    for (size_t i = runs[r]; i + 1 < runs[r + 1]; ++i) {
+      misses += cache.Load(faces + i * 3);
+      if (misses > kLimit * (i - start + 1)) continue;
+      start = i + 1;
+      starts->push_back(start);
+      cache.Clear();
+      misses = 0;
+    }
+  }
+}
+
+/**
+ * @brief ClusterSums Area weighted sums over the triangles of a cluster.
+ */
+struct ClusterSums {
+  double centroid[3] = {0.0, 0.0, 0.0};
+  double normal[3] = {0.0, 0.0, 0.0};
+  double area = 0.0;
+};
+
+ClusterSums SumCluster(const std::vector<float> &vertices, const int *faces,
+                       size_t first, size_t last) {
+  ClusterSums sums;
+  for (size_t i = first; i < last; ++i) {
+    const float *kA = &vertices[faces[i * 3] * size_t(3)];
+    const float *kB = &vertices[faces[i * 3 + 1] * size_t(3)];
+    const float *kC = &vertices[faces[i * 3 + 2] * size_t(3)];
+    const double kU[3] = {kB[0] - kA[0], kB[1] - kA[1], kB[2] - kA[2]};
+    const double kV[3] = {kC[0] - kA[0], kC[1] - kA[1], kC[2] - kA[2]};
+    const double kCross[3] = {kU[1] * kV[2] - kU[2] * kV[1],
+                              kU[2] * kV[0] - kU[0] * kV[2],
+                              kU[0] * kV[1] - kU[1] * kV[0]};
+    const double kArea = std::sqrt(kCross[0] * kCross[0] +
+                                   kCross[1] * kCross[1] +
+                                   kCross[2] * kCross[2]);
+    for (int k = 0; k < 3; ++k) {
+      sums.centroid[k] += kArea * (kA[k] + kB[k] + kC[k]) / 3.0;
+      sums.normal[k] += kCross[k];
+    }
+    sums.area += kArea;
+  }
+  return sums;
+}
+
+/**
+ * @brief RasterizeView Draws the front faces of the mesh seen along axis,
+ * from the positive side if sign is 1, into a kOverdrawResolution square
+ * fitted to the bounding box.
+ * @param shaded Incremented by the fragments that pass the depth test.
+ * @param covered Incremented by the pixels drawn at least once.
+ */
+void RasterizeView(const std::vector<float> &vertices,
+                   const std::vector<int> &faces, const float min[3],
+                   float extent, int axis, float sign, size_t *shaded,
+                   size_t *covered) {
+  const int kU = (axis + 1) % 3;
+  const int kV = (axis + 2) % 3;
+  const float kScale = kOverdrawResolution / extent;
+  std::vector<float> depth(kOverdrawResolution * kOverdrawResolution,
+                           std::numeric_limits<float>::infinity());
+  for (size_t i = 0; i < faces.size(); i += 3) {
+    float x[3], y[3], z[3];
+    for (int c = 0; c < 3; ++c) {
+      const float *kPoint = &vertices[faces[i + c] * size_t(3)];
+      x[c] = (kPoint[kU] - min[kU]) * kScale;
+      y[c] = (kPoint[kV] - min[kV]) * kScale;
+      z[c] = -sign * kPoint[axis];
+    }
+    // Seen from the negative side the projection is mirrored.
+    const float kArea =
+        sign * ((x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]));
+    if (!(kArea > 0.0f)) continue;
+
+    const int kMinX = std::max(
+        0, static_cast<int>(std::ceil(std::min({x[0], x[1], x[2]}) - 0.5f)));
+    const int kMaxX =
+        std::min(kOverdrawResolution - 1,
+                 static_cast<int>(std::floor(std::max({x[0], x[1], x[2]}) -
+                                             0.5f)));
+    const int kMinY = std::max(
+        0, static_cast<int>(std::ceil(std::min({y[0], y[1], y[2]}) - 0.5f)));
+    const int kMaxY =
+        std::min(kOverdrawResolution - 1,
+                 static_cast<int>(std::floor(std::max({y[0], y[1], y[2]}) -
+                                             0.5f)));
+    for (int py = kMinY; py <= kMaxY; ++py) {
+      for (int px = kMinX; px <= kMaxX; ++px) {
+        const float kX = px + 0.5f;
+        const float kY = py + 0.5f;
+        float weights[3];
+        for (int c = 0; c < 3; ++c) {
+          const int kB = (c + 1) % 3;
+          const int kC = (c + 2) % 3;
+          weights[c] = sign * ((x[kC] - x[kB]) * (kY - y[kB]) -
+                               (kX - x[kB]) * (y[kC] - y[kB]));
+        }
+        if (weights[0] < 0.0f || weights[1] < 0.0f || weights[2] < 0.0f)
+          continue;
+        const float kDepth =
+            (weights[0] * z[0] + weights[1] * z[1] + weights[2] * z[2]) /
+            kArea;
+        float &stored = depth[py * kOverdrawResolution + px];
+        if (!(kDepth < stored)) continue;
+        if (stored == std::numeric_limits<float>::infinity()) ++*covered;
+        stored = kDepth;
+        ++*shaded;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Permute Moves the records of width elements of data so that record
+ * i comes from record sources[i]. Arrays of another size, such as missing
+ * attributes, are left alone.
+ */
+template <typename T>
+void Permute(const std::vector<uint32_t> &sources, size_t width,
+             std::vector<T> *data) {
+  if (data->size() != sources.size() * width) return;
+  std::vector<T> permuted(data->size());
+  const T *kData = data->data();
+  ParallelForRange(0, sources.size(), kClusterTriangles,
+                   [&](size_t begin, size_t end) {
+                     for (size_t i = begin; i < end; ++i)
+                       std::copy_n(kData + sources[i] * width, width,
+                                   &permuted[i * width]);
+                   });
+  data->swap(permuted);
+}
+
+}  // namespace
+
+bool operator==(const MeshOptimization &a, const MeshOptimization &b) {
+  return a.overdraw_threshold == b.overdraw_threshold &&
+         a.vertex_fetch == b.vertex_fetch && a.lods == b.lods;
+}
+
+VertexCacheStats AnalyzeVertexCache(const int *faces, size_t triangles,
+                                    size_t vertex_count, size_t vertex_size) {
+  // A vertex is in the FIFO while fewer than kVertexCacheSize misses
+  // happened after its own. Every miss reads the lines of its record that
+  // are not in the fetch cache.
+  std::vector<size_t> loaded(vertex_count, 0);
+  std::vector<size_t> lines(kFetchCacheLines, ~size_t(0));
+  size_t misses = 0;
+  size_t referenced = 0;
+  size_t fetched = 0;
+  for (size_t i = 0; i < triangles * 3; ++i) {
+    size_t &vertex = loaded[faces[i]];
+    if (vertex != 0 && misses - vertex < kVertexCacheSize) continue;
+    if (vertex == 0) ++referenced;
+    vertex = ++misses;
+
+    const size_t kFirst = faces[i] * vertex_size / kFetchCacheLine;
+    const size_t kLast =
+        (faces[i] * vertex_size + vertex_size - 1) / kFetchCacheLine;
+    for (size_t line = kFirst; line <= kLast; ++line) {
+      size_t &cached = lines[line % kFetchCacheLines];
+      if (cached == line) continue;
+      cached = line;
+      fetched += kFetchCacheLine;
+    }
+  }
+
+  VertexCacheStats stats;
+  if (triangles > 0) stats.acmr = static_cast<double>(misses) / triangles;
+  if (referenced > 0) {
+    stats.atvr = static_cast<double>(misses) / referenced;
+    stats.overfetch = static_cast<double>(fetched) / (referenced * vertex_size);
+  }
+  return stats;
+}
+
+void OptimizeVertexCache(const std::vector<float> &vertices,
+                         std::vector<int> *faces) {
+  SortByCell(vertices, faces);
+  const size_t kTriangles = faces->size() / 3;
+  ParallelFor((kTriangles + kClusterTriangles - 1) / kClusterTriangles,
+              [&](size_t cluster) {
+                const size_t kFirst = cluster * kClusterTriangles;
+                TipsifyCluster(faces->data() + kFirst * 3,
+                               std::min(kClusterTriangles,
+                                        kTriangles - kFirst));
+              });
+}
+
+void OptimizeOverdraw(const std::vector<float> &vertices,
+                      std::vector<int> *faces, float threshold) {
+  // Clusters never straddle the blocks OptimizeVertexCache reordered on
+  // their own, so the blocks are split in parallel.
+  const size_t kTriangles = faces->size() / 3;
+  const size_t kBlocks =
+      (kTriangles + kClusterTriangles - 1) / kClusterTriangles;
+  std::vector<std::vector<size_t>> block_starts(kBlocks);
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kFirst = block * kClusterTriangles;
+    SplitClusters(faces->data(), kFirst,
+                  std::min(kFirst + kClusterTriangles, kTriangles), threshold,
+                  &block_starts[block]);
+  });
+  std::vector<size_t> starts;
+  for (const std::vector<size_t> &block : block_starts)
+    starts.insert(starts.end(), block.begin(), block.end());
+  const size_t kClusters = starts.size();
+  starts.push_back(kTriangles);
+
+  std::vector<ClusterSums> sums(kClusters);
+  ParallelForRange(0, kClusters, 64, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c)
+      sums[c] = SumCluster(vertices, faces->data(), starts[c], starts[c + 1]);
+  });
+  double center[3] = {0.0, 0.0, 0.0};
+  double area = 0.0;
+  for (const ClusterSums &cluster : sums) {
+    for (int k = 0; k < 3; ++k) center[k] += cluster.centroid[k];
+    area += cluster.area;
+  }
+  if (area > 0.0)
+    for (int k = 0; k < 3; ++k) center[k] /= area;
+
+  std::vector<double> keys(kClusters, 0.0);
+  for (size_t c = 0; c < kClusters; ++c) {
+    const ClusterSums &kCluster = sums[c];
+    const double kLength = std::sqrt(kCluster.normal[0] * kCluster.normal[0] +
+                                     kCluster.normal[1] * kCluster.normal[1] +
+                                     kCluster.normal[2] * kCluster.normal[2]);
+    if (kCluster.area <= 0.0 || kLength <= 0.0) continue;
+    for (int k = 0; k < 3; ++k)
+      keys[c] += (kCluster.centroid[k] / kCluster.area - center[k]) *
+                 kCluster.normal[k] / kLength;
+  }
+  std::vector<uint32_t> order(kClusters);
+  for (size_t c = 0; c < kClusters; ++c) order[c] = static_cast<uint32_t>(c);
+  std::stable_sort(
+      order.begin(), order.end(),
+      [&keys](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+  std::vector<size_t> targets(kClusters + 1, 0);
+  for (size_t c = 0; c < kClusters; ++c)
+    targets[c + 1] = targets[c] + starts[order[c] + 1] - starts[order[c]];
+  std::vector<int> sorted(faces->size());
+  const int *kFaces = faces->data();
+  ParallelForRange(0, kClusters, 64, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c)
+      std::copy(kFaces + starts[order[c]] * 3,
+                kFaces + starts[order[c] + 1] * 3, &sorted[targets[c] * 3]);
+  });
+  faces->swap(sorted);
+}
+
+double AnalyzeOverdraw(const std::vector<float> &vertices,
+                       const std::vector<int> &faces) {
+  float min[3], max[3];
+  std::fill_n(min, 3, std::numeric_limits<float>::max());
+  std::fill_n(max, 3, std::numeric_limits<float>::lowest());
+  ExtendBounds(vertices.data(), vertices.size() / 3, min, max);
+  const float kExtent =
+      std::max(max[0] - min[0], std::max(max[1] - min[1], max[2] - min[2]));
+  if (!(kExtent > 0.0f)) return 0.0;
+
+  // Slightly wider than the model, so that its far sides land on pixels.
+  const float kPadded = kExtent * (1.0f + 1.0f / kOverdrawResolution);
+  size_t shaded[6] = {0, 0, 0, 0, 0, 0};
+  size_t covered[6] = {0, 0, 0, 0, 0, 0};
+  ParallelFor(6, [&](size_t view) {
+    RasterizeView(vertices, faces, min, kPadded, static_cast<int>(view / 2),
+                  view % 2 == 0 ? 1.0f : -1.0f, &shaded[view],
+                  &covered[view]);
+  });
+  size_t total_shaded = 0, total_covered = 0;
+  for (int view = 0; view < 6; ++view) {
+    total_shaded += shaded[view];
+    total_covered += covered[view];
+  }
+  return total_covered > 0
+             ? static_cast<double>(total_shaded) / total_covered
+             : 0.0;
+}
+
+void OptimizeVertexFetch(TriangleMesh *mesh) {
+  // The numbering itself is sequential, moving the records is not.
+  const size_t kVertices = mesh->vertices_.size() / 3;
+  const uint32_t kUnused = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> remap(kVertices, kUnused);
+  uint32_t next = 0;
+  for (int vertex : mesh->faces_)
+    if (remap[vertex] == kUnused) remap[vertex] = next++;
+  std::vector<uint32_t> sources(kVertices);
+  for (size_t v = 0; v < kVertices; ++v) {
+    if (remap[v] == kUnused) remap[v] = next++;
+    sources[remap[v]] = static_cast<uint32_t>(v);
+  }
+
+  int *faces = mesh->faces_.data();
+  ParallelForRange(0, mesh->faces_.size(), kClusterTriangles,
+                   [&](size_t begin, size_t end) {
+                     for (size_t i = begin; i < end; ++i)
+                       faces[i] = static_cast<int>(remap[faces[i]]);
+                   });
+  Permute(sources, 3, &mesh->vertices_);
+  Permute(sources, 3, &mesh->normals_);
+  Permute(sources, 3, &mesh->colors_);
+  Permute(sources, kInterleavedFloats, &mesh->buffer_);
+}
+
+void OptimizeMesh(TriangleMesh *mesh, const MeshOptimization &optimization) {
+  OptimizeVertexCache(mesh->vertices_, &mesh->faces_);
+  if (optimization.overdraw_threshold >= 1.0f)
+    OptimizeOverdraw(mesh->vertices_, &mesh->faces_,
+                     optimization.overdraw_threshold);
+  if (optimization.vertex_fetch) OptimizeVertexFetch(mesh);
+}
+
+}  // namespace data_representation
@@ -0,0 +1,150 @@
+// Author: Marc Comino 2020
+
+#ifndef MESH_OPTIMIZER_H_
+#define MESH_OPTIMIZER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+/**
+ * @brief kVertexCacheSize Entries of the FIFO post-transform vertex cache
+ * the index buffers are optimized for and measured with.
+ */
+const size_t kVertexCacheSize = 16;
+
+/**
+ * @brief kFetchCacheLine Bytes of a line of the simulated vertex fetch cache.
+ */
+const size_t kFetchCacheLine = 64;
+
+/**
+ * @brief kFetchCacheLines Lines of the simulated vertex fetch cache, which is
+ * direct mapped.
+ */
+const size_t kFetchCacheLines = 256;
+
+/**
+ * @brief kOverdrawResolution Width and height of the views the overdraw is
+ * measured on.
+ */
+const int kOverdrawResolution = 256;
+
+/**
+ * @brief MeshOptimization Optional stages of the preparation of a mesh.
+ */
+struct MeshOptimization {
+  /**
+   * @brief overdraw_threshold ACMR the overdraw ordering may reach, relative
+   * to that of the vertex cache order. Values below 1 skip the stage.
+   */
+  float overdraw_threshold = 1.05f;
+
+  /**
+   * @brief vertex_fetch Whether the vertices are renumbered in the order the
+   * triangles first use them.
+   */
+  bool vertex_fetch = true;
+
+  /**
+   * @brief lods Whether coarser levels of detail are built, see BuildLods.
+   * The loader builds them after the full mesh is shown.
+   */
+  bool lods = true;
+};
+
+bool operator==(const MeshOptimization &a, const MeshOptimization &b);
+
+/**
+ * @brief VertexCacheStats Post-transform vertex cache and vertex fetch
+ * efficiency of an index buffer.
+ */
+struct VertexCacheStats {
+  /**
+   * @brief acmr Average cache miss ratio: vertices transformed per triangle,
+   * between 0.5 for ideal meshes and 3.
+   */
+  double acmr = 0.0;
+
+  /**
+   * @brief atvr Average transformed vertex ratio: vertices transformed per
+   * referenced vertex, 1 at best.
+   */
+  double atvr = 0.0;
+
+  /**
+   * @brief overfetch Bytes read by the vertices transformed per byte of
+   * referenced vertex, 1 at best.
+   */
+  double overfetch = 0.0;
+};
+
+/**
+ * @brief AnalyzeVertexCache Simulates the FIFO vertex cache over the
+ * triangles in order, and the fetch cache over the vertices it misses.
+ * @param faces Packed triangle indices.
+ * @param triangles Number of triangles.
+ * @param vertex_count Number of vertices the indices refer to.
+ * @param vertex_size Bytes of a vertex record.
+ */
+VertexCacheStats AnalyzeVertexCache(const int *faces, size_t triangles,
+                                    size_t vertex_count, size_t vertex_size);
+
+/**
+ * @brief OptimizeVertexCache Reorders the triangles for the post-transform
+ * vertex cache with Tipsify (Sander et al. 2007). The triangles are first
+ * sorted along a Morton curve over the bounding box and split in clusters of
+ * consecutive triangles, which are compact patches of the surface and are
+ * reordered in parallel. Triangles keep their winding.
+ * @param vertices Packed vertex positions.
+ * @param faces Packed triangle indices, reordered in place.
+ */
+void OptimizeVertexCache(const std::vector<float> &vertices,
+                         std::vector<int> *faces);
+
+/**
+ * @brief OptimizeOverdraw Orders the clusters of a vertex cache optimized
+ * index buffer front to back on average (Sander et al. 2007). The triangles
+ * are split where the cache starts over, and further wherever the ACMR of
+ * the cluster so far is within threshold times that of the whole run. The
+ * clusters are then sorted by decreasing dot product of their normal and
+ * the offset of their centroid from that of the mesh, so that outer
+ * clusters facing out, which tend to occlude the rest from most views, are
+ * drawn first.
+ * @param vertices Packed vertex positions.
+ * @param faces Packed triangle indices in vertex cache order, reordered in
+ * place.
+ * @param threshold The tolerated ACMR, relative to that of faces, at least 1.
+ */
+void OptimizeOverdraw(const std::vector<float> &vertices,
+                      std::vector<int> *faces, float threshold);
+
+/**
+ * @brief AnalyzeOverdraw Rasterizes the front faces of the mesh in order,
+ * with a depth test, from the six axis directions at kOverdrawResolution.
+ * @return Fragments that pass the depth test per covered pixel, 1 at best.
+ */
+double AnalyzeOverdraw(const std::vector<float> &vertices,
+                       const std::vector<int> &faces);
+
+/**
+ * @brief OptimizeVertexFetch Renumbers the vertices of mesh in the order its
+ * triangles first use them, and moves every per-vertex array along.
+ * Unreferenced vertices go last, in their current order.
+ */
+void OptimizeVertexFetch(TriangleMesh *mesh);
+
+/**
+ * @brief OptimizeMesh Reorders the triangles of mesh for the vertex cache,
+ * then runs the overdraw and vertex fetch stages chosen in optimization.
+ * Levels of detail are not built.
+ * @param mesh A mesh with vertices_ and a single level in faces_.
+ */
+void OptimizeMesh(TriangleMesh *mesh, const MeshOptimization &optimization);
+
+}  // namespace data_representation
+
+#endif  // MESH_OPTIMIZER_H_
@@ -0,0 +1,293 @@
+// Author: Marc Comino 2020
+
+#include <mesh_processing.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "./geometry_kernels.h"
+#include "./parallel.h"
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kTriangleBlock Triangles per task of the face terms.
+ */
+const size_t kTriangleBlock = 1 << 14;
+
+/**
+ * @brief kCornerBlock Face corners per task of the adjacency passes.
+ */
+const size_t kCornerBlock = 1 << 16;
+
+/**
+ * @brief kVertexBlock Vertices per task of the adjacency and gather passes.
+ */
+const size_t kVertexBlock = 1 << 14;
+
+/**
+ * @brief kBatch Triangles or vertices handed to every kernel call, so that
+ * the scratch arrays of a task stay in cache.
+ */
+const size_t kBatch = 1024;
+
+/**
+ * @brief kMinCross Length of the edge cross product below which a triangle is
+ * degenerate and gets a zero normal.
+ */
+const float kMinCross = 0.00001f;
+
+/**
+ * @brief FaceScratch Arrays of a batch of triangles in structure of arrays
+ * form.
+ */
+class FaceScratch {
+ public:
+  FaceScratch() : data_(kArrays * kBatch) {
+    float *array = data_.data();
+    auto assign = [&](float **group) {
+      for (int k = 0; k < 3; ++k, array += kBatch) group[k] = array;
+    };
+    for (int j = 0; j < 3; ++j) assign(corners[j]);
+    assign(e01);
+    assign(e02);
+    assign(e12);
+    assign(lengths);
+    assign(dots);
+  }
+
+  float *corners[3][3];
+  float *e01[3];
+  float *e02[3];
+  float *e12[3];
+  float *lengths[3];
+  float *dots[3];
+
+ private:
+  static const size_t kArrays = 24;
+  std::vector<float> data_;
+};
+
+/**
+ * @brief ComputeFaceTermBatch Computes the terms of count triangles starting
+ * at first.
+ */
+void ComputeFaceTermBatch(const float *vertices, const int *faces,
+                          size_t first, size_t count, FaceTerms *terms,
+                          FaceScratch *scratch) {
+  for (size_t t = 0; t < count; ++t) {
+    for (int j = 0; j < 3; ++j) {
+      const float *kPosition =
+          vertices + faces[(first + t) * 3 + j] * size_t(3);
+      for (int k = 0; k < 3; ++k) scratch->corners[j][k][t] = kPosition[k];
+    }
+  }
+  Subtract(scratch->corners[1], scratch->corners[0], count, scratch->e01);
+  Subtract(scratch->corners[2], scratch->corners[0], count, scratch->e02);
+  Subtract(scratch->corners[2], scratch->corners[1], count, scratch->e12);
+
+  float *const kNormal[3] = {&terms->normal[0][first],
+                             &terms->normal[1][first],
+                             &terms->normal[2][first]};
+  Cross(scratch->e01, scratch->e02, count, kNormal);
+  Normalize(kNormal, count, kMinCross);
+
+  // The corners see the edge pairs (e01, e02), (e12, -e01) and (e02, e12).
+  Dot(scratch->e01, scratch->e01, count, scratch->lengths[0]);
+  Dot(scratch->e02, scratch->e02, count, scratch->lengths[1]);
+  Dot(scratch->e12, scratch->e12, count, scratch->lengths[2]);
+  Dot(scratch->e01, scratch->e02, count, scratch->dots[0]);
+  Dot(scratch->e01, scratch->e12, count, scratch->dots[1]);
+  Dot(scratch->e02, scratch->e12, count, scratch->dots[2]);
+  float *const *kLengths = scratch->lengths;
+  for (size_t t = 0; t < count; ++t) {
+    const float kLength01 = kLengths[0][t];
+    const float kLength02 = kLengths[1][t];
+    const float kLength12 = kLengths[2][t];
+    kLengths[0][t] = kLength01 * kLength02;
+    kLengths[1][t] = kLength01 * kLength12;
+    kLengths[2][t] = kLength02 * kLength12;
+    scratch->dots[1][t] = -scratch->dots[1][t];
+  }
+  for (int j = 0; j < 3; ++j)
+    Angles(scratch->dots[j], kLengths[j], count, &terms->angle[j][first]);
+}
+
+}  // namespace
+
+bool ValidateFaces(const TriangleMesh &mesh) {
+  const int kVertices = static_cast<int>(mesh.vertices_.size() / 3);
+  std::atomic<bool> valid(true);
+  ParallelForRange(0, mesh.faces_.size(), 1 << 16,
+                   [&](size_t begin, size_t end) {
+                     for (size_t i = begin; i < end; ++i) {
+                       if (mesh.faces_[i] < 0 || mesh.faces_[i] >= kVertices) {
+                         valid = false;
+                         return;
+                       }
+                     }
+                   });
+  return valid;
+}
+
+void ComputeFaceTerms(const float *vertices, const int *faces,
+                      size_t triangles, FaceTerms *terms) {
+  for (int k = 0; k < 3; ++k) {
+    terms->normal[k].resize(triangles);
+    terms->angle[k].resize(triangles);
+  }
+  ParallelForRange(0, triangles, kTriangleBlock, [&](size_t begin,
+                                                     size_t end) {
+    FaceScratch scratch;
+    for (size_t first = begin; first < end; first += kBatch) {
+      ComputeFaceTermBatch(vertices, faces, first,
+                           std::min(kBatch, end - first), terms, &scratch);
+    }
+  });
+}
+
+VertexNormalBuilder::VertexNormalBuilder(const float *vertices,
+                                         size_t vertex_count, size_t triangles)
+    : vertices_(vertices),
+      vertex_count_(vertex_count),
+      cursors_(new std::atomic<uint32_t>[vertex_count]) {
+  for (int k = 0; k < 3; ++k) {
+    terms_.normal[k].resize(triangles);
+    terms_.angle[k].resize(triangles);
+  }
+  ParallelForRange(0, vertex_count, kVertexBlock, [&](size_t begin,
+                                                      size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      cursors_[i].store(0, std::memory_order_relaxed);
+  });
+}
+
+void VertexNormalBuilder::AddFaces(const int *faces, size_t first,
+                                   size_t count) {
+  FaceScratch scratch;
+  for (size_t batch = first; batch < first + count; batch += kBatch) {
+    ComputeFaceTermBatch(vertices_, faces, batch,
+                         std::min(kBatch, first + count - batch), &terms_,
+                         &scratch);
+  }
+  for (size_t i = first * 3; i < (first + count) * 3; ++i)
+    cursors_[faces[i]].fetch_add(1, std::memory_order_relaxed);
+}
+
+void VertexNormalBuilder::Finish(const int *faces) {
+  // Turn the corner counts into offsets and scatter the corners.
+  const size_t kCorners = terms_.normal[0].size() * 3;
+  offsets_.resize(vertex_count_ + 1);
+  offsets_[vertex_count_] = 0;
+  ParallelForRange(0, vertex_count_, kVertexBlock, [&](size_t begin,
+                                                       size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      offsets_[i] = cursors_[i].load(std::memory_order_relaxed);
+  });
+  ParallelExclusiveScan(&offsets_);
+  ParallelForRange(0, vertex_count_, kVertexBlock, [&](size_t begin,
+                                                       size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      cursors_[i].store(offsets_[i], std::memory_order_relaxed);
+  });
+  corners_.resize(kCorners);
+  ParallelForRange(0, kCorners, kCornerBlock, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const uint32_t kSlot =
+          cursors_[faces[i]].fetch_add(1, std::memory_order_relaxed);
+      corners_[kSlot] = static_cast<uint32_t>(i);
+    }
+  });
+  cursors_.reset();
+}
+
+void VertexNormalBuilder::Gather(size_t begin, size_t end, float *normals) {
+  std::vector<float> values[4];
+  std::vector<float> sums(kBatch * 3);
+  std::vector<uint32_t> local_offsets(kBatch + 1);
+  for (size_t first = begin; first < end; first += kBatch) {
+    const size_t kCount = std::min(kBatch, end - first);
+    const uint32_t kBase = offsets_[first];
+    const size_t kEntries = offsets_[first + kCount] - kBase;
+    for (std::vector<float> &value : values) value.resize(kEntries);
+
+    // Corners were scattered in any order; sorting them adds every vertex
+    // in face order.
+    for (size_t i = 0; i <= kCount; ++i)
+      local_offsets[i] = offsets_[first + i] - kBase;
+    for (size_t i = 0; i < kCount; ++i) {
+      std::sort(corners_.begin() + offsets_[first + i],
+                corners_.begin() + offsets_[first + i + 1]);
+    }
+    for (size_t e = 0; e < kEntries; ++e) {
+      const uint32_t kCorner = corners_[kBase + e];
+      const size_t kFace = kCorner / 3;
+      for (int k = 0; k < 3; ++k) values[k][e] = terms_.normal[k][kFace];
+      values[3][e] = terms_.angle[kCorner % 3][kFace];
+    }
+
+    const float *const kVectors[3] = {values[0].data(), values[1].data(),
+                                      values[2].data()};
+    float *const kSums[3] = {sums.data(), sums.data() + kBatch,
+                             sums.data() + kBatch * 2};
+    WeightedSum(kVectors, values[3].data(), local_offsets.data(), kCount,
+                kSums);
+    Normalize(kSums, kCount, 0.0f);
+    for (size_t i = 0; i < kCount; ++i) {
+      for (int k = 0; k < 3; ++k)
+        normals[(first - begin + i) * 3 + k] = kSums[k][i];
+    }
+  }
+}
+
+void ComputeVertexNormals(const std::vector<float> &vertices,
+                          const std::vector<int> &faces,
+                          std::vector<float> *normals) {
+  const size_t kVertices = vertices.size() / 3;
+  const size_t kTriangles = faces.size() / 3;
+  VertexNormalBuilder builder(vertices.data(), kVertices, kTriangles);
+  ParallelForRange(0, kTriangles, kTriangleBlock, [&](size_t begin,
+                                                      size_t end) {
+    builder.AddFaces(faces.data(), begin, end - begin);
+  });
+  builder.Finish(faces.data());
+
+  normals->resize(kVertices * 3);
+  ParallelForRange(0, kVertices, kVertexBlock, [&](size_t begin, size_t end) {
+    builder.Gather(begin, end, normals->data() + begin * 3);
+  });
+}
+
+void ComputeBoundingBox(const std::vector<float> &vertices,
+                        TriangleMesh *mesh) {
+  const size_t kVertices = vertices.size() / 3;
+  const size_t kBlock = 1 << 16;
+  const size_t kBlocks = (kVertices + kBlock - 1) / kBlock;
+  std::vector<float> bounds(kBlocks * 6);
+  ParallelFor(kBlocks, [&](size_t block) {
+    float *min = &bounds[block * 6];
+    float *max = min + 3;
+    for (int k = 0; k < 3; ++k) {
+      min[k] = mesh->min_[k];
+      max[k] = mesh->max_[k];
+    }
+    const size_t kFirst = block * kBlock;
+    ExtendBounds(vertices.data() + kFirst * 3,
+                 std::min(kBlock, kVertices - kFirst), min, max);
+  });
+  for (size_t block = 0; block < kBlocks; ++block) {
+    for (int k = 0; k < 3; ++k) {
+      mesh->min_[k] = std::min(mesh->min_[k], bounds[block * 6 + k]);
+      mesh->max_[k] = std::max(mesh->max_[k], bounds[block * 6 + 3 + k]);
+    }
+  }
+}
+
+}  // namespace data_representation
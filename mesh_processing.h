@@ -0,0 +1,152 @@
+// Author: Marc Comino 2020
+
+#ifndef MESH_PROCESSING_H_
+#define MESH_PROCESSING_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+/**
+ * @brief NormalPolicy When the loaders compute per-vertex normals instead of
+ * reading the ones stored in the file.
+ */
+enum class NormalPolicy {
+  /**
+   * @brief kAlways Normals are always computed, stored ones are ignored.
+   */
+  kAlways,
+
+  /**
+   * @brief kNever Normals are only read. Models without them get zero
+   * normals.
+   */
+  kNever,
+
+  /**
+   * @brief kWhenMissing Stored normals are read, and computed for models
+   * without them.
+   */
+  kWhenMissing
+};
+
+/**
+ * @brief ValidateFaces Checks that every index refers to an existing vertex.
+ */
+bool ValidateFaces(const TriangleMesh &mesh);
+
+/**
+ * @brief FaceTerms The unit normal of every triangle and the angle of each of
+ * its corners, one array per component so that kernels handle several
+ * triangles per instruction. Degenerate triangles get a zero normal and
+ * corners with a zero length edge a zero angle.
+ */
+struct FaceTerms {
+  std::vector<float> normal[3];
+  std::vector<float> angle[3];
+};
+
+/**
+ * @brief ComputeFaceTerms Computes the FaceTerms of a range of triangles in
+ * parallel. Batches of triangles are gathered into structure of arrays form
+ * and handed to the geometry kernels.
+ * @param vertices Packed vertex positions.
+ * @param faces Packed vertex indices of the triangles.
+ * @param triangles Number of triangles.
+ * @param terms The resulting terms, resized to triangles.
+ */
+void ComputeFaceTerms(const float *vertices, const int *faces,
+                      size_t triangles, FaceTerms *terms);
+
+/**
+ * @brief VertexNormalBuilder Computes the normals of ComputeVertexNormals in
+ * stages that a loader can fuse with its own passes over the data: AddFaces
+ * on blocks of triangles as they are decoded, Finish once all of them were
+ * added, and Gather on blocks of vertices. Every vertex adds its corners in
+ * face order, so the result does not depend on how the work was split.
+ */
+class VertexNormalBuilder {
+ public:
+  /**
+   * @brief VertexNormalBuilder Prepares the normals of a mesh.
+   * @param vertices Packed vertex positions, which must be decoded before any
+   * face is added and outlive the builder.
+   * @param vertex_count Number of vertices.
+   * @param triangles Number of triangles that will be added.
+   */
+  VertexNormalBuilder(const float *vertices, size_t vertex_count,
+                      size_t triangles);
+
+  VertexNormalBuilder(const VertexNormalBuilder &) = delete;
+  VertexNormalBuilder &operator=(const VertexNormalBuilder &) = delete;
+
+  /**
+   * @brief AddFaces Computes the terms of the triangles [first, first + count)
+   * of faces and counts their corners. Runs on the calling thread, and may be
+   * called concurrently for disjoint ranges. Indices must be valid.
+   */
+  void AddFaces(const int *faces, size_t first, size_t count);
+
+  /**
+   * @brief Finish Builds the vertex to corner adjacency, in parallel.
+   * @param faces Every triangle, as added.
+   */
+  void Finish(const int *faces);
+
+  /**
+   * @brief Gather Writes the packed unit normals of the vertices
+   * [begin, end) into normals. Runs on the calling thread, and may be called
+   * concurrently for disjoint ranges.
+   */
+  void Gather(size_t begin, size_t end, float *normals);
+
+ private:
+  const float *vertices_;
+  size_t vertex_count_;
+  FaceTerms terms_;
+
+  /**
+   * @brief cursors_ Corners counted per vertex, then the next free slot of
+   * every vertex while the adjacency is filled.
+   */
+  std::unique_ptr<std::atomic<uint32_t>[]> cursors_;
+
+  /**
+   * @brief offsets_ First entry of every vertex in corners_, and the total.
+   */
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> corners_;
+};
+
+/**
+ * @brief ComputeVertexNormals Computes per-vertex normals as the average of the
+ * normals of the adjacent faces, weighted by the angle of every face corner.
+ * The face terms are computed in parallel, and every vertex then gathers them
+ * through a vertex to corner adjacency, adding its corners in face order so
+ * that the result does not depend on the number of threads. Uses a
+ * VertexNormalBuilder.
+ * @param vertices Packed vertex positions.
+ * @param faces Packed triangle vertex indices.
+ * @param normals The resulting packed unit normals, one per vertex.
+ */
+void ComputeVertexNormals(const std::vector<float> &vertices,
+                          const std::vector<int> &faces,
+                          std::vector<float> *normals);
+
+/**
+ * @brief ComputeBoundingBox Extends the bounding box of the mesh to contain
+ * every vertex. Blocks of vertices are reduced in parallel.
+ */
+void ComputeBoundingBox(const std::vector<float> &vertices,
+                        TriangleMesh *mesh);
+
+}  // namespace data_representation
+
+#endif  // MESH_PROCESSING_H_
@@ -0,0 +1,591 @@
+// Author: Marc Comino 2020
+
+#include <mesh_simplifier.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "./geometry_kernels.h"
+#include "./mesh_optimizer.h"
+#include "./parallel.h"
+#include "./radix_sort.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kGrain Elements per task of the parallel loops.
+ */
+const size_t kGrain = 1 << 14;
+
+/**
+ * @brief kBorderWeight Weight of the planes that hold border vertices on the
+ * border, per squared length of the border edge.
+ */
+const float kBorderWeight = 10.0f;
+
+/**
+ * @brief kFlipCosine Collapses that turn a triangle more than about 85
+ * degrees are rejected.
+ */
+const float kFlipCosine = 0.1f;
+
+/**
+ * @brief kPassFraction A pass aims at this fraction of the collapses still
+ * needed, so that cheap collapses blocked by their neighbours get another
+ * chance before expensive ones are taken.
+ */
+const size_t kPassFraction = 6;
+
+/**
+ * @brief Quadric Weighted sum of the squared distances to a set of planes,
+ * as the upper triangle of a symmetric 4x4 matrix, and the sum of the
+ * weights.
+ */
+struct Quadric {
+  float a2, ab, ac, ad, b2, bc, bd, c2, cd, d2, weight;
+};
+
+void AddPlane(const float normal[3], float d, float weight,
+              Quadric *quadric) {
+  quadric->a2 += weight * normal[0] * normal[0];
+  quadric->ab += weight * normal[0] * normal[1];
+  quadric->ac += weight * normal[0] * normal[2];
+  quadric->ad += weight * normal[0] * d;
+  quadric->b2 += weight * normal[1] * normal[1];
+  quadric->bc += weight * normal[1] * normal[2];
+  quadric->bd += weight * normal[1] * d;
+  quadric->c2 += weight * normal[2] * normal[2];
+  quadric->cd += weight * normal[2] * d;
+  quadric->d2 += weight * d * d;
+  quadric->weight += weight;
+}
+
+void AddQuadric(const Quadric &other, Quadric *quadric) {
+  quadric->a2 += other.a2;
+  quadric->ab += other.ab;
+  quadric->ac += other.ac;
+  quadric->ad += other.ad;
+  quadric->b2 += other.b2;
+  quadric->bc += other.bc;
+  quadric->bd += other.bd;
+  quadric->c2 += other.c2;
+  quadric->cd += other.cd;
+  quadric->d2 += other.d2;
+  quadric->weight += other.weight;
+}
+
+/**
+ * @brief QuadricError Mean squared distance from point to the planes of the
+ * sum of two quadrics.
+ */
+float QuadricError(const Quadric &a, const Quadric &b, const float *point) {
+  const float kX = point[0], kY = point[1], kZ = point[2];
+  const float kWeight = a.weight + b.weight;
+  const float kError =
+      (a.a2 + b.a2) * kX * kX + (a.b2 + b.b2) * kY * kY +
+      (a.c2 + b.c2) * kZ * kZ + (a.d2 + b.d2) +
+      2.0f * ((a.ab + b.ab) * kX * kY + (a.ac + b.ac) * kX * kZ +
+              (a.bc + b.bc) * kY * kZ + (a.ad + b.ad) * kX +
+              (a.bd + b.bd) * kY + (a.cd + b.cd) * kZ);
+  return kWeight > 0.0f ? std::max(kError, 0.0f) / kWeight : 0.0f;
+}
+
+void Sub(const float *a, const float *b, float *out) {
+  for (int k = 0; k < 3; ++k) out[k] = a[k] - b[k];
+}
+
+void Cross(const float *a, const float *b, float *out) {
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+float Dot(const float *a, const float *b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/**
+ * @brief Simplifier Edge collapse state kept across the levels of a chain, so
+ * that every level continues from the quadrics and the error of the last.
+ * Positions are scaled to the unit box, which keeps float quadrics accurate.
+ */
+class Simplifier {
+ public:
+  Simplifier(const std::vector<float> &vertices, const std::vector<int> &faces);
+
+  /**
+   * @brief Simplify Runs passes until at most target triangles are left, a
+   * pass collapses nothing or cancelled returns true.
+   */
+  void Simplify(size_t target, const CancelCallback &cancelled);
+
+  const std::vector<int> &indices() const { return indices_; }
+
+  size_t triangle_count() const { return indices_.size() / 3; }
+
+  /**
+   * @brief error The largest collapse error so far, in model units.
+   */
+  float error() const { return std::sqrt(error_) * extent_; }
+
+ private:
+  /**
+   * @brief BuildAdjacency Lists the corners around every vertex.
+   */
+  void BuildAdjacency();
+
+  /**
+   * @brief ComputeQuadrics Sums the planes of the faces and of the border
+   * edges around every vertex, and marks border and non-manifold vertices.
+   */
+  void ComputeQuadrics();
+
+  /**
+   * @brief LockExtremes Keeps the vertices that span the bounding box.
+   */
+  void LockExtremes();
+
+  /**
+   * @brief Ring Appends the vertices that share a triangle with vertex.
+   */
+  void Ring(int vertex, std::vector<int> *ring) const;
+
+  /**
+   * @brief EdgeTriangles Number of triangles around vertex that use other.
+   */
+  int EdgeTriangles(int vertex, int other) const;
+
+  /**
+   * @brief CanCollapse Whether moving vertex onto target keeps the surface a
+   * manifold and turns no triangle over.
+   */
+  bool CanCollapse(int vertex, int target) const;
+
+  /**
+   * @brief RankCollapses Finds the cheapest neighbour to move every dirty
+   * vertex onto.
+   */
+  void RankCollapses();
+
+  /**
+   * @brief Pass Performs as many ranked collapses as possible in increasing
+   * cost, skipping those whose neighbourhood another one changed.
+   * @return The number of collapses.
+   */
+  size_t Pass(size_t target);
+
+  const float *position(int vertex) const { return &positions_[vertex * 3]; }
+
+  size_t vertex_count_;
+  int vertex_bits_;
+  float extent_;
+  std::vector<float> positions_;
+  std::vector<int> indices_;
+  std::vector<Quadric> quadrics_;
+  std::vector<char> border_;
+  std::vector<char> locked_;
+
+  /**
+   * @brief offsets_ and corners_ The corners of indices_ around each vertex.
+   */
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> corners_;
+
+  /**
+   * @brief remap_ Where the vertices collapsed in the current pass went.
+   */
+  std::vector<int> remap_;
+
+  /**
+   * @brief touched_ and collapsed_ The last pass that moved the vertex or
+   * moved another onto it, and the last pass that moved it.
+   */
+  std::vector<uint32_t> touched_;
+  std::vector<uint32_t> collapsed_;
+  uint32_t pass_;
+
+  /**
+   * @brief targets_ and costs_ The cheapest collapse of every vertex, -1 if
+   * it cannot move, which is only ranked again when dirty_.
+   */
+  std::vector<int> targets_;
+  std::vector<float> costs_;
+  std::vector<char> dirty_;
+
+  /**
+   * @brief error_ The largest collapse error so far, squared, in unit box
+   * units.
+   */
+  float error_;
+
+  /**
+   * @brief ring_scratch_ and target_ring_scratch_ Rings of CanCollapse,
+   * kept so that they are not allocated for every candidate. CanCollapse
+   * only runs in the serial part of a pass.
+   */
+  mutable std::vector<int> ring_scratch_;
+  mutable std::vector<int> target_ring_scratch_;
+};
+
+Simplifier::Simplifier(const std::vector<float> &vertices,
+                       const std::vector<int> &faces)
+    : vertex_count_(vertices.size() / 3),
+      vertex_bits_(1),
+      extent_(0.0f),
+      positions_(vertices.size()),
+      indices_(faces),
+      quadrics_(vertex_count_),
+      border_(vertex_count_, 0),
+      locked_(vertex_count_, 0),
+      remap_(vertex_count_),
+      touched_(vertex_count_, 0),
+      collapsed_(vertex_count_, 0),
+      pass_(0),
+      targets_(vertex_count_, -1),
+      costs_(vertex_count_, 0.0f),
+      dirty_(vertex_count_, 1),
+      error_(0.0f) {
+  while (vertex_bits_ < 32 && (size_t(1) << vertex_bits_) < vertex_count_)
+    ++vertex_bits_;
+
+  float min[3], max[3];
+  std::fill_n(min, 3, std::numeric_limits<float>::max());
+  std::fill_n(max, 3, std::numeric_limits<float>::lowest());
+  ExtendBounds(vertices.data(), vertex_count_, min, max);
+  extent_ =
+      std::max(max[0] - min[0], std::max(max[1] - min[1], max[2] - min[2]));
+  const float kScale = extent_ > 0.0f ? 1.0f / extent_ : 0.0f;
+  ParallelForRange(0, vertex_count_, kGrain, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      for (int k = 0; k < 3; ++k)
+        positions_[v * 3 + k] = (vertices[v * 3 + k] - min[k]) * kScale;
+      remap_[v] = static_cast<int>(v);
+    }
+  });
+
+  BuildAdjacency();
+  ComputeQuadrics();
+  LockExtremes();
+}
+
+void Simplifier::BuildAdjacency() {
+  const size_t kCorners = indices_.size();
+  std::vector<uint64_t> keys(kCorners);
+  corners_.resize(kCorners);
+  ParallelForRange(0, kCorners, kGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      keys[i] = static_cast<uint64_t>(indices_[i]);
+      corners_[i] = static_cast<uint32_t>(i);
+    }
+  });
+  RadixSortPairs(&keys, &corners_, vertex_bits_);
+
+  // Every corner writes the offsets of the vertices between its own and
+  // that of the corner before, so the writes never overlap.
+  offsets_.resize(vertex_count_ + 1);
+  ParallelForRange(0, kCorners + 1, kGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const size_t kFirst = i == 0 ? 0 : keys[i - 1] + 1;
+      const size_t kLast = i == kCorners ? vertex_count_ : keys[i];
+      for (size_t v = kFirst; v <= kLast; ++v)
+        offsets_[v] = static_cast<uint32_t>(i);
+    }
+  });
+}
+
+void Simplifier::Ring(int vertex, std::vector<int> *ring) const {
+  for (uint32_t a = offsets_[vertex]; a < offsets_[vertex + 1]; ++a) {
+    const uint32_t kTriangle = corners_[a] / 3 * 3;
+    const uint32_t kCorner = corners_[a] % 3;
+    ring->push_back(indices_[kTriangle + (kCorner + 1) % 3]);
+    ring->push_back(indices_[kTriangle + (kCorner + 2) % 3]);
+  }
+}
+
+int Simplifier::EdgeTriangles(int vertex, int other) const {
+  int count = 0;
+  for (uint32_t a = offsets_[vertex]; a < offsets_[vertex + 1]; ++a) {
+    const int *kTriangle = &indices_[corners_[a] / 3 * 3];
+    if (kTriangle[0] == other || kTriangle[1] == other ||
+        kTriangle[2] == other)
+      ++count;
+  }
+  return count;
+}
+
+void Simplifier::ComputeQuadrics() {
+  ParallelForRange(0, vertex_count_, kGrain, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      const int kVertex = static_cast<int>(v);
+      Quadric quadric;
+      memset(&quadric, 0, sizeof(quadric));
+      for (uint32_t a = offsets_[v]; a < offsets_[v + 1]; ++a) {
+        const uint32_t kTriangle = corners_[a] / 3 * 3;
+        const uint32_t kCorner = corners_[a] % 3;
+        const int kNext = indices_[kTriangle + (kCorner + 1) % 3];
+        const int kPrevious = indices_[kTriangle + (kCorner + 2) % 3];
+        float u[3], w[3], normal[3];
+        Sub(position(kNext), position(kVertex), u);
+        Sub(position(kPrevious), position(kVertex), w);
+        Cross(u, w, normal);
+        const float kLength = std::sqrt(Dot(normal, normal));
+        if (!(kLength > 0.0f)) continue;
+        for (int k = 0; k < 3; ++k) normal[k] /= kLength;
+        AddPlane(normal, -Dot(normal, position(kVertex)), 0.5f * kLength,
+                 &quadric);
+
+        // Border edges, those of a single triangle, get a plane through them
+        // perpendicular to the triangle.
+        const int kEnds[2][2] = {{kVertex, kNext}, {kPrevious, kVertex}};
+        for (int e = 0; e < 2; ++e) {
+          const int kOther = kEnds[e][0] == kVertex ? kEnds[e][1] : kEnds[e][0];
+          const int kShared = EdgeTriangles(kVertex, kOther);
+          if (kShared > 2) locked_[v] = 1;
+          if (kShared != 1) continue;
+          border_[v] = 1;
+          float edge[3], side[3];
+          Sub(position(kEnds[e][1]), position(kEnds[e][0]), edge);
+          Cross(edge, normal, side);
+          const float kSide = std::sqrt(Dot(side, side));
+          if (!(kSide > 0.0f)) continue;
+          for (int k = 0; k < 3; ++k) side[k] /= kSide;
+          AddPlane(side, -Dot(side, position(kEnds[e][0])),
+                   kBorderWeight * Dot(edge, edge), &quadric);
+        }
+      }
+      quadrics_[v] = quadric;
+    }
+  });
+}
+
+void Simplifier::LockExtremes() {
+  int extremes[6] = {-1, -1, -1, -1, -1, -1};
+  for (size_t v = 0; v < vertex_count_; ++v) {
+    if (offsets_[v] == offsets_[v + 1]) continue;
+    for (int k = 0; k < 3; ++k) {
+      if (extremes[k] < 0 || position(v)[k] < position(extremes[k])[k])
+        extremes[k] = static_cast<int>(v);
+      if (extremes[k + 3] < 0 ||
+          position(v)[k] > position(extremes[k + 3])[k])
+        extremes[k + 3] = static_cast<int>(v);
+    }
+  }
+  for (int vertex : extremes)
+    if (vertex >= 0) locked_[vertex] = 1;
+}
+
+bool Simplifier::CanCollapse(int vertex, int target) const {
+  // The vertices around both ends may only be shared through the triangles
+  // of the edge, or the collapse would pinch the surface. The ring of target
+  // may name vertices moved earlier in the pass.
+  std::vector<int> &ring = ring_scratch_;
+  std::vector<int> &target_ring = target_ring_scratch_;
+  ring.clear();
+  target_ring.clear();
+  Ring(vertex, &ring);
+  Ring(target, &target_ring);
+  for (int &other : target_ring) other = remap_[other];
+  std::sort(ring.begin(), ring.end());
+  ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+  std::sort(target_ring.begin(), target_ring.end());
+  target_ring.erase(std::unique(target_ring.begin(), target_ring.end()),
+                    target_ring.end());
+  int shared = 0;
+  for (auto a = ring.begin(), b = target_ring.begin();
+       a != ring.end() && b != target_ring.end();) {
+    if (*a < *b) {
+      ++a;
+    } else if (*b < *a) {
+      ++b;
+    } else {
+      ++shared;
+      ++a;
+      ++b;
+    }
+  }
+  if (shared > EdgeTriangles(vertex, target)) return false;
+
+  for (uint32_t a = offsets_[vertex]; a < offsets_[vertex + 1]; ++a) {
+    const uint32_t kTriangle = corners_[a] / 3 * 3;
+    const uint32_t kCorner = corners_[a] % 3;
+    const int kNext = indices_[kTriangle + (kCorner + 1) % 3];
+    const int kPrevious = indices_[kTriangle + (kCorner + 2) % 3];
+    if (kNext == target || kPrevious == target) continue;
+    float u[3], w[3], before[3], after[3];
+    Sub(position(kNext), position(vertex), u);
+    Sub(position(kPrevious), position(vertex), w);
+    Cross(u, w, before);
+    Sub(position(kNext), position(target), u);
+    Sub(position(kPrevious), position(target), w);
+    Cross(u, w, after);
+    const float kDot = Dot(before, after);
+    if (kDot <= kFlipCosine * std::sqrt(Dot(before, before)) *
+                    std::sqrt(Dot(after, after)))
+      return false;
+  }
+  return true;
+}
+
+void Simplifier::RankCollapses() {
+  ParallelForRange(0, vertex_count_, kGrain, [&](size_t begin, size_t end) {
+    std::vector<int> ring;
+    for (size_t v = begin; v < end; ++v) {
+      if (!dirty_[v]) continue;
+      dirty_[v] = 0;
+      targets_[v] = -1;
+      if (locked_[v] || offsets_[v] == offsets_[v + 1]) continue;
+      const int kVertex = static_cast<int>(v);
+      ring.clear();
+      Ring(kVertex, &ring);
+      float best = std::numeric_limits<float>::max();
+      for (int other : ring) {
+        if (border_[v] && EdgeTriangles(kVertex, other) != 1) continue;
+        const float kCost =
+            QuadricError(quadrics_[v], quadrics_[other], position(other));
+        if (kCost < best) {
+          best = kCost;
+          targets_[v] = other;
+        }
+      }
+      costs_[v] = best;
+    }
+  });
+}
+
+size_t Simplifier::Pass(size_t target) {
+  ++pass_;
+  RankCollapses();
+  std::vector<std::pair<float, uint32_t>> candidates;
+  for (size_t v = 0; v < vertex_count_; ++v)
+    if (targets_[v] >= 0)
+      candidates.emplace_back(costs_[v], static_cast<uint32_t>(v));
+  if (candidates.empty()) return 0;
+
+  // Only the collapses up to the goal, and those not much more expensive,
+  // are sorted; the rest wait for the next pass unless the goal is missed.
+  const size_t kNeeded = triangle_count() - target;
+  const size_t kGoal =
+      std::min(candidates.size() - 1, kNeeded / 2 / kPassFraction);
+  std::nth_element(candidates.begin(), candidates.begin() + kGoal,
+                   candidates.end());
+  const float kLimit = candidates[kGoal].first * 1.5f;
+  auto cheap = std::partition(
+      candidates.begin(), candidates.end(),
+      [kLimit](const std::pair<float, uint32_t> &candidate) {
+        return candidate.first <= kLimit;
+      });
+  std::sort(candidates.begin(), cheap);
+
+  size_t collapses = 0;
+  size_t removed = 0;
+  std::vector<int> ring, target_ring;
+  for (auto candidate = candidates.begin();
+       candidate != candidates.end() && removed < kNeeded; ++candidate) {
+    if (candidate == cheap) {
+      if (collapses >= kGoal) break;
+      std::sort(cheap, candidates.end());
+    }
+    const int kVertex = static_cast<int>(candidate->second);
+    const int kTarget = targets_[kVertex];
+    if (touched_[kVertex] == pass_ || touched_[kTarget] == pass_) continue;
+    // Triangles around a moved neighbour are stale.
+    ring.clear();
+    Ring(kVertex, &ring);
+    if (std::any_of(ring.begin(), ring.end(),
+                    [this](int other) { return collapsed_[other] == pass_; }))
+      continue;
+    if (!CanCollapse(kVertex, kTarget)) continue;
+
+    touched_[kVertex] = touched_[kTarget] = pass_;
+    collapsed_[kVertex] = pass_;
+    remap_[kVertex] = kTarget;
+    AddQuadric(quadrics_[kVertex], &quadrics_[kTarget]);
+    error_ = std::max(error_, candidate->first);
+    removed += EdgeTriangles(kVertex, kTarget);
+    ++collapses;
+
+    // Every vertex whose ring or target quadric changed is ranked again.
+    target_ring.clear();
+    Ring(kTarget, &target_ring);
+    dirty_[kTarget] = 1;
+    for (int other : ring) dirty_[other] = 1;
+    for (int other : target_ring) dirty_[other] = 1;
+    dirty_[kVertex] = 1;
+  }
+
+  ParallelForRange(0, indices_.size(), kGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) indices_[i] = remap_[indices_[i]];
+  });
+  size_t kept = 0;
+  for (size_t i = 0; i < indices_.size(); i += 3) {
+    const int *kTriangle = &indices_[i];
+    if (kTriangle[0] == kTriangle[1] || kTriangle[1] == kTriangle[2] ||
+        kTriangle[2] == kTriangle[0])
+      continue;
+    std::copy_n(kTriangle, 3, &indices_[kept]);
+    kept += 3;
+  }
+  indices_.resize(kept);
+  return collapses;
+}
+
+void Simplifier::Simplify(size_t target, const CancelCallback &cancelled) {
+  while (triangle_count() > target && !cancelled()) {
+    if (Pass(target) == 0) return;
+    BuildAdjacency();
+  }
+}
+
+}  // namespace
+
+float SimplifyMesh(const std::vector<float> &vertices, std::vector<int> *faces,
+                   size_t target) {
+  Simplifier simplifier(vertices, *faces);
+  simplifier.Simplify(target, [] { return false; });
+  *faces = simplifier.indices();
+  return simplifier.error();
+}
+
+void BuildLods(TriangleMesh *mesh, const CancelCallback &cancelled) {
+  const size_t kTriangles = mesh->faces_.size() / 3;
+  if (!mesh->lods_.empty() || kTriangles < kMinLodTriangles) return;
+
+  std::vector<MeshLod> lods(1);
+  lods[0].first_index = 0;
+  lods[0].index_count = mesh->faces_.size();
+  lods[0].error = 0.0f;
+  std::vector<int> faces = mesh->faces_;
+  Simplifier simplifier(mesh->vertices_, mesh->faces_);
+  for (float fraction : kLodFractions) {
+    const size_t kTarget = static_cast<size_t>(kTriangles * fraction);
+    if (kTarget < kMinLodTriangles) break;
+    simplifier.Simplify(kTarget, cancelled);
+    if (cancelled()) return;
+    // A level that barely shrank means the simplifier is stuck.
+    if (simplifier.triangle_count() * 10 > lods.back().index_count / 3 * 9)
+      break;
+
+    std::vector<int> level = simplifier.indices();
+    OptimizeVertexCache(mesh->vertices_, &level);
+    MeshLod lod;
+    lod.first_index = faces.size();
+    lod.index_count = level.size();
+    lod.error = simplifier.error();
+    lods.push_back(lod);
+    faces.insert(faces.end(), level.begin(), level.end());
+  }
+  if (lods.size() == 1) return;
+
+  mesh->faces_.swap(faces);
+  mesh->lods_.swap(lods);
+}
+
+}  // namespace data_representation
@@ -0,0 +1,65 @@
+// Author: Marc Comino 2020
+
+#ifndef MESH_SIMPLIFIER_H_
+#define MESH_SIMPLIFIER_H_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+/**
+ * @brief kLodFractions Fractions of the triangles of the full mesh kept by
+ * the coarser levels of detail.
+ */
+const float kLodFractions[] = {0.5f, 0.25f, 0.1f, 0.02f};
+
+/**
+ * @brief kMinLodTriangles Triangles below which no further level is built.
+ */
+const size_t kMinLodTriangles = 256;
+
+/**
+ * @brief CancelCallback Polled between simplification passes; returning true
+ * abandons the work.
+ */
+using CancelCallback = std::function<bool()>;
+
+/**
+ * @brief SimplifyMesh Collapses edges of the triangles in faces by increasing
+ * quadric error (Garland and Heckbert 1997) until at most target triangles
+ * are left or no edge can be collapsed. Every collapse moves a vertex onto a
+ * neighbour, so the result indexes the same vertices. Border vertices only
+ * move along the border, and the vertices at the extremes of the bounding
+ * box stay. Each pass ranks in parallel the collapses of the vertices whose
+ * neighbourhood changed, and performs the cheapest ones whose neighbourhoods
+ * do not overlap.
+ * @param vertices Packed vertex positions.
+ * @param faces Packed triangle indices, simplified in place.
+ * @param target The number of triangles to reach.
+ * @return The estimated distance between the simplified and the original
+ * surfaces.
+ */
+float SimplifyMesh(const std::vector<float> &vertices, std::vector<int> *faces,
+                   size_t target);
+
+/**
+ * @brief BuildLods Appends to the faces_ of mesh a level of detail for every
+ * fraction of kLodFractions, each simplified from the previous one with
+ * SimplifyMesh and reordered for the vertex cache, and describes them all in
+ * lods_. The chain stops early at kMinLodTriangles or when the simplifier
+ * gets stuck. Levels share the vertices and normals of the mesh, and its
+ * bounding box. Building the chain takes several times as long as parsing
+ * the mesh, so it is meant to run after the full mesh is shown.
+ * @param mesh A mesh with a single level in faces_, left unchanged if
+ * cancelled.
+ * @param cancelled Polled between passes.
+ */
+void BuildLods(TriangleMesh *mesh, const CancelCallback &cancelled);
+
+}  // namespace data_representation
+
+#endif  // MESH_SIMPLIFIER_H_
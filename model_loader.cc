@@ -0,0 +1,413 @@
+// Author: Marc Comino 2020
+
+#include <model_loader.h>
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./glb_io.h"
+#include "./mesh_cache.h"
+#include "./mesh_io.h"
+#include "./mesh_optimizer.h"
+#include "./mesh_simplifier.h"
+#include "./obj_io.h"
+#include "./ply_stream.h"
+#include "./qmesh_io.h"
+#include "./stl_io.h"
+#include "./triangle_mesh.h"
+#include "./vertex_buffer.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kStreamWindowBytes Size of the windows of a streamed model.
+ */
+const size_t kStreamWindowBytes = 16 << 20;
+
+/**
+ * @brief kMaxQueuedWindows Windows a stream may have waiting for upload.
+ */
+const size_t kMaxQueuedWindows = 4;
+
+/**
+ * @brief kStreamingMemoryFraction The regular loader holds about four copies
+ * of the mesh, so files above this fraction of the physical memory are
+ * streamed.
+ */
+const size_t kStreamingMemoryFraction = 4;
+
+/**
+ * @brief kVertexSize Bytes of the vertex records the fetch cache is measured
+ * on, those of kInterleavedLayout.
+ */
+const size_t kVertexSize = kInterleavedFloats * sizeof(float);
+
+bool ShouldStream(const std::string &filename) {
+  struct stat info;
+  const long kPages = sysconf(_SC_PHYS_PAGES);
+  const long kPageSize = sysconf(_SC_PAGESIZE);
+  if (stat(filename.c_str(), &info) != 0 || kPages <= 0 || kPageSize <= 0)
+    return false;
+  const uint64_t kMemory =
+      static_cast<uint64_t>(kPages) * static_cast<uint64_t>(kPageSize);
+  return static_cast<uint64_t>(info.st_size) >
+         kMemory / kStreamingMemoryFraction;
+}
+
+}  // namespace
+
+bool ReadModel(const std::string &filename, TriangleMesh *mesh,
+               NormalPolicy policy) {
+  const std::string kType = filename.substr(filename.find_last_of('.') + 1);
+  if (kType.compare("ply") == 0) return ReadFromPly(filename, mesh, policy);
+  if (kType.compare("obj") == 0) return ReadFromObj(filename, mesh, policy);
+  if (kType.compare("stl") == 0) return ReadFromStl(filename, mesh);
+  if (kType.compare("qmesh") == 0) return ReadFromQmesh(filename, mesh);
+  if (kType.compare("glb") == 0) {
+    GlbFile glb;
+    return glb.Open(filename) && glb.ToTriangleMesh(mesh);
+  }
+  return false;
+}
+
+/**
+ * @brief WindowSink Copies every piece of a stream into a window and queues
+ * it.
+ */
+class ModelLoader::WindowSink : public PlyStreamSink {
+ public:
+  WindowSink(ModelLoader *loader, unsigned generation)
+      : loader_(loader), generation_(generation) {}
+
+  bool Begin(size_t vertex_bytes, size_t index_bytes) override {
+    StreamWindow window;
+    window.generation = generation_;
+    window.vertex_bytes = vertex_bytes;
+    window.index_bytes = index_bytes;
+    return loader_->PushWindow(std::move(window));
+  }
+
+  bool Indices(size_t offset, const int *indices, size_t count) override {
+    return Push(StreamWindow::Kind::kIndices, offset,
+                reinterpret_cast<const char *>(indices), count * sizeof(int));
+  }
+
+  bool Vertices(size_t offset, const float *vertices, size_t floats) override {
+    return Push(StreamWindow::Kind::kVertices, offset,
+                reinterpret_cast<const char *>(vertices),
+                floats * sizeof(float));
+  }
+
+ private:
+  bool Push(StreamWindow::Kind kind, size_t offset, const char *data,
+            size_t bytes) {
+    StreamWindow window;
+    window.kind = kind;
+    window.generation = generation_;
+    window.offset = offset;
+    window.data.assign(data, data + bytes);
+    return loader_->PushWindow(std::move(window));
+  }
+
+  ModelLoader *loader_;
+  unsigned generation_;
+};
+
+ModelLoader::ModelLoader(ProgressCallback progress, DoneCallback done,
+                         WindowCallback window, LodsCallback lods)
+    : progress_(std::move(progress)),
+      done_(std::move(done)),
+      window_(std::move(window)),
+      lods_(std::move(lods)),
+      generation_(0),
+      pending_policy_(NormalPolicy::kWhenMissing),
+      has_pending_(false),
+      stop_(false),
+      result_generation_(0),
+      lods_generation_(0),
+      thread_(&ModelLoader::Run, this) {}
+
+ModelLoader::~ModelLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    ++generation_;
+  }
+  wake_.notify_one();
+  drained_.notify_all();
+  thread_.join();
+}
+
+unsigned ModelLoader::Load(const std::string &filename, NormalPolicy policy,
+                           const MeshOptimization &optimization) {
+  unsigned generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation = ++generation_;
+    pending_ = filename;
+    pending_policy_ = policy;
+    pending_optimization_ = optimization;
+    has_pending_ = true;
+  }
+  wake_.notify_one();
+  // A stream waiting for room has to notice it was superseded.
+  drained_.notify_all();
+  return generation;
+}
+
+std::unique_ptr<LoadedModel> ModelLoader::Take(unsigned generation) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (result_ == nullptr || result_generation_ != generation ||
+      !current(generation))
+    return nullptr;
+  return std::move(result_);
+}
+
+std::unique_ptr<LoadedLods> ModelLoader::TakeLods(unsigned generation) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (lods_result_ == nullptr || lods_generation_ != generation ||
+      !current(generation))
+    return nullptr;
+  return std::move(lods_result_);
+}
+
+bool ModelLoader::TakeWindow(unsigned generation, StreamWindow *window) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  while (!windows_.empty() && windows_.front().generation != generation)
+    windows_.pop_front();
+  if (windows_.empty()) return false;
+
+  *window = std::move(windows_.front());
+  windows_.pop_front();
+  drained_.notify_all();
+  return true;
+}
+
+bool ModelLoader::PushWindow(StreamWindow window) {
+  const unsigned kGeneration = window.generation;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    windows_.erase(
+        std::remove_if(windows_.begin(), windows_.end(),
+                       [kGeneration](const StreamWindow &queued) {
+                         return queued.generation != kGeneration;
+                       }),
+        windows_.end());
+    drained_.wait(lock, [this, kGeneration] {
+      return stop_ || !current(kGeneration) ||
+             windows_.size() < kMaxQueuedWindows;
+    });
+    if (stop_ || !current(kGeneration)) return false;
+    windows_.push_back(std::move(window));
+  }
+  window_(kGeneration);
+  return true;
+}
+
+void ModelLoader::Run() {
+  while (true) {
+    std::string filename;
+    NormalPolicy policy;
+    MeshOptimization optimization;
+    unsigned generation;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stop_ || has_pending_; });
+      if (stop_) return;
+      filename.swap(pending_);
+      policy = pending_policy_;
+      optimization = pending_optimization_;
+      has_pending_ = false;
+      generation = generation_;
+    }
+
+    // A failed allocation in a parser must not take the viewer down, the
+    // previous model keeps rendering.
+    std::unique_ptr<LoadedModel> model;
+    Deferred deferred;
+    try {
+      model = Read(filename, policy, optimization, generation, &deferred);
+    } catch (const std::exception &error) {
+      std::cerr << "ERROR loading model " + filename + ": " << error.what()
+                << std::endl;
+    }
+    const bool kSuccess = model != nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!current(generation)) continue;
+      result_ = std::move(model);
+      result_generation_ = generation;
+    }
+    done_(generation, kSuccess);
+    if (!kSuccess || deferred.mesh == nullptr) continue;
+
+    // The full mesh is already on its way to the screen; a failure here only
+    // costs the levels of detail.
+    try {
+      BuildDeferredLods(filename, &deferred, generation);
+    } catch (const std::exception &error) {
+      std::cerr << "ERROR simplifying model " + filename + ": " << error.what()
+                << std::endl;
+    }
+  }
+}
+
+void ModelLoader::BuildDeferredLods(const std::string &filename,
+                                    Deferred *deferred, unsigned generation) {
+  progress_(generation, "Simplifying");
+  TriangleMesh *mesh = deferred->mesh.get();
+  BuildLods(mesh, [this, generation] { return !current(generation); });
+  if (!current(generation)) return;
+  for (const MeshLod &lod : mesh->lods_)
+    std::cerr << "Level of detail " << lod.index_count / 3
+              << " triangles, error " << lod.error << std::endl;
+
+  if (!mesh->lods_.empty()) {
+    std::unique_ptr<LoadedLods> lods = std::make_unique<LoadedLods>();
+    lods->faces = mesh->faces_;
+    lods->lods = mesh->lods_;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!current(generation)) return;
+      lods_result_ = std::move(lods);
+      lods_generation_ = generation;
+    }
+    lods_(generation);
+  }
+
+  if (deferred->cache) {
+    progress_(generation, "Caching");
+    if (!WriteMeshCache(filename, *mesh))
+      std::cerr << "Could not write the cache of " + filename << std::endl;
+  }
+  progress_(generation, "Ready");
+}
+
+std::unique_ptr<LoadedModel> ModelLoader::Read(
+    const std::string &filename, NormalPolicy policy,
+    const MeshOptimization &optimization, unsigned generation,
+    Deferred *deferred) {
+  std::unique_ptr<LoadedModel> model = std::make_unique<LoadedModel>();
+  model->filename = filename;
+
+  // The cache holds the normals and the order of the default options only.
+  const bool kCached = policy == NormalPolicy::kWhenMissing &&
+                       optimization == MeshOptimization();
+  progress_(generation, "Opening");
+  if (kCached && model->cache.Open(filename)) {
+    std::cerr << "Model loaded from cache " + filename << std::endl;
+    model->source = LoadedModel::Source::kCache;
+    const std::vector<MeshLod> kLods = model->cache.lods();
+    const size_t kIndices =
+        kLods.empty() ? model->cache.index_count() : kLods[0].index_count;
+    model->vertex_cache =
+        AnalyzeVertexCache(model->cache.indices(), kIndices / 3,
+                           model->cache.vertex_count(), kVertexSize);
+    return model;
+  }
+  if (!current(generation)) return nullptr;
+
+  const std::string kType = filename.substr(filename.find_last_of('.') + 1);
+  if (kType.compare("ply") == 0 && ShouldStream(filename)) {
+    progress_(generation, "Streaming");
+    WindowSink sink(this, generation);
+    if (StreamFromPly(filename, kStreamWindowBytes, policy, &sink,
+                      &model->stream)) {
+      model->source = LoadedModel::Source::kStream;
+      return model;
+    }
+    if (!current(generation)) return nullptr;
+    std::cerr << "Could not stream " + filename << std::endl;
+  }
+
+  progress_(generation, "Parsing");
+  model->mesh = std::make_unique<TriangleMesh>();
+  bool res = false;
+  if (kType.compare("glb") == 0) {
+    if (model->glb.Open(filename) && model->glb.aliasable()) {
+      model->mesh.reset();
+      model->source = LoadedModel::Source::kGlb;
+      return model;
+    }
+    res = !model->glb.primitives().empty() &&
+          model->glb.ToTriangleMesh(model->mesh.get());
+    model->glb.Close();
+  } else {
+    res = ReadModel(filename, model->mesh.get(), policy);
+  }
+  if (!res) {
+    std::cerr << "ERROR loading model " + filename << std::endl;
+    return nullptr;
+  }
+  if (!current(generation)) return nullptr;
+
+  model->source = LoadedModel::Source::kMesh;
+  TriangleMesh *mesh = model->mesh.get();
+  const size_t kTriangles = mesh->faces_.size() / 3;
+  // Quantized containers keep their vertices in the buffer only, and are
+  // read in the order the compressor optimized them into.
+  const bool kOptimize = !mesh->vertices_.empty();
+  if (kOptimize) {
+    progress_(generation, "Optimizing");
+    model->vertex_cache_input = AnalyzeVertexCache(
+        mesh->faces_.data(), kTriangles, mesh->vertex_count(), kVertexSize);
+    // Rasterizing six views of the mesh twice costs about a second on
+    // millions of triangles, so overdraw is only measured while the
+    // threshold is being tuned away from its default.
+    const bool kOverdraw = optimization.overdraw_threshold !=
+                           MeshOptimization().overdraw_threshold;
+    if (kOverdraw)
+      model->overdraw_input = AnalyzeOverdraw(mesh->vertices_, mesh->faces_);
+    // The same stages as the compressor, so both produce the same order.
+    OptimizeMesh(mesh, optimization);
+    if (kOverdraw) {
+      model->overdraw = AnalyzeOverdraw(mesh->vertices_, mesh->faces_);
+      std::cerr << "Overdraw " << model->overdraw_input << " -> "
+                << model->overdraw << std::endl;
+    }
+    if (!current(generation)) return nullptr;
+  }
+  model->vertex_cache = AnalyzeVertexCache(
+      mesh->faces_.data(), kTriangles, mesh->vertex_count(), kVertexSize);
+  if (kOptimize)
+    std::cerr << "Vertex cache ACMR " << model->vertex_cache_input.acmr
+              << " -> " << model->vertex_cache.acmr << ", ATVR "
+              << model->vertex_cache_input.atvr << " -> "
+              << model->vertex_cache.atvr << ", overfetch "
+              << model->vertex_cache_input.overfetch << " -> "
+              << model->vertex_cache.overfetch << std::endl;
+
+  // The levels are built from a copy once the full mesh is handed over, and
+  // the cache is written with them.
+  if (kOptimize && optimization.lods) {
+    deferred->mesh = std::make_unique<TriangleMesh>();
+    deferred->mesh->vertices_ = mesh->vertices_;
+    deferred->mesh->faces_ = mesh->faces_;
+    deferred->mesh->buffer_ = mesh->buffer_;
+    deferred->mesh->min_ = mesh->min_;
+    deferred->mesh->max_ = mesh->max_;
+    deferred->cache = kCached;
+    return model;
+  }
+
+  // The cache of a quantized container would be several times its size.
+  if (kType.compare("qmesh") == 0 || !kCached) return model;
+
+  progress_(generation, "Caching");
+  if (!WriteMeshCache(filename, *model->mesh))
+    std::cerr << "Could not write the cache of " + filename << std::endl;
+  return model;
+}
+
+}  // namespace data_representation
@@ -0,0 +1,276 @@
+// Author: Marc Comino 2020
+
+#ifndef MODEL_LOADER_H_
+#define MODEL_LOADER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./glb_io.h"
+#include "./mesh_cache.h"
+#include "./mesh_optimizer.h"
+#include "./mesh_processing.h"
+#include "./ply_stream.h"
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+/**
+ * @brief LoadedModel A model read by the loader thread and waiting to be
+ * uploaded. Only the representation named by source is filled.
+ */
+struct LoadedModel {
+  enum class Source { kCache, kGlb, kMesh, kStream };
+
+  Source source = Source::kMesh;
+  std::string filename;
+
+  /**
+   * @brief cache A valid mesh cache, mapped.
+   */
+  MeshCache cache;
+
+  /**
+   * @brief glb An aliasable GLB file, mapped.
+   */
+  GlbFile glb;
+
+  /**
+   * @brief mesh A parsed model with its vertex buffer prepared.
+   */
+  std::unique_ptr<TriangleMesh> mesh;
+
+  /**
+   * @brief stream Summary of a model whose buffers were streamed through
+   * StreamWindows.
+   */
+  PlyStreamInfo stream;
+
+  /**
+   * @brief vertex_cache Vertex cache efficiency of the cached or parsed index
+   * buffer as it is uploaded. Left zero for GLB and streamed models.
+   */
+  VertexCacheStats vertex_cache;
+
+  /**
+   * @brief vertex_cache_input Efficiency of the parsed index buffer before
+   * the loader reordered it, zero when it was not reordered.
+   */
+  VertexCacheStats vertex_cache_input;
+
+  /**
+   * @brief overdraw Overdraw of the parsed index buffer as it is uploaded,
+   * see AnalyzeOverdraw. Only measured when the overdraw threshold differs
+   * from its default, zero otherwise.
+   */
+  double overdraw = 0.0;
+
+  /**
+   * @brief overdraw_input Overdraw of the parsed index buffer before the
+   * loader reordered it.
+   */
+  double overdraw_input = 0.0;
+};
+
+/**
+ * @brief LoadedLods Levels of detail built after their model was handed over:
+ * the indices of every level, the full mesh first, and their ranges.
+ */
+struct LoadedLods {
+  std::vector<int> faces;
+  std::vector<MeshLod> lods;
+};
+
+/**
+ * @brief StreamWindow A piece of a streamed model on its way to the GPU. The
+ * first window of a stream gives the buffer sizes, the others are data to
+ * copy offset bytes into the vertex or the index buffer.
+ */
+struct StreamWindow {
+  enum class Kind { kBegin, kVertices, kIndices };
+
+  Kind kind = Kind::kBegin;
+  unsigned generation = 0;
+  size_t offset = 0;
+  std::vector<char> data;
+  size_t vertex_bytes = 0;
+  size_t index_bytes = 0;
+};
+
+/**
+ * @brief ReadModel Reads the model at filename with the importer of its
+ * extension: ply, obj, stl, glb or qmesh. GLB files are always copied. Only
+ * PLY and OBJ files honor policy: STL files carry face normals only, and GLB
+ * and qmesh files are read with the normals they store.
+ * @param filename The path to the model.
+ * @param mesh The resulting representation.
+ * @param policy When normals are computed.
+ * @return Whether it was able to read the file.
+ */
+bool ReadModel(const std::string &filename, TriangleMesh *mesh,
+               NormalPolicy policy);
+
+/**
+ * @brief ModelLoader Reads models on a background thread, doing everything but
+ * the upload: mapping the cache, parsing, computing normals and writing the
+ * cache. Every request gets a generation number; a newer request supersedes
+ * the older ones, which stop at the next stage boundary and are discarded.
+ * PLY files too large to be held in memory are streamed instead, through a
+ * short queue of StreamWindows drained by the thread that owns the buffers.
+ * Levels of detail take longer to build than the rest of a load, so they are
+ * built after the model is handed over and delivered as LoadedLods; the
+ * cache is written once they are ready.
+ */
+class ModelLoader {
+ public:
+  /**
+   * @brief ProgressCallback Called from the loader thread when a load enters a
+   * new stage.
+   */
+  using ProgressCallback =
+      std::function<void(unsigned generation, const std::string &stage)>;
+
+  /**
+   * @brief DoneCallback Called from the loader thread when a load that was
+   * not superseded finishes. On success the model is ready to be taken.
+   */
+  using DoneCallback = std::function<void(unsigned generation, bool success)>;
+
+  /**
+   * @brief WindowCallback Called from the loader thread when a stream window
+   * is ready to be taken.
+   */
+  using WindowCallback = std::function<void(unsigned generation)>;
+
+  /**
+   * @brief LodsCallback Called from the loader thread when the levels of
+   * detail of the model of a request are ready to be taken.
+   */
+  using LodsCallback = std::function<void(unsigned generation)>;
+
+  ModelLoader(ProgressCallback progress, DoneCallback done,
+              WindowCallback window, LodsCallback lods);
+
+  /**
+   * @brief ~ModelLoader Cancels pending work and waits for the thread, which
+   * may take until the current stage of an in-flight load ends.
+   */
+  ~ModelLoader();
+
+  ModelLoader(const ModelLoader &) = delete;
+  ModelLoader &operator=(const ModelLoader &) = delete;
+
+  /**
+   * @brief Load Queues the model at filename, superseding any earlier
+   * request. The mesh cache is only used, and written, with the default
+   * NormalPolicy::kWhenMissing and the default MeshOptimization.
+   * @return The generation of the request.
+   */
+  unsigned Load(const std::string &filename, NormalPolicy policy,
+                const MeshOptimization &optimization);
+
+  /**
+   * @brief Take Hands over the model read by request generation.
+   * @return The model, or nullptr if it is not the latest finished request.
+   */
+  std::unique_ptr<LoadedModel> Take(unsigned generation);
+
+  /**
+   * @brief TakeWindow Pops the oldest stream window of request generation.
+   * Windows of superseded requests are dropped.
+   * @return Whether there was a window.
+   */
+  bool TakeWindow(unsigned generation, StreamWindow *window);
+
+  /**
+   * @brief TakeLods Hands over the levels of detail built for the model of
+   * request generation.
+   * @return The levels, or nullptr if they are not those of the latest
+   * request.
+   */
+  std::unique_ptr<LoadedLods> TakeLods(unsigned generation);
+
+  /**
+   * @brief current Whether generation is the latest request.
+   */
+  bool current(unsigned generation) const { return generation == generation_; }
+
+ private:
+  void Run();
+
+  /**
+   * @brief Deferred Work left once a model is handed over: the mesh its
+   * levels of detail are built from, and whether the cache is written then.
+   */
+  struct Deferred {
+    std::unique_ptr<TriangleMesh> mesh;
+    bool cache = false;
+  };
+
+  /**
+   * @brief Read Does the work of one request, checking for cancellation
+   * between stages.
+   * @param deferred Filled when levels of detail are to be built after the
+   * model is handed over.
+   */
+  std::unique_ptr<LoadedModel> Read(const std::string &filename,
+                                    NormalPolicy policy,
+                                    const MeshOptimization &optimization,
+                                    unsigned generation, Deferred *deferred);
+
+  /**
+   * @brief BuildDeferredLods Builds the levels of detail of a handed over
+   * model, stopping as soon as the request is superseded, and writes its
+   * cache.
+   */
+  void BuildDeferredLods(const std::string &filename, Deferred *deferred,
+                         unsigned generation);
+
+  class WindowSink;
+
+  /**
+   * @brief PushWindow Queues a stream window, waiting while the queue is
+   * full.
+   * @return False if the request was superseded meanwhile.
+   */
+  bool PushWindow(StreamWindow window);
+
+  ProgressCallback progress_;
+  DoneCallback done_;
+  WindowCallback window_;
+  LodsCallback lods_;
+
+  std::atomic<unsigned> generation_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::string pending_;
+  NormalPolicy pending_policy_;
+  MeshOptimization pending_optimization_;
+  bool has_pending_;
+  bool stop_;
+  std::unique_ptr<LoadedModel> result_;
+  unsigned result_generation_;
+  std::unique_ptr<LoadedLods> lods_result_;
+  unsigned lods_generation_;
+
+  /**
+   * @brief windows_ Stream windows not yet taken. Its size is bounded, so a
+   * stream holds at most a few windows in memory.
+   */
+  std::deque<StreamWindow> windows_;
+  std::condition_variable drained_;
+
+  std::thread thread_;
+};
+
+}  // namespace data_representation
+
+#endif  // MODEL_LOADER_H_
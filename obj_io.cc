@@ -0,0 +1,413 @@
+// Author: Marc Comino 2020
+
+#include <obj_io.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./mapped_file.h"
+#include "./mesh_processing.h"
+#include "./parallel.h"
+#include "./text_parser.h"
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kChunkSize Minimum amount of text handed to a parsing thread.
+ */
+const size_t kChunkSize = 1 << 20;
+
+/**
+ * @brief kCornerBlock Face corners per task when de-duplicating vertices.
+ */
+const size_t kCornerBlock = 1 << 16;
+
+enum class ObjRecord { kOther, kPosition, kNormal, kTexCoord, kFace };
+
+/**
+ * @brief ChunkCounts Records of every kind found in a chunk of lines.
+ */
+struct ChunkCounts {
+  size_t positions = 0;
+  size_t normals = 0;
+  size_t texcoords = 0;
+  size_t triangles = 0;
+};
+
+bool IsBlank(const char *p, const char *end) {
+  return p < end && (*p == ' ' || *p == '\t');
+}
+
+/**
+ * @brief ReadKeyword Identifies the record stored in a line and advances *p
+ * past its keyword.
+ */
+ObjRecord ReadKeyword(const char **p, const char *end) {
+  const char *c = SkipSpaces(*p, end);
+  ObjRecord record = ObjRecord::kOther;
+  if (c < end && *c == 'v') {
+    if (IsBlank(c + 1, end)) {
+      record = ObjRecord::kPosition;
+      c += 1;
+    } else if (c + 1 < end && c[1] == 'n' && IsBlank(c + 2, end)) {
+      record = ObjRecord::kNormal;
+      c += 2;
+    } else if (c + 1 < end && c[1] == 't' && IsBlank(c + 2, end)) {
+      record = ObjRecord::kTexCoord;
+      c += 2;
+    }
+  } else if (c < end && *c == 'f' && IsBlank(c + 1, end)) {
+    record = ObjRecord::kFace;
+    c += 1;
+  }
+  *p = c;
+  return record;
+}
+
+/**
+ * @brief AtLineEnd Whether only blanks or a comment remain in the line.
+ */
+bool AtLineEnd(const char **p, const char *end) {
+  *p = SkipSpaces(*p, end);
+  return *p >= end || **p == '\n' || **p == '#';
+}
+
+/**
+ * @brief CountCorners Number of corners of a face line.
+ */
+size_t CountCorners(const char *p, const char *end) {
+  size_t corners = 0;
+  while (!AtLineEnd(&p, end)) {
+    ++corners;
+    while (p < end && *p > ' ') ++p;
+  }
+  return corners;
+}
+
+/**
+ * @brief ParseCorner Parses a v, v/t, v//n or v/t/n face corner.
+ * @param position The raw position index.
+ * @param normal The raw normal index, 0 if the corner has none.
+ */
+bool ParseCorner(const char **p, const char *end, int64_t *position,
+                 int64_t *normal) {
+  *normal = 0;
+  if (!ParseInt(p, end, position)) return false;
+  if (*p < end && **p == '/') {
+    ++*p;
+    int64_t texcoord;
+    if (*p < end && **p != '/' && !ParseInt(p, end, &texcoord)) return false;
+    if (*p < end && **p == '/') {
+      ++*p;
+      if (!ParseInt(p, end, normal)) return false;
+    }
+  }
+
+  // The corner has to fill its whole token, as counted by CountCorners.
+  return *p >= end || **p <= ' ';
+}
+
+/**
+ * @brief ResolveIndex Converts a 1-based or negative relative OBJ index into a
+ * 0-based one.
+ * @param defined Number of records of the kind defined before the face.
+ * @param count Number of records of the kind in the whole file.
+ * @return The index, or -1 if it is out of range.
+ */
+int64_t ResolveIndex(int64_t index, size_t defined, size_t count) {
+  const int64_t kResolved =
+      index > 0 ? index - 1 : static_cast<int64_t>(defined) + index;
+  if (index == 0 || kResolved < 0 ||
+      kResolved >= static_cast<int64_t>(count))
+    return -1;
+  return kResolved;
+}
+
+/**
+ * @brief VertexTable Lock-free hash map from a (position, normal) pair to the
+ * first face corner that uses it. Since the smallest corner always wins, the
+ * result does not depend on the order in which threads insert their corners.
+ */
+class VertexTable {
+ public:
+  explicit VertexTable(size_t keys) : mask_(1) {
+    while (mask_ < keys * 2) mask_ <<= 1;
+    slots_.reset(new Slot[mask_]);
+    ParallelForRange(0, mask_, kCornerBlock, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        slots_[i].key.store(kEmpty, std::memory_order_relaxed);
+        slots_[i].corner.store(kNone, std::memory_order_relaxed);
+      }
+    });
+    --mask_;
+  }
+
+  /**
+   * @brief Insert Records that corner uses the key.
+   */
+  void Insert(uint64_t key, uint32_t corner) {
+    Slot &slot = slots_[Probe(key, true)];
+    uint32_t first = slot.corner.load();
+    while (corner < first &&
+           !slot.corner.compare_exchange_weak(first, corner)) {
+    }
+  }
+
+  /**
+   * @brief Find Returns the first corner that uses an inserted key.
+   */
+  uint32_t Find(uint64_t key) const {
+    return slots_[Probe(key, false)].corner.load();
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> key;
+    std::atomic<uint32_t> corner;
+  };
+
+  static const uint64_t kEmpty = std::numeric_limits<uint64_t>::max();
+  static const uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+  size_t Probe(uint64_t key, bool insert) const {
+    uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 29;
+    for (size_t i = hash & mask_;; i = (i + 1) & mask_) {
+      uint64_t current = slots_[i].key.load();
+      if (insert && current == kEmpty &&
+          slots_[i].key.compare_exchange_strong(current, key))
+        return i;
+      if (current == key) return i;
+    }
+  }
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+};
+
+uint64_t CornerKey(int position, int normal) {
+  return static_cast<uint64_t>(position) << 32 | static_cast<uint32_t>(normal);
+}
+
+/**
+ * @brief WeldCorners Creates one vertex per distinct position/normal pair of
+ * the face corners, numbered in order of first use, and fills the mesh arrays.
+ */
+void WeldCorners(const std::vector<float> &positions,
+                 const std::vector<float> &normals,
+                 const std::vector<int> &corner_positions,
+                 const std::vector<int> &corner_normals, TriangleMesh *mesh) {
+  const size_t kCorners = corner_positions.size();
+  VertexTable table(kCorners);
+  ParallelForRange(0, kCorners, kCornerBlock, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      table.Insert(CornerKey(corner_positions[i], corner_normals[i]),
+                   static_cast<uint32_t>(i));
+  });
+
+  // The first corner of every pair becomes a vertex. Blocks are fixed so the
+  // numbering is the same for any number of threads.
+  std::vector<uint32_t> first(kCorners);
+  const size_t kBlocks = (kCorners + kCornerBlock - 1) / kCornerBlock;
+  std::vector<size_t> first_vertex(kBlocks + 1, 0);
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kEnd = std::min(kCorners, (block + 1) * kCornerBlock);
+    size_t vertices = 0;
+    for (size_t i = block * kCornerBlock; i < kEnd; ++i) {
+      first[i] = table.Find(CornerKey(corner_positions[i], corner_normals[i]));
+      if (first[i] == i) ++vertices;
+    }
+    first_vertex[block + 1] = vertices;
+  });
+  for (size_t i = 0; i < kBlocks; ++i) first_vertex[i + 1] += first_vertex[i];
+
+  mesh->vertices_.resize(first_vertex[kBlocks] * 3);
+  mesh->normals_.resize(first_vertex[kBlocks] * 3);
+  mesh->faces_.resize(kCorners);
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kEnd = std::min(kCorners, (block + 1) * kCornerBlock);
+    size_t vertex = first_vertex[block];
+    for (size_t i = block * kCornerBlock; i < kEnd; ++i) {
+      if (first[i] != i) continue;
+      std::copy_n(&positions[corner_positions[i] * 3], 3,
+                  &mesh->vertices_[vertex * 3]);
+      std::copy_n(&normals[corner_normals[i] * 3], 3,
+                  &mesh->normals_[vertex * 3]);
+      mesh->faces_[i] = static_cast<int>(vertex++);
+    }
+  });
+  ParallelForRange(0, kCorners, kCornerBlock, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      if (first[i] != i) mesh->faces_[i] = mesh->faces_[first[i]];
+  });
+}
+
+}  // namespace
+
+bool ReadFromObj(const std::string &filename, TriangleMesh *mesh) {
+  return ReadFromObj(filename, mesh, NormalPolicy::kWhenMissing);
+}
+
+bool ReadFromObj(const std::string &filename, TriangleMesh *mesh,
+                 NormalPolicy policy) {
+  const auto kStart = std::chrono::steady_clock::now();
+
+  MappedFile file;
+  if (!file.Open(filename)) return false;
+
+  const char *kBegin = file.data();
+  const char *kEnd = kBegin + file.size();
+  const std::vector<const char *> kBounds =
+      SplitLines(kBegin, kEnd, kChunkSize, NumThreads() * 4);
+  const size_t kChunks = kBounds.size() - 1;
+
+  // First pass: count the records of every chunk, so that each one knows the
+  // index of its first record of every kind.
+  std::vector<ChunkCounts> first(kChunks + 1);
+  ParallelFor(kChunks, [&](size_t chunk) {
+    ChunkCounts counts;
+    const char *kChunkEnd = kBounds[chunk + 1];
+    for (const char *p = kBounds[chunk]; p < kChunkEnd;
+         p = SkipLine(p, kChunkEnd)) {
+      switch (ReadKeyword(&p, kChunkEnd)) {
+        case ObjRecord::kPosition: ++counts.positions; break;
+        case ObjRecord::kNormal: ++counts.normals; break;
+        case ObjRecord::kTexCoord: ++counts.texcoords; break;
+        case ObjRecord::kFace: {
+          const size_t kCorners = CountCorners(p, kChunkEnd);
+          if (kCorners > 2) counts.triangles += kCorners - 2;
+          break;
+        }
+        default: break;
+      }
+    }
+    first[chunk + 1] = counts;
+  });
+  for (size_t i = 0; i < kChunks; ++i) {
+    first[i + 1].positions += first[i].positions;
+    first[i + 1].normals += first[i].normals;
+    first[i + 1].texcoords += first[i].texcoords;
+    first[i + 1].triangles += first[i].triangles;
+  }
+
+  const ChunkCounts kTotal = first[kChunks];
+  if (kTotal.positions == 0 ||
+      kTotal.positions > static_cast<size_t>(std::numeric_limits<int>::max()) ||
+      kTotal.triangles * 3 > std::numeric_limits<uint32_t>::max()) {
+    std::cout << "\tError loading records " << std::endl;
+    return false;
+  }
+
+  std::cout << "Loading triangle mesh" << std::endl;
+  std::cout << "\tPositions = " << kTotal.positions << std::endl;
+  std::cout << "\tNormals = " << kTotal.normals << std::endl;
+  std::cout << "\tTriangles = " << kTotal.triangles << std::endl;
+
+  // Second pass: parse the records straight into place.
+  std::vector<float> positions(kTotal.positions * 3);
+  std::vector<float> normals(kTotal.normals * 3);
+  std::vector<int> corner_positions(kTotal.triangles * 3);
+  std::vector<int> corner_normals(kTotal.triangles * 3);
+  std::atomic<bool> valid(true);
+  std::atomic<bool> all_normals(kTotal.normals > 0);
+  ParallelFor(kChunks, [&](size_t chunk) {
+    ChunkCounts counts = first[chunk];
+    const char *kChunkEnd = kBounds[chunk + 1];
+    for (const char *p = kBounds[chunk]; p < kChunkEnd && valid;
+         p = SkipLine(p, kChunkEnd)) {
+      const ObjRecord kRecord = ReadKeyword(&p, kChunkEnd);
+      if (kRecord == ObjRecord::kPosition || kRecord == ObjRecord::kNormal) {
+        float *values = kRecord == ObjRecord::kPosition
+                            ? &positions[counts.positions++ * 3]
+                            : &normals[counts.normals++ * 3];
+        for (int j = 0; j < 3; ++j)
+          if (!ParseFloat(&p, kChunkEnd, values + j)) valid = false;
+      } else if (kRecord == ObjRecord::kTexCoord) {
+        ++counts.texcoords;
+      } else if (kRecord == ObjRecord::kFace) {
+        int64_t first_position = -1, first_normal = -1;
+        int64_t previous_position = -1, previous_normal = -1;
+        for (size_t j = 0; !AtLineEnd(&p, kChunkEnd); ++j) {
+          int64_t position, normal;
+          if (!ParseCorner(&p, kChunkEnd, &position, &normal)) {
+            valid = false;
+            break;
+          }
+          position =
+              ResolveIndex(position, counts.positions, kTotal.positions);
+          normal = normal == 0 ? -1
+                               : ResolveIndex(normal, counts.normals,
+                                              kTotal.normals);
+          if (position < 0) valid = false;
+          if (normal < 0) all_normals = false;
+
+          if (j == 0) {
+            first_position = position;
+            first_normal = normal;
+          } else if (j >= 2) {
+            int *face_positions = &corner_positions[counts.triangles * 3];
+            int *face_normals = &corner_normals[counts.triangles * 3];
+            ++counts.triangles;
+            face_positions[0] = static_cast<int>(first_position);
+            face_positions[1] = static_cast<int>(previous_position);
+            face_positions[2] = static_cast<int>(position);
+            face_normals[0] = static_cast<int>(first_normal);
+            face_normals[1] = static_cast<int>(previous_normal);
+            face_normals[2] = static_cast<int>(normal);
+          }
+          previous_position = position;
+          previous_normal = normal;
+        }
+      }
+    }
+  });
+
+  if (!valid) {
+    std::cout << "\tMalformed OBJ records " << std::endl;
+    return false;
+  }
+  file.Close();
+
+  // A reused mesh must not keep the colors, levels or bounds of the last
+  // model.
+  mesh->Clear();
+  if (all_normals && policy != NormalPolicy::kAlways) {
+    WeldCorners(positions, normals, corner_positions, corner_normals, mesh);
+    std::cout << "\tMerged position/normal pairs into "
+              << mesh->vertices_.size() / 3 << " vertices " << std::endl;
+  } else {
+    mesh->vertices_.swap(positions);
+    mesh->faces_.swap(corner_positions);
+    if (policy == NormalPolicy::kNever) {
+      mesh->normals_.assign(mesh->vertices_.size(), 0.0f);
+      std::cout << "\tSkipped normals " << std::endl;
+    } else {
+      ComputeVertexNormals(mesh->vertices_, mesh->faces_, &mesh->normals_);
+      std::cout << "\tGenerated normals " << std::endl;
+    }
+  }
+
+  const double kSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - kStart)
+                              .count();
+  std::cout << "\tRead OBJ in " << kSeconds * 1000.0 << " ms" << std::endl;
+
+  ComputeBoundingBox(mesh->vertices_, mesh);
+  std::cout << "\tGenerated bounding box " << std::endl;
+  mesh->prepareVertexBuffer();
+  std::cout << "\tPrepared vertex buffer " << std::endl;
+  return true;
+}
+
+}  // namespace data_representation
@@ -0,0 +1,41 @@
+// Author: Marc Comino 2020
+
+#ifndef OBJ_IO_H_
+#define OBJ_IO_H_
+
+#include <triangle_mesh.h>
+
+#include <string>
+
+#include "./mesh_processing.h"
+
+namespace data_representation {
+
+/**
+ * @brief ReadFromObj Reads the mesh stored in Wavefront OBJ format at the path
+ * filename and stores the corresponding TriangleMesh representation. Polygons
+ * are fan triangulated. When every face corner references a normal, each
+ * distinct position/normal pair becomes a vertex with the file normal;
+ * otherwise vertices are the file positions and normals are computed. Texture
+ * coordinates are parsed but not stored, the mesh has no channel for them.
+ * @param filename The path to the OBJ mesh.
+ * @param mesh The resulting representation with per-vertex normals.
+ * @return Whether it was able to read the file.
+ */
+bool ReadFromObj(const std::string &filename, TriangleMesh *mesh);
+
+/**
+ * @brief ReadFromObj Same as above, choosing between the normals of the file
+ * and computed ones. Unless they are always computed, file normals are used
+ * when every face corner references one.
+ * @param filename The path to the OBJ mesh.
+ * @param mesh The resulting representation with per-vertex normals.
+ * @param policy When normals are computed.
+ * @return Whether it was able to read the file.
+ */
+bool ReadFromObj(const std::string &filename, TriangleMesh *mesh,
+                 NormalPolicy policy);
+
+}  // namespace data_representation
+
+#endif  // OBJ_IO_H_
@@ -0,0 +1,127 @@
+// Author: Marc Comino 2020
+
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief NumThreads Number of worker threads used by the parallel loops.
+ * @return The hardware concurrency, at least one.
+ */
+inline size_t NumThreads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * @brief ParallelFor Calls body(i) for every i in [0, count). Tasks are handed
+ * out dynamically to up to NumThreads() threads, so count should be a number
+ * of coarse chunks rather than of individual elements. An exception thrown by
+ * body is rethrown once every thread has stopped.
+ * @param count Number of tasks.
+ * @param body Callable taking the task index.
+ */
+template <typename Function>
+void ParallelFor(size_t count, const Function &body) {
+  const size_t kThreads = std::min(NumThreads(), count);
+  if (kThreads <= 1) {
+    for (size_t i = 0; i < count; ++i) body(i);
+    return;
+  }
+
+  // An exception escaping a thread would terminate the program, so the first
+  // one stops the remaining tasks and is rethrown to the caller.
+  std::atomic<size_t> next(0);
+  std::mutex mutex;
+  std::exception_ptr error;
+  auto worker = [&]() {
+    try {
+      for (size_t i = next++; i < count; i = next++) body(i);
+    } catch (...) {
+      next = count;
+      std::lock_guard<std::mutex> lock(mutex);
+      if (error == nullptr) error = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(kThreads - 1);
+  for (size_t i = 1; i < kThreads; ++i) threads.emplace_back(worker);
+  worker();
+  for (std::thread &thread : threads) thread.join();
+  if (error != nullptr) std::rethrow_exception(error);
+}
+
+/**
+ * @brief ParallelForRange Splits [begin, end) into contiguous blocks of at
+ * least grain elements and calls body(block_begin, block_end) for each of them
+ * in parallel.
+ * @param begin First element.
+ * @param end One past the last element.
+ * @param grain Minimum number of elements per block.
+ * @param body Callable taking the block range.
+ */
+template <typename Function>
+void ParallelForRange(size_t begin, size_t end, size_t grain,
+                      const Function &body) {
+  if (end <= begin) return;
+
+  const size_t kCount = end - begin;
+  const size_t kBlock =
+      std::max(std::max<size_t>(grain, 1),
+               (kCount + NumThreads() * 4 - 1) / (NumThreads() * 4));
+  const size_t kBlocks = (kCount + kBlock - 1) / kBlock;
+
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kBegin = begin + block * kBlock;
+    body(kBegin, std::min(end, kBegin + kBlock));
+  });
+}
+
+/**
+ * @brief ParallelExclusiveScan Replaces every value by the sum of the values
+ * before it. Blocks are summed in parallel, their sums are scanned serially
+ * and every block is then scanned in parallel from its offset.
+ * @param values The values to scan in place.
+ * @return The sum of all the values.
+ */
+template <typename T>
+T ParallelExclusiveScan(std::vector<T> *values) {
+  const size_t kCount = values->size();
+  const size_t kBlock = std::max<size_t>(
+      1 << 16, (kCount + NumThreads() * 4 - 1) / (NumThreads() * 4));
+  const size_t kBlocks = (kCount + kBlock - 1) / kBlock;
+
+  std::vector<T> offsets(kBlocks + 1, T(0));
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kEnd = std::min(kCount, (block + 1) * kBlock);
+    T sum(0);
+    for (size_t i = block * kBlock; i < kEnd; ++i) sum += (*values)[i];
+    offsets[block + 1] = sum;
+  });
+  for (size_t block = 0; block < kBlocks; ++block)
+    offsets[block + 1] += offsets[block];
+
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kEnd = std::min(kCount, (block + 1) * kBlock);
+    T sum = offsets[block];
+    for (size_t i = block * kBlock; i < kEnd; ++i) {
+      const T kValue = (*values)[i];
+      (*values)[i] = sum;
+      sum += kValue;
+    }
+  });
+  return offsets[kBlocks];
+}
+
+}  // namespace data_representation
+
+#endif  // PARALLEL_H_
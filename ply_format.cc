@@ -0,0 +1,677 @@
+// Author: Marc Comino 2020
+
+#include <ply_format.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "./byte_swap.h"
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+template <typename T>
+T Load(const char *p) {
+  T value;
+  memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+double LoadAsDouble(PlyType type, const char *p) {
+  switch (type) {
+    case PlyType::kInt8: return Load<int8_t>(p);
+    case PlyType::kUint8: return Load<uint8_t>(p);
+    case PlyType::kInt16: return Load<int16_t>(p);
+    case PlyType::kUint16: return Load<uint16_t>(p);
+    case PlyType::kInt32: return Load<int32_t>(p);
+    case PlyType::kUint32: return Load<uint32_t>(p);
+    case PlyType::kFloat32: return Load<float>(p);
+    case PlyType::kFloat64: return Load<double>(p);
+    default: return 0.0;
+  }
+}
+
+int64_t LoadAsInt(PlyType type, const char *p) {
+  switch (type) {
+    case PlyType::kInt8: return Load<int8_t>(p);
+    case PlyType::kUint8: return Load<uint8_t>(p);
+    case PlyType::kInt16: return Load<int16_t>(p);
+    case PlyType::kUint16: return Load<uint16_t>(p);
+    case PlyType::kInt32: return Load<int32_t>(p);
+    case PlyType::kUint32: return Load<uint32_t>(p);
+    case PlyType::kFloat32: return static_cast<int64_t>(Load<float>(p));
+    case PlyType::kFloat64: return static_cast<int64_t>(Load<double>(p));
+    default: return 0;
+  }
+}
+
+PlyType ParsePlyType(const std::string &name) {
+  if (name == "char" || name == "int8") return PlyType::kInt8;
+  if (name == "uchar" || name == "uint8") return PlyType::kUint8;
+  if (name == "short" || name == "int16") return PlyType::kInt16;
+  if (name == "ushort" || name == "uint16") return PlyType::kUint16;
+  if (name == "int" || name == "int32") return PlyType::kInt32;
+  if (name == "uint" || name == "uint32") return PlyType::kUint32;
+  if (name == "float" || name == "float32") return PlyType::kFloat32;
+  if (name == "double" || name == "float64") return PlyType::kFloat64;
+  return PlyType::kInvalid;
+}
+
+/**
+ * @brief NextLine Returns the line starting at *pos (without the line break)
+ * and advances *pos past it.
+ */
+std::string NextLine(const char *data, size_t size, size_t *pos) {
+  const char *begin = data + *pos;
+  const char *end = static_cast<const char *>(memchr(begin, '\n', size - *pos));
+  if (end == nullptr) end = data + size;
+
+  *pos = std::min(size, static_cast<size_t>(end - data) + 1);
+  if (end > begin && *(end - 1) == '\r') --end;
+  return std::string(begin, end);
+}
+
+/**
+ * @brief PropertyEnd Walks a single property of a binary record.
+ * @return One past its last byte, or nullptr if it overruns end.
+ */
+const char *PropertyEnd(const char *p, const char *end,
+                        const PlyProperty &property) {
+  if (!property.is_list()) {
+    if (static_cast<size_t>(end - p) < PlyTypeSize(property.type))
+      return nullptr;
+    return p + PlyTypeSize(property.type);
+  }
+
+  const size_t kCountSize = PlyTypeSize(property.count_type);
+  if (static_cast<size_t>(end - p) < kCountSize) return nullptr;
+  const int64_t kEntries = LoadAsInt(property.count_type, p);
+  const size_t kEntrySize = PlyTypeSize(property.type);
+  p += kCountSize;
+  if (kEntries < 0 ||
+      static_cast<size_t>(end - p) / kEntrySize < static_cast<size_t>(kEntries))
+    return nullptr;
+  return p + kEntries * kEntrySize;
+}
+
+/**
+ * @brief RecordEnd Walks a variable-size binary record.
+ * @return One past its last byte, or nullptr if it overruns end.
+ */
+const char *RecordEnd(const char *p, const char *end,
+                      const PlyElement &element) {
+  for (size_t i = 0; i < element.properties.size() && p != nullptr; ++i)
+    p = PropertyEnd(p, end, element.properties[i]);
+  return p;
+}
+
+/**
+ * @brief kSwapBlock Records swapped per task when converting big endian data.
+ */
+const size_t kSwapBlock = 1 << 16;
+
+/**
+ * @brief SwapFixedRecords Swaps count records of the given field sizes in
+ * parallel blocks.
+ */
+void SwapFixedRecords(char *data, size_t count,
+                      const std::vector<size_t> &fields, size_t stride) {
+  ParallelForRange(0, count, kSwapBlock, [&](size_t begin, size_t end) {
+    ByteSwapRecords(data + begin * stride, end - begin, fields);
+  });
+}
+
+/**
+ * @brief AllBigEndianTriangles Whether every record of a face element made of
+ * a single big endian list stores exactly three entries. Records are checked
+ * in parallel assuming triangle-sized strides, as in AllTriangleRecords.
+ */
+bool AllBigEndianTriangles(const char *data, size_t count, size_t count_size,
+                           size_t stride) {
+  std::atomic<bool> triangles(true);
+  ParallelForRange(0, count, kSwapBlock, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const char *kRecord = data + i * stride;
+      bool triangle = kRecord[count_size - 1] == 3;
+      for (size_t b = 0; b + 1 < count_size; ++b)
+        triangle = triangle && kRecord[b] == 0;
+      if (!triangle) {
+        triangles = false;
+        return;
+      }
+    }
+  });
+  return triangles;
+}
+
+typedef void (*PositionKernel)(const char *data, size_t count, size_t offset,
+                               float *positions);
+
+/**
+ * @brief DecodePackedPositions Kernel for records of kStride bytes holding
+ * consecutive x, y, z values of type T at the given offset.
+ */
+template <typename T, size_t kStride>
+void DecodePackedPositions(const char *data, size_t count, size_t offset,
+                           float *positions) {
+  const char *record = data + offset;
+  for (size_t i = 0; i < count; ++i, record += kStride) {
+    T xyz[3];
+    memcpy(xyz, record, sizeof(xyz));
+    positions[i * 3] = static_cast<float>(xyz[0]);
+    positions[i * 3 + 1] = static_cast<float>(xyz[1]);
+    positions[i * 3 + 2] = static_cast<float>(xyz[2]);
+  }
+}
+
+/**
+ * @brief DecodePackedPositions Tightly packed float positions already are our
+ * memory layout.
+ */
+template <>
+void DecodePackedPositions<float, 3 * sizeof(float)>(const char *data,
+                                                     size_t count, size_t,
+                                                     float *positions) {
+  memcpy(positions, data, count * 3 * sizeof(float));
+}
+
+/**
+ * @brief PositionLayout A vertex record layout with a specialized kernel. The
+ * kernels take the offset of the triplet, so they decode normals too.
+ */
+struct PositionLayout {
+  PlyType type;
+  size_t stride;
+  PositionKernel kernel;
+};
+
+const PositionLayout kPositionLayouts[] = {
+    // x y z
+    {PlyType::kFloat32, 12, &DecodePackedPositions<float, 12>},
+    // x y z red green blue
+    {PlyType::kFloat32, 15, &DecodePackedPositions<float, 15>},
+    // x y z red green blue alpha, x y z confidence
+    {PlyType::kFloat32, 16, &DecodePackedPositions<float, 16>},
+    // x y z u v
+    {PlyType::kFloat32, 20, &DecodePackedPositions<float, 20>},
+    // x y z nx ny nz
+    {PlyType::kFloat32, 24, &DecodePackedPositions<float, 24>},
+    // x y z nx ny nz red green blue
+    {PlyType::kFloat32, 27, &DecodePackedPositions<float, 27>},
+    // x y z nx ny nz red green blue alpha, x y z nx ny nz confidence
+    {PlyType::kFloat32, 28, &DecodePackedPositions<float, 28>},
+    // x y z nx ny nz u v
+    {PlyType::kFloat32, 32, &DecodePackedPositions<float, 32>},
+    // double x y z
+    {PlyType::kFloat64, 24, &DecodePackedPositions<double, 24>},
+    // double x y z nx ny nz
+    {PlyType::kFloat64, 48, &DecodePackedPositions<double, 48>},
+};
+
+/**
+ * @brief DecodeStridedPositions Generic fallback for any fixed-size layout.
+ */
+void DecodeStridedPositions(const char *data, size_t count, size_t stride,
+                            const PlyProperty *xyz[3], float *positions) {
+  for (size_t i = 0; i < count; ++i, data += stride) {
+    for (size_t j = 0; j < 3; ++j) {
+      positions[i * 3 + j] = static_cast<float>(
+          LoadAsDouble(xyz[j]->type, data + xyz[j]->offset));
+    }
+  }
+}
+
+/**
+ * @brief DecodeTriplet Decodes three scalar properties of a binary element
+ * into packed float triplets, with a specialized kernel when they are
+ * consecutive values of a common layout.
+ */
+bool DecodeTriplet(const char *data, const PlyElement &element,
+                   const char *const names[3], float *values) {
+  const int kX = element.FindProperty(names[0]);
+  const int kY = element.FindProperty(names[1]);
+  const int kZ = element.FindProperty(names[2]);
+  if (kX < 0 || kY < 0 || kZ < 0 || element.stride == 0) return false;
+
+  const PlyProperty *xyz[3] = {&element.properties[kX],
+                               &element.properties[kY],
+                               &element.properties[kZ]};
+  const size_t kSize = PlyTypeSize(xyz[0]->type);
+  const bool kPacked = xyz[1]->type == xyz[0]->type &&
+                       xyz[2]->type == xyz[0]->type &&
+                       xyz[1]->offset == xyz[0]->offset + kSize &&
+                       xyz[2]->offset == xyz[1]->offset + kSize;
+
+  if (kPacked) {
+    for (const PositionLayout &layout : kPositionLayouts) {
+      if (layout.type == xyz[0]->type && layout.stride == element.stride) {
+        layout.kernel(data, element.count, xyz[0]->offset, values);
+        return true;
+      }
+    }
+  }
+
+  DecodeStridedPositions(data, element.count, element.stride, xyz, values);
+  return true;
+}
+
+/**
+ * @brief kFaceBlock Face records per task of the triangulation passes.
+ */
+const size_t kFaceBlock = 1 << 16;
+
+typedef void (*TriangleKernel)(const char *data, size_t count, int *faces);
+
+/**
+ * @brief DecodeTriangleRecords Kernel for face elements whose only property
+ * is the index list, stored with a Count length of 3 and Index entries.
+ */
+template <typename Count, typename Index>
+void DecodeTriangleRecords(const char *data, size_t count, int *faces) {
+  const size_t kStride = sizeof(Count) + 3 * sizeof(Index);
+  for (size_t i = 0; i < count; ++i, data += kStride) {
+    Index indices[3];
+    memcpy(indices, data + sizeof(Count), sizeof(indices));
+    faces[i * 3] = static_cast<int>(indices[0]);
+    faces[i * 3 + 1] = static_cast<int>(indices[1]);
+    faces[i * 3 + 2] = static_cast<int>(indices[2]);
+  }
+}
+
+template <typename Count>
+TriangleKernel SelectTriangleKernel(PlyType index_type) {
+  switch (index_type) {
+    case PlyType::kInt8: return &DecodeTriangleRecords<Count, int8_t>;
+    case PlyType::kUint8: return &DecodeTriangleRecords<Count, uint8_t>;
+    case PlyType::kInt16: return &DecodeTriangleRecords<Count, int16_t>;
+    case PlyType::kUint16: return &DecodeTriangleRecords<Count, uint16_t>;
+    case PlyType::kInt32: return &DecodeTriangleRecords<Count, int32_t>;
+    case PlyType::kUint32: return &DecodeTriangleRecords<Count, uint32_t>;
+    default: return nullptr;
+  }
+}
+
+TriangleKernel SelectTriangleKernel(PlyType count_type, PlyType index_type) {
+  switch (count_type) {
+    case PlyType::kInt8: return SelectTriangleKernel<int8_t>(index_type);
+    case PlyType::kUint8: return SelectTriangleKernel<uint8_t>(index_type);
+    case PlyType::kInt16: return SelectTriangleKernel<int16_t>(index_type);
+    case PlyType::kUint16: return SelectTriangleKernel<uint16_t>(index_type);
+    case PlyType::kInt32: return SelectTriangleKernel<int32_t>(index_type);
+    case PlyType::kUint32: return SelectTriangleKernel<uint32_t>(index_type);
+    default: return nullptr;
+  }
+}
+
+/**
+ * @brief AllTriangleRecords Whether every record of a face element made of a
+ * single list stores exactly three entries. Records are checked in parallel
+ * assuming triangle-sized strides, which is safe: the first record that is not
+ * a triangle is always read at its actual position.
+ */
+bool AllTriangleRecords(const char *data, size_t count, PlyType count_type,
+                        size_t stride) {
+  std::atomic<bool> triangles(true);
+  ParallelForRange(0, count, kFaceBlock, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (LoadAsInt(count_type, data + i * stride) != 3) {
+        triangles = false;
+        return;
+      }
+    }
+  });
+  return triangles;
+}
+
+/**
+ * @brief TriangulateRecords Walks the variable-size face records in [p, end)
+ * and writes a triangle fan for every polygon. Faces with less than three
+ * vertices produce no triangles.
+ */
+void TriangulateRecords(const char *p, const char *end,
+                        const PlyElement &element, size_t list, int *faces) {
+  const PlyProperty &kList = element.properties[list];
+  const size_t kCountSize = PlyTypeSize(kList.count_type);
+  const size_t kEntrySize = PlyTypeSize(kList.type);
+  while (p != nullptr && p < end) {
+    for (size_t k = 0; k < list && p != nullptr; ++k)
+      p = PropertyEnd(p, end, element.properties[k]);
+    if (p == nullptr) return;
+
+    const int64_t kEntries = LoadAsInt(kList.count_type, p);
+    p += kCountSize;
+    if (kEntries >= 3) {
+      const int kFirst = static_cast<int>(LoadAsInt(kList.type, p));
+      int previous = static_cast<int>(LoadAsInt(kList.type, p + kEntrySize));
+      for (int64_t j = 2; j < kEntries; ++j, faces += 3) {
+        const int kCurrent =
+            static_cast<int>(LoadAsInt(kList.type, p + j * kEntrySize));
+        faces[0] = kFirst;
+        faces[1] = previous;
+        faces[2] = kCurrent;
+        previous = kCurrent;
+      }
+    }
+    p += std::max<int64_t>(kEntries, 0) * kEntrySize;
+
+    for (size_t k = list + 1; k < element.properties.size() && p != nullptr;
+         ++k)
+      p = PropertyEnd(p, end, element.properties[k]);
+  }
+}
+
+}  // namespace
+
+size_t PlyTypeSize(PlyType type) {
+  switch (type) {
+    case PlyType::kInt8:
+    case PlyType::kUint8: return 1;
+    case PlyType::kInt16:
+    case PlyType::kUint16: return 2;
+    case PlyType::kInt32:
+    case PlyType::kUint32:
+    case PlyType::kFloat32: return 4;
+    case PlyType::kFloat64: return 8;
+    default: return 0;
+  }
+}
+
+int PlyElement::FindProperty(const std::string &property) const {
+  for (size_t i = 0; i < properties.size(); ++i)
+    if (properties[i].name == property) return static_cast<int>(i);
+  return -1;
+}
+
+int PlyHeader::FindElement(const std::string &element) const {
+  for (size_t i = 0; i < elements.size(); ++i)
+    if (elements[i].name == element) return static_cast<int>(i);
+  return -1;
+}
+
+bool ReadPlyHeader(const char *data, size_t size, PlyHeader *header) {
+  size_t pos = 0;
+  if (NextLine(data, size, &pos).compare(0, 3, "ply") != 0) return false;
+
+  header->elements.clear();
+  bool has_format = false;
+  std::string line = NextLine(data, size, &pos);
+  while (line.compare(0, 10, "end_header") != 0) {
+    if (pos >= size) return false;
+
+    std::istringstream tokens(line);
+    std::string keyword;
+    tokens >> keyword;
+    if (keyword == "format") {
+      std::string format;
+      tokens >> format;
+      has_format = true;
+      if (format == "ascii") {
+        header->format = PlyFormat::kAscii;
+      } else if (format == "binary_little_endian") {
+        header->format = PlyFormat::kBinaryLittleEndian;
+      } else if (format == "binary_big_endian") {
+        header->format = PlyFormat::kBinaryBigEndian;
+      } else {
+        return false;
+      }
+    } else if (keyword == "element") {
+      PlyElement element;
+      if (!(tokens >> element.name >> element.count)) return false;
+      element.stride = 0;
+      header->elements.push_back(element);
+    } else if (keyword == "property") {
+      if (header->elements.empty()) return false;
+
+      PlyProperty property;
+      std::string type;
+      tokens >> type;
+      property.count_type = PlyType::kInvalid;
+      if (type == "list") {
+        std::string count_type;
+        tokens >> count_type >> type;
+        property.count_type = ParsePlyType(count_type);
+        if (property.count_type == PlyType::kInvalid) return false;
+      }
+      property.type = ParsePlyType(type);
+      if (property.type == PlyType::kInvalid) return false;
+      if (!(tokens >> property.name)) return false;
+      property.offset = 0;
+      header->elements.back().properties.push_back(property);
+    }
+    line = NextLine(data, size, &pos);
+  }
+  header->header_size = pos;
+
+  for (PlyElement &element : header->elements) {
+    size_t offset = 0;
+    for (PlyProperty &property : element.properties) {
+      if (property.is_list()) {
+        offset = 0;
+        break;
+      }
+      property.offset = offset;
+      offset += PlyTypeSize(property.type);
+    }
+    element.stride = offset;
+  }
+
+  return has_format;
+}
+
+const char *SkipPlyElement(const char *data, const char *end,
+                           const PlyElement &element) {
+  if (element.stride > 0) {
+    if (static_cast<size_t>(end - data) / element.stride < element.count)
+      return nullptr;
+    return data + element.count * element.stride;
+  }
+
+  for (size_t i = 0; i < element.count && data != nullptr; ++i)
+    data = RecordEnd(data, end, element);
+  return data;
+}
+
+char *SwapPlyElement(char *data, const char *end, const PlyElement &element) {
+  std::vector<size_t> fields;
+  size_t stride = element.stride;
+  if (stride > 0) {
+    for (const PlyProperty &property : element.properties)
+      fields.push_back(PlyTypeSize(property.type));
+  } else if (element.properties.size() == 1) {
+    const PlyProperty &kList = element.properties[0];
+    const size_t kCountSize = PlyTypeSize(kList.count_type);
+    stride = kCountSize + 3 * PlyTypeSize(kList.type);
+    if (static_cast<size_t>(end - data) / stride >= element.count &&
+        AllBigEndianTriangles(data, element.count, kCountSize, stride)) {
+      fields.assign(4, PlyTypeSize(kList.type));
+      fields[0] = kCountSize;
+    }
+  }
+
+  if (!fields.empty()) {
+    if (static_cast<size_t>(end - data) / stride < element.count)
+      return nullptr;
+    SwapFixedRecords(data, element.count, fields, stride);
+    return data + element.count * stride;
+  }
+
+  // Variable-size records: every list length has to be swapped before it can
+  // be used to find the next value.
+  for (size_t i = 0; i < element.count; ++i) {
+    for (const PlyProperty &property : element.properties) {
+      const size_t kSize = PlyTypeSize(property.is_list() ? property.count_type
+                                                          : property.type);
+      if (static_cast<size_t>(end - data) < kSize) return nullptr;
+      ByteSwap(data, 1, kSize);
+      if (!property.is_list()) {
+        data += kSize;
+        continue;
+      }
+
+      const char *kNext = PropertyEnd(data, end, property);
+      if (kNext == nullptr) return nullptr;
+      const size_t kEntrySize = PlyTypeSize(property.type);
+      ByteSwap(data + kSize, (kNext - data - kSize) / kEntrySize, kEntrySize);
+      data += kNext - data;
+    }
+  }
+  return data;
+}
+
+bool DecodePlyPositions(const char *data, const PlyElement &element,
+                        float *positions) {
+  const char *kNames[3] = {"x", "y", "z"};
+  return DecodeTriplet(data, element, kNames, positions);
+}
+
+bool DecodePlyNormals(const char *data, const PlyElement &element,
+                      float *normals) {
+  const char *kNames[3] = {"nx", "ny", "nz"};
+  return DecodeTriplet(data, element, kNames, normals);
+}
+
+bool DecodePlyColors(const char *data, const PlyElement &element,
+                     unsigned char *colors) {
+  const int kRgb[3] = {element.FindProperty("red"),
+                       element.FindProperty("green"),
+                       element.FindProperty("blue")};
+  if (kRgb[0] < 0 || kRgb[1] < 0 || kRgb[2] < 0 || element.stride == 0)
+    return false;
+
+  const PlyProperty *rgb[3] = {&element.properties[kRgb[0]],
+                               &element.properties[kRgb[1]],
+                               &element.properties[kRgb[2]]};
+  ParallelForRange(0, element.count, 1 << 16, [&](size_t begin, size_t end) {
+    const char *record = data + begin * element.stride;
+    for (size_t i = begin; i < end; ++i, record += element.stride) {
+      for (size_t j = 0; j < 3; ++j) {
+        colors[i * 3 + j] = PlyColorComponent(
+            rgb[j]->type, LoadAsDouble(rgb[j]->type, record + rgb[j]->offset));
+      }
+    }
+  });
+  return true;
+}
+
+unsigned char PlyColorComponent(PlyType type, double value) {
+  if (type == PlyType::kFloat32 || type == PlyType::kFloat64) value *= 255.0;
+  return static_cast<unsigned char>(std::min(255.0, std::max(0.0, value)));
+}
+
+int FindPlyIndexList(const PlyElement &face) {
+  int list = face.FindProperty("vertex_indices");
+  if (list < 0) list = face.FindProperty("vertex_index");
+  if (list >= 0 && !face.properties[list].is_list()) list = -1;
+  return list;
+}
+
+const char *CountPlyTriangles(const char *data, const char *end,
+                              const PlyElement &element,
+                              PlyFaceBlocks *blocks) {
+  blocks->triangles = 0;
+  blocks->stride = 0;
+  blocks->offsets.clear();
+  blocks->first_triangles.clear();
+
+  const int kList = FindPlyIndexList(element);
+  if (kList < 0) return nullptr;
+
+  const PlyProperty &kIndices = element.properties[kList];
+  if (element.properties.size() == 1 &&
+      SelectTriangleKernel(kIndices.count_type, kIndices.type) != nullptr) {
+    const size_t kStride =
+        PlyTypeSize(kIndices.count_type) + 3 * PlyTypeSize(kIndices.type);
+    if (static_cast<size_t>(end - data) / kStride >= element.count &&
+        AllTriangleRecords(data, element.count, kIndices.count_type,
+                           kStride)) {
+      blocks->triangles = element.count;
+      blocks->stride = kStride;
+      return data + element.count * kStride;
+    }
+  }
+
+  // Polygons or extra properties: the records have to be walked one by one,
+  // remembering where every block starts so it can be filled in parallel.
+  const char *p = data;
+  for (size_t i = 0; i < element.count; ++i) {
+    if (i % kFaceBlock == 0) {
+      blocks->offsets.push_back(p - data);
+      blocks->first_triangles.push_back(blocks->triangles);
+    }
+
+    for (int k = 0; k < kList && p != nullptr; ++k)
+      p = PropertyEnd(p, end, element.properties[k]);
+    const char *kNext = p == nullptr ? nullptr : PropertyEnd(p, end, kIndices);
+    if (kNext == nullptr) return nullptr;
+
+    const int64_t kEntries = LoadAsInt(kIndices.count_type, p);
+    if (kEntries > 2) blocks->triangles += kEntries - 2;
+
+    p = kNext;
+    for (size_t k = kList + 1; k < element.properties.size() && p != nullptr;
+         ++k)
+      p = PropertyEnd(p, end, element.properties[k]);
+    if (p == nullptr) return nullptr;
+  }
+  blocks->offsets.push_back(p - data);
+  return p;
+}
+
+size_t PlyFaceBlockCount(const PlyElement &element,
+                         const PlyFaceBlocks &blocks) {
+  if (blocks.stride > 0) return (element.count + kFaceBlock - 1) / kFaceBlock;
+  return blocks.first_triangles.size();
+}
+
+bool DecodePlyFaceBlock(const char *data, const PlyElement &element,
+                        const PlyFaceBlocks &blocks, size_t block, int *faces,
+                        size_t *first_triangle, size_t *triangles) {
+  const int kList = FindPlyIndexList(element);
+  if (kList < 0) return false;
+
+  const PlyProperty &kIndices = element.properties[kList];
+  if (blocks.stride > 0) {
+    const TriangleKernel kKernel =
+        SelectTriangleKernel(kIndices.count_type, kIndices.type);
+    if (kKernel == nullptr) return false;
+    const size_t kBegin = block * kFaceBlock;
+    *first_triangle = kBegin;
+    *triangles = std::min(element.count, kBegin + kFaceBlock) - kBegin;
+    kKernel(data + kBegin * blocks.stride, *triangles, faces + kBegin * 3);
+    return true;
+  }
+
+  *first_triangle = blocks.first_triangles[block];
+  *triangles = (block + 1 < blocks.first_triangles.size()
+                    ? blocks.first_triangles[block + 1]
+                    : blocks.triangles) -
+               *first_triangle;
+  TriangulateRecords(data + blocks.offsets[block],
+                     data + blocks.offsets[block + 1], element, kList,
+                     faces + *first_triangle * 3);
+  return true;
+}
+
+bool DecodePlyTriangles(const char *data, const PlyElement &element,
+                        const PlyFaceBlocks &blocks, int *faces) {
+  if (FindPlyIndexList(element) < 0) return false;
+
+  std::atomic<bool> valid(true);
+  ParallelFor(PlyFaceBlockCount(element, blocks), [&](size_t block) {
+    size_t first_triangle, triangles;
+    if (!DecodePlyFaceBlock(data, element, blocks, block, faces,
+                            &first_triangle, &triangles))
+      valid = false;
+  });
+  return valid;
+}
+
+}  // namespace data_representation
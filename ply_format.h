@@ -0,0 +1,271 @@
+// Author: Marc Comino 2020
+
+#ifndef PLY_FORMAT_H_
+#define PLY_FORMAT_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief PlyFormat Encoding of the PLY payload, as given by the format line.
+ */
+enum class PlyFormat { kAscii, kBinaryLittleEndian, kBinaryBigEndian };
+
+/**
+ * @brief PlyType Scalar types a PLY property can be stored as.
+ */
+enum class PlyType {
+  kInvalid,
+  kInt8,
+  kUint8,
+  kInt16,
+  kUint16,
+  kInt32,
+  kUint32,
+  kFloat32,
+  kFloat64
+};
+
+/**
+ * @brief PlyTypeSize Size in bytes of a value of the given type.
+ */
+size_t PlyTypeSize(PlyType type);
+
+/**
+ * @brief PlyProperty A property of an element, either a scalar or a list.
+ */
+struct PlyProperty {
+  std::string name;
+
+  /**
+   * @brief type Type of the value, or of the list entries for lists.
+   */
+  PlyType type;
+
+  /**
+   * @brief count_type Type of the list length, kInvalid for scalars.
+   */
+  PlyType count_type;
+
+  /**
+   * @brief offset Byte offset inside the record. Only meaningful for scalar
+   * properties of fixed-size elements.
+   */
+  size_t offset;
+
+  bool is_list() const { return count_type != PlyType::kInvalid; }
+};
+
+/**
+ * @brief PlyElement An element declaration (vertex, face...) and its records.
+ */
+struct PlyElement {
+  std::string name;
+  size_t count;
+  std::vector<PlyProperty> properties;
+
+  /**
+   * @brief stride Size of a binary record in bytes, 0 if the element has list
+   * properties and thus variable-size records.
+   */
+  size_t stride;
+
+  /**
+   * @brief FindProperty Returns the index of the property with the given name
+   * or -1 if there is none.
+   */
+  int FindProperty(const std::string &name) const;
+};
+
+/**
+ * @brief PlyHeader The schema of a PLY file.
+ */
+struct PlyHeader {
+  PlyFormat format;
+  std::vector<PlyElement> elements;
+
+  /**
+   * @brief header_size Bytes up to and including the end_header line, i.e. the
+   * offset of the first element payload.
+   */
+  size_t header_size;
+
+  /**
+   * @brief FindElement Returns the index of the element with the given name or
+   * -1 if there is none.
+   */
+  int FindElement(const std::string &name) const;
+};
+
+/**
+ * @brief ReadPlyHeader Parses the header of a PLY file into its schema.
+ * @param data The file contents.
+ * @param size The file size in bytes.
+ * @param header The resulting schema.
+ * @return Whether the header is well formed.
+ */
+bool ReadPlyHeader(const char *data, size_t size, PlyHeader *header);
+
+/**
+ * @brief SkipPlyElement Finds the end of the binary payload of an element.
+ * @param data First byte of the element payload.
+ * @param end One past the last byte of the file.
+ * @param element The element schema.
+ * @return One past the last byte of the element, or nullptr if the file is
+ * truncated.
+ */
+const char *SkipPlyElement(const char *data, const char *end,
+                           const PlyElement &element);
+
+/**
+ * @brief SwapPlyElement Converts the binary payload of an element from big to
+ * little endian in place. Fixed-size records, and face lists made only of
+ * triangles, are swapped as whole blocks with vectorized shuffles; any other
+ * list element is swapped record by record.
+ * @param data First byte of the element payload.
+ * @param end One past the last byte of the file.
+ * @param element The element schema.
+ * @return One past the last byte of the element, or nullptr if the file is
+ * truncated.
+ */
+char *SwapPlyElement(char *data, const char *end, const PlyElement &element);
+
+/**
+ * @brief DecodePlyPositions Decodes the x, y, z properties of a binary vertex
+ * element into packed float triplets. Common layouts are handled by kernels
+ * specialized at compile time for their type and record size; any other
+ * fixed-size layout goes through a generic strided decoder.
+ * @param data First byte of the vertex payload.
+ * @param element The vertex element schema.
+ * @param positions Output array with room for 3 * element.count floats.
+ * @return Whether the element has decodable x, y, z properties.
+ */
+bool DecodePlyPositions(const char *data, const PlyElement &element,
+                        float *positions);
+
+/**
+ * @brief DecodePlyNormals Decodes the nx, ny, nz properties of a binary vertex
+ * element into packed float triplets, with the kernels of the positions.
+ * @param data First byte of the vertex payload.
+ * @param element The vertex element schema.
+ * @param normals Output array with room for 3 * element.count floats.
+ * @return Whether the element has decodable nx, ny, nz properties.
+ */
+bool DecodePlyNormals(const char *data, const PlyElement &element,
+                      float *normals);
+
+/**
+ * @brief DecodePlyColors Decodes the red, green, blue properties of a binary
+ * vertex element into packed 8-bit triplets.
+ * @param data First byte of the vertex payload.
+ * @param element The vertex element schema.
+ * @param colors Output array with room for 3 * element.count values.
+ * @return Whether the element has decodable red, green, blue properties.
+ */
+bool DecodePlyColors(const char *data, const PlyElement &element,
+                     unsigned char *colors);
+
+/**
+ * @brief PlyColorComponent Converts a color value stored with the given type
+ * to 8 bits. Floating point colors are expected in the [0, 1] range.
+ */
+unsigned char PlyColorComponent(PlyType type, double value);
+
+/**
+ * @brief PlyFaceBlocks Result of the counting pass over a binary face element,
+ * used to triangulate blocks of its records in parallel.
+ */
+struct PlyFaceBlocks {
+  /**
+   * @brief triangles Number of triangles once every face is triangulated.
+   */
+  size_t triangles;
+
+  /**
+   * @brief stride Size of every record when the element only stores triangle
+   * index lists, 0 if the records have to be walked.
+   */
+  size_t stride;
+
+  /**
+   * @brief offsets Byte offset of the first record of every block, relative to
+   * the element payload, followed by the size of the payload. Empty when
+   * stride is set.
+   */
+  std::vector<size_t> offsets;
+
+  /**
+   * @brief first_triangles Index of the first triangle of every block.
+   */
+  std::vector<size_t> first_triangles;
+};
+
+/**
+ * @brief FindPlyIndexList Returns the index of the vertex index list property
+ * of a face element, or -1 if there is none.
+ */
+int FindPlyIndexList(const PlyElement &face);
+
+/**
+ * @brief CountPlyTriangles Counting pass over a binary face element: computes
+ * the number of triangles it produces once polygons are fan triangulated.
+ * Elements that only store triangles are detected with a parallel scan;
+ * otherwise the records are walked once and every block start is recorded.
+ * @param data First byte of the face payload.
+ * @param end One past the last byte of the file.
+ * @param element The face element schema.
+ * @param blocks The triangle count and block layout of the element.
+ * @return One past the last byte of the element, or nullptr if the payload is
+ * truncated or has no index list.
+ */
+const char *CountPlyTriangles(const char *data, const char *end,
+                              const PlyElement &element,
+                              PlyFaceBlocks *blocks);
+
+/**
+ * @brief PlyFaceBlockCount Number of blocks DecodePlyFaceBlock splits a face
+ * element into.
+ * @param element The face element schema.
+ * @param blocks The result of CountPlyTriangles on its payload.
+ */
+size_t PlyFaceBlockCount(const PlyElement &element,
+                         const PlyFaceBlocks &blocks);
+
+/**
+ * @brief DecodePlyFaceBlock Fill pass over one block of a binary face element,
+ * so that a loader can process the triangles of a block while they are still
+ * in cache. Blocks are independent and can be decoded concurrently.
+ * @param data First byte of the face payload.
+ * @param element The face element schema.
+ * @param blocks The result of CountPlyTriangles on the same payload.
+ * @param block Index of the block, below PlyFaceBlockCount.
+ * @param faces Output array with room for 3 * blocks.triangles ints. The
+ * block writes its triangles at their final position.
+ * @param first_triangle Index of the first triangle of the block.
+ * @param triangles Number of triangles of the block.
+ * @return Whether the element has a decodable index list.
+ */
+bool DecodePlyFaceBlock(const char *data, const PlyElement &element,
+                        const PlyFaceBlocks &blocks, size_t block, int *faces,
+                        size_t *first_triangle, size_t *triangles);
+
+/**
+ * @brief DecodePlyTriangles Fill pass over a binary face element: decodes the
+ * vertex index lists into packed int triplets, decoding the blocks of
+ * DecodePlyFaceBlock in parallel. Polygons are split into triangle fans and
+ * faces with less than three vertices are dropped.
+ * @param data First byte of the face payload.
+ * @param element The face element schema.
+ * @param blocks The result of CountPlyTriangles on the same payload.
+ * @param faces Output array with room for 3 * blocks.triangles ints.
+ * @return Whether the element has a decodable index list.
+ */
+bool DecodePlyTriangles(const char *data, const PlyElement &element,
+                        const PlyFaceBlocks &blocks, int *faces);
+
+}  // namespace data_representation
+
+#endif  // PLY_FORMAT_H_
@@ -0,0 +1,314 @@
+// Author: Marc Comino 2020
+
+#include <ply_stream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "./geometry_kernels.h"
+#include "./mapped_file.h"
+#include "./mesh_processing.h"
+#include "./parallel.h"
+#include "./ply_format.h"
+#include "./vertex_buffer.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief FaceWindows Splits the face payload into windows of about
+ * window_bytes. Each window is described by a PlyFaceBlocks relative to its
+ * own first record, so DecodePlyTriangles can fill it on its own.
+ */
+class FaceWindows {
+ public:
+  FaceWindows(const char *data, const PlyElement &element,
+              const PlyFaceBlocks &blocks, size_t window_bytes)
+      : data_(data), element_(element), blocks_(blocks), next_(0) {
+    // Records, or blocks of records when they have to be walked.
+    const size_t kBlocks = std::max<size_t>(1, blocks.first_triangles.size());
+    const size_t kUnitBytes =
+        blocks.stride > 0
+            ? blocks.stride
+            : std::max<size_t>(1, blocks.offsets.back() / kBlocks);
+    per_window_ = std::max<size_t>(1, window_bytes / kUnitBytes);
+  }
+
+  /**
+   * @brief Next Describes the next window.
+   * @return Whether there was one left.
+   */
+  bool Next(const char **data, size_t *size, PlyElement *element,
+            PlyFaceBlocks *blocks, size_t *first_triangle) {
+    *element = element_;
+    blocks->stride = blocks_.stride;
+    blocks->offsets.clear();
+    blocks->first_triangles.clear();
+
+    if (blocks_.stride > 0) {
+      if (next_ >= element_.count) return false;
+      element->count = std::min(per_window_, element_.count - next_);
+      blocks->triangles = element->count;
+      *data = data_ + next_ * blocks_.stride;
+      *size = element->count * blocks_.stride;
+      *first_triangle = next_;
+      next_ += element->count;
+      return true;
+    }
+
+    // Records can only be found at block starts, so windows are made of
+    // whole blocks.
+    const size_t kBlocks = blocks_.first_triangles.size();
+    if (next_ >= kBlocks) return false;
+    const size_t kFirst = next_;
+    next_ = std::min(kBlocks, kFirst + per_window_);
+
+    const size_t kBase = blocks_.offsets[kFirst];
+    const size_t kFirstTriangle = blocks_.first_triangles[kFirst];
+    for (size_t block = kFirst; block < next_; ++block) {
+      blocks->offsets.push_back(blocks_.offsets[block] - kBase);
+      blocks->first_triangles.push_back(blocks_.first_triangles[block] -
+                                        kFirstTriangle);
+    }
+    blocks->offsets.push_back(blocks_.offsets[next_] - kBase);
+    blocks->triangles =
+        (next_ < kBlocks ? blocks_.first_triangles[next_] : blocks_.triangles) -
+        kFirstTriangle;
+    *data = data_ + kBase;
+    *size = blocks_.offsets[next_] - kBase;
+    *first_triangle = kFirstTriangle;
+    return true;
+  }
+
+ private:
+  const char *data_;
+  const PlyElement &element_;
+  const PlyFaceBlocks &blocks_;
+  size_t per_window_;
+  size_t next_;
+};
+
+/**
+ * @brief AccumulateNormals Adds the angle weighted normals of a window of
+ * triangles to sums. The face terms are computed in parallel and added in
+ * face order, so the sums are those of ComputeVertexNormals.
+ */
+void AccumulateNormals(const float *positions, const std::vector<int> &faces,
+                       size_t triangles, FaceTerms *terms, float *sums) {
+  ComputeFaceTerms(positions, faces.data(), triangles, terms);
+  for (size_t i = 0; i < triangles * 3; ++i) {
+    const size_t kFace = i / 3;
+    const float kAngle = terms->angle[i % 3][kFace];
+    float *sum = sums + faces[i] * size_t(3);
+    for (int k = 0; k < 3; ++k) sum[k] += terms->normal[k][kFace] * kAngle;
+  }
+}
+
+}  // namespace
+
+bool StreamFromPly(const std::string &filename, size_t window_bytes,
+                   NormalPolicy policy, PlyStreamSink *sink,
+                   PlyStreamInfo *info) {
+  const auto kStart = std::chrono::steady_clock::now();
+
+  MappedFile file;
+  PlyHeader header;
+  if (!file.Open(filename) ||
+      !ReadPlyHeader(file.data(), file.size(), &header) ||
+      header.format != PlyFormat::kBinaryLittleEndian)
+    return false;
+
+  const int kVertexElement = header.FindElement("vertex");
+  const int kFaceElement = header.FindElement("face");
+  if (kVertexElement < 0 || kFaceElement < 0) return false;
+  const PlyElement &kVertices = header.elements[kVertexElement];
+  const PlyElement &kFaces = header.elements[kFaceElement];
+  if (kVertices.stride == 0 || kVertices.count == 0) return false;
+
+  // Locate both payloads, counting the triangles on the way.
+  const char *kEnd = file.data() + file.size();
+  const char *p = file.data() + header.header_size;
+  const char *vertex_data = nullptr;
+  const char *face_data = nullptr;
+  const char *face_end = nullptr;
+  PlyFaceBlocks blocks;
+  for (size_t i = 0; i < header.elements.size() && p != nullptr; ++i) {
+    const int kElement = static_cast<int>(i);
+    if (kElement == kVertexElement) vertex_data = p;
+    if (kElement == kFaceElement) {
+      face_data = p;
+      p = face_end = CountPlyTriangles(p, kEnd, kFaces, &blocks);
+    } else {
+      p = SkipPlyElement(p, kEnd, header.elements[i]);
+    }
+  }
+  const size_t kVertexCount = kVertices.count;
+  const size_t kTriangles = blocks.triangles;
+  if (p == nullptr || kTriangles == 0 ||
+      kVertexCount > static_cast<size_t>(std::numeric_limits<int>::max()) ||
+      kTriangles * 3 > static_cast<size_t>(std::numeric_limits<int>::max()))
+    return false;
+  file.Release(face_data - file.data(), face_end - face_data);
+
+  // Normals that are not computed are known with the positions, so the
+  // vertices can be emitted in the first pass and nothing needs scratch space.
+  const bool kFileNormals = policy != NormalPolicy::kAlways &&
+                            kVertices.FindProperty("nx") >= 0 &&
+                            kVertices.FindProperty("ny") >= 0 &&
+                            kVertices.FindProperty("nz") >= 0;
+  const bool kComputeNormals =
+      !kFileNormals && policy != NormalPolicy::kNever;
+
+  std::cout << "Streaming triangle mesh" << std::endl;
+  std::cout << "\tVertices = " << kVertexCount << std::endl;
+  std::cout << "\tFaces = " << kTriangles << std::endl;
+  if (!sink->Begin(VertexBufferSize(kInterleavedLayout, kVertexCount),
+                   kTriangles * 3 * sizeof(int)))
+    return false;
+
+  // Positions, decoded window by window into scratch space, or straight
+  // into interleaved windows when the normals are not computed.
+  MappedFile positions_file;
+  float *positions = nullptr;
+  if (kComputeNormals) {
+    if (!positions_file.CreateTemporary(kVertexCount * 3 * sizeof(float)))
+      return false;
+    positions = reinterpret_cast<float *>(positions_file.mutable_data());
+  }
+  info->min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+  info->max = -info->min;
+
+  const size_t kVertexWindow =
+      std::max<size_t>(1, window_bytes / kVertices.stride);
+  std::vector<float> window_positions, window_normals, buffer;
+  for (size_t first = 0; first < kVertexCount; first += kVertexWindow) {
+    PlyElement window = kVertices;
+    window.count = std::min(kVertexWindow, kVertexCount - first);
+    const char *kData = vertex_data + first * kVertices.stride;
+    float *decoded = positions + first * 3;
+    if (!kComputeNormals) {
+      window_positions.resize(window.count * 3);
+      decoded = window_positions.data();
+    }
+    if (!DecodePlyPositions(kData, window, decoded)) return false;
+    ExtendBounds(decoded, window.count, info->min.data(), info->max.data());
+
+    if (!kComputeNormals) {
+      window_normals.assign(window.count * 3, 0.0f);
+      if (kFileNormals &&
+          !DecodePlyNormals(kData, window, window_normals.data()))
+        return false;
+      buffer.resize(window.count * kInterleavedFloats);
+      ParallelForRange(0, window.count, 1 << 16, [&](size_t begin,
+                                                     size_t end) {
+        InterleaveVertices(window_positions.data(), window_normals.data(),
+                           begin, end,
+                           buffer.data() + begin * kInterleavedFloats);
+      });
+      if (!sink->Vertices(first * kInterleavedFloats * sizeof(float),
+                          buffer.data(), buffer.size()))
+        return false;
+    }
+    file.Release(kData - file.data(), window.count * kVertices.stride);
+  }
+  std::vector<float>().swap(window_positions);
+  std::vector<float>().swap(window_normals);
+  std::cout << (kComputeNormals ? "\tDecoded positions "
+                                : "\tStreamed vertices ")
+            << std::endl;
+
+  // Faces: every window is uploaded and its normals accumulated if needed.
+  MappedFile sums_file;
+  float *sums = nullptr;
+  if (kComputeNormals) {
+    if (!sums_file.CreateTemporary(kVertexCount * 3 * sizeof(float)))
+      return false;
+    sums = reinterpret_cast<float *>(sums_file.mutable_data());
+  }
+
+  FaceWindows windows(face_data, kFaces, blocks, window_bytes);
+  const char *window_data;
+  size_t window_size, first_triangle;
+  PlyElement window_element;
+  PlyFaceBlocks window_blocks;
+  std::vector<int> faces;
+  FaceTerms terms;
+  while (windows.Next(&window_data, &window_size, &window_element,
+                      &window_blocks, &first_triangle)) {
+    const size_t kWindowTriangles = window_blocks.triangles;
+    faces.resize(kWindowTriangles * 3);
+    if (!DecodePlyTriangles(window_data, window_element, window_blocks,
+                            faces.data()))
+      return false;
+
+    std::atomic<bool> valid(true);
+    const int kMaxIndex = static_cast<int>(kVertexCount);
+    ParallelForRange(0, faces.size(), 1 << 16, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        if (faces[i] < 0 || faces[i] >= kMaxIndex) {
+          valid = false;
+          return;
+        }
+      }
+    });
+    if (!valid) {
+      std::cout << "\tError: face index out of range " << std::endl;
+      return false;
+    }
+
+    if (!sink->Indices(first_triangle * 3 * sizeof(int), faces.data(),
+                       faces.size()))
+      return false;
+    if (kComputeNormals)
+      AccumulateNormals(positions, faces, kWindowTriangles, &terms, sums);
+    file.Release(window_data - file.data(), window_size);
+  }
+  std::vector<int>().swap(faces);
+  file.Close();
+  std::cout << "\tStreamed faces " << std::endl;
+
+  // Vertices: normalize the sums and interleave them with the positions.
+  const size_t kInterleavedWindow =
+      std::max<size_t>(1, window_bytes / (kInterleavedFloats * sizeof(float)));
+  for (size_t first = 0; kComputeNormals && first < kVertexCount;
+       first += kInterleavedWindow) {
+    const size_t kCount = std::min(kInterleavedWindow, kVertexCount - first);
+    buffer.resize(kCount * kInterleavedFloats);
+    ParallelForRange(first, first + kCount, 1 << 16, [&](size_t begin,
+                                                          size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        float *sum = sums + i * 3;
+        const float kLength =
+            std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+        const float kScale = kLength > 0.0f ? 1.0f / kLength : 0.0f;
+        for (int j = 0; j < 3; ++j) sum[j] *= kScale;
+      }
+      InterleaveVertices(positions, sums, begin, end,
+                         buffer.data() + (begin - first) * kInterleavedFloats);
+    });
+    if (!sink->Vertices(first * kInterleavedFloats * sizeof(float),
+                        buffer.data(), buffer.size()))
+      return false;
+    positions_file.Release(first * 3 * sizeof(float),
+                           kCount * 3 * sizeof(float));
+    sums_file.Release(first * 3 * sizeof(float), kCount * 3 * sizeof(float));
+  }
+  if (kComputeNormals) std::cout << "\tStreamed vertices " << std::endl;
+
+  info->vertex_count = kVertexCount;
+  info->triangle_count = kTriangles;
+  const double kSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - kStart)
+                              .count();
+  std::cout << "\tStreamed PLY in " << kSeconds * 1000.0 << " ms" << std::endl;
+  return true;
+}
+
+}  // namespace data_representation
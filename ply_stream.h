@@ -0,0 +1,79 @@
+// Author: Marc Comino 2020
+
+#ifndef PLY_STREAM_H_
+#define PLY_STREAM_H_
+
+#include <eigen3/Eigen/Geometry>
+
+#include <cstddef>
+#include <string>
+
+#include "./mesh_processing.h"
+
+namespace data_representation {
+
+/**
+ * @brief PlyStreamSink Receives the buffers of a streamed model piece by piece.
+ * Every method may return false to cancel the stream.
+ */
+class PlyStreamSink {
+ public:
+  virtual ~PlyStreamSink() {}
+
+  /**
+   * @brief Begin Called once, before any data, with the size in bytes of the
+   * interleaved position and normal buffer and of the index buffer.
+   */
+  virtual bool Begin(size_t vertex_bytes, size_t index_bytes) = 0;
+
+  /**
+   * @brief Indices A window of triangle indices that goes offset bytes into
+   * the index buffer.
+   */
+  virtual bool Indices(size_t offset, const int *indices, size_t count) = 0;
+
+  /**
+   * @brief Vertices A window of interleaved position and normal floats that
+   * goes offset bytes into the vertex buffer. When normals are computed,
+   * vertices come after all the indices, once normals are known; otherwise
+   * they come before the indices.
+   */
+  virtual bool Vertices(size_t offset, const float *vertices,
+                        size_t floats) = 0;
+};
+
+/**
+ * @brief PlyStreamInfo Summary of a streamed model.
+ */
+struct PlyStreamInfo {
+  size_t vertex_count;
+  size_t triangle_count;
+  Eigen::Vector3f min;
+  Eigen::Vector3f max;
+};
+
+/**
+ * @brief StreamFromPly Reads a binary little endian PLY file in windows of
+ * about window_bytes and hands the GPU buffers to sink without ever holding
+ * the whole mesh in memory. Positions and normal sums live in unlinked
+ * scratch files, and file pages are released once consumed. Faces are
+ * streamed first, accumulating the same angle weighted normals as
+ * ComputeVertexNormals; a second pass over the vertices normalizes them and
+ * emits the interleaved buffer. Normals read from the file, or zero normals
+ * when they are never computed, are interleaved with the positions as they
+ * are decoded, and the faces are streamed afterwards.
+ * @param filename The path to the PLY mesh.
+ * @param window_bytes Approximate size of every window.
+ * @param policy When normals are computed.
+ * @param sink Receiver of the buffers.
+ * @param info Counts and bounding box of the model.
+ * @return Whether the whole model was streamed. ASCII and big endian files
+ * are not supported.
+ */
+bool StreamFromPly(const std::string &filename, size_t window_bytes,
+                   NormalPolicy policy, PlyStreamSink *sink,
+                   PlyStreamInfo *info);
+
+}  // namespace data_representation
+
+#endif  // PLY_STREAM_H_
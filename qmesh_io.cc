@@ -0,0 +1,585 @@
+// Author: Marc Comino 2020
+
+#include <qmesh_io.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define QMESH_X86
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define QMESH_NEON
+#endif
+
+#include "./mapped_file.h"
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+const char kQmeshMagic[8] = "FRRQMSH";
+const uint32_t kQmeshVersion = 1;
+
+/**
+ * @brief kBlockTriangles Triangles per index block. Blocks are coded
+ * independently, so they are decoded in parallel.
+ */
+const uint32_t kBlockTriangles = 4096;
+
+/**
+ * @brief kVertexBlock Vertices per task of the vertex passes.
+ */
+const size_t kVertexBlock = 1 << 14;
+
+const size_t kSectionAlignment = 16;
+
+/**
+ * @brief kVertexStreams Quantized x, y and z, and the two octahedral normal
+ * coordinates, each stored as its own array of uint16_t.
+ */
+const int kVertexStreams = 5;
+
+const float kPositionScale = 65535.0f;
+
+/**
+ * @brief kNormalScale Octahedral coordinates in [-1, 1] are stored as
+ * round(c * kNormalScale) + kNormalScale, so 0 and +-1 are exact.
+ */
+const float kNormalScale = 32767.0f;
+
+/**
+ * @brief QmeshHeader Fixed-size header at the start of a .qmesh file. All the
+ * sections are little endian and start at 16-byte aligned offsets.
+ */
+struct QmeshHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t block_triangles;
+  uint64_t vertex_count;
+  uint64_t index_count;
+  float min[3];
+  float max[3];
+
+  /**
+   * @brief vertex_offset Start of the kVertexStreams arrays of vertex_count
+   * values, stream_stride bytes apart.
+   */
+  uint64_t vertex_offset;
+  uint64_t stream_stride;
+
+  /**
+   * @brief table_offset Start of the block table: one offset into the index
+   * data per block, plus its size.
+   */
+  uint64_t table_offset;
+  uint64_t index_offset;
+  uint64_t index_size;
+};
+
+static_assert(sizeof(QmeshHeader) == 96, "QmeshHeader must not be padded");
+
+size_t AlignSection(size_t offset) {
+  return (offset + kSectionAlignment - 1) / kSectionAlignment *
+         kSectionAlignment;
+}
+
+void WritePadding(std::ofstream *fout, size_t from, size_t to) {
+  static const char kZeros[kSectionAlignment] = {};
+  fout->write(kZeros, static_cast<std::streamsize>(to - from));
+}
+
+size_t BlockCount(uint64_t index_count, uint32_t block_triangles) {
+  const uint64_t kTriangles = index_count / 3;
+  return static_cast<size_t>((kTriangles + block_triangles - 1) /
+                             block_triangles);
+}
+
+/**
+ * @brief IsWellFormed Checks the header against the size of the file so a
+ * truncated or foreign file is never read out of bounds.
+ */
+bool IsWellFormed(const QmeshHeader &header, size_t size) {
+  if (memcmp(header.magic, kQmeshMagic, sizeof(kQmeshMagic)) != 0)
+    return false;
+  if (header.version != kQmeshVersion || header.block_triangles == 0)
+    return false;
+
+  const uint64_t kMaxCount = std::numeric_limits<int>::max();
+  if (header.vertex_count == 0 || header.vertex_count > kMaxCount ||
+      header.index_count == 0 || header.index_count > kMaxCount ||
+      header.index_count % 3 != 0)
+    return false;
+  for (int i = 0; i < 3; ++i) {
+    if (!std::isfinite(header.min[i]) || !std::isfinite(header.max[i]) ||
+        header.min[i] > header.max[i])
+      return false;
+  }
+
+  if (header.vertex_offset % kSectionAlignment != 0 ||
+      header.stream_stride % kSectionAlignment != 0 ||
+      header.table_offset % kSectionAlignment != 0)
+    return false;
+  if (header.vertex_offset < sizeof(QmeshHeader) ||
+      header.vertex_offset > size ||
+      header.stream_stride < header.vertex_count * sizeof(uint16_t) ||
+      header.stream_stride > (size - header.vertex_offset) / kVertexStreams)
+    return false;
+
+  const uint64_t kTableEntries =
+      BlockCount(header.index_count, header.block_triangles) + 1;
+  return header.table_offset <= size &&
+         kTableEntries <= (size - header.table_offset) / sizeof(uint64_t) &&
+         header.index_offset <= size &&
+         header.index_size <= size - header.index_offset;
+}
+
+uint16_t QuantizeNormalCoordinate(float value) {
+  const float kClamped = std::min(1.0f, std::max(-1.0f, value));
+  return static_cast<uint16_t>(std::round(kClamped * kNormalScale) +
+                               kNormalScale);
+}
+
+/**
+ * @brief EncodeNormal Projects the normal onto the octahedron and unfolds the
+ * lower half onto the corners of the square. Zero normals are stored as +Z.
+ */
+void EncodeNormal(const float *normal, uint16_t *u, uint16_t *v) {
+  const float kL1 =
+      std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+  float x = 0.0f, y = 0.0f;
+  if (kL1 > 0.0f) {
+    x = normal[0] / kL1;
+    y = normal[1] / kL1;
+    if (normal[2] < 0.0f) {
+      const float kX = x;
+      x = (1.0f - std::fabs(y)) * std::copysign(1.0f, kX);
+      y = (1.0f - std::fabs(kX)) * std::copysign(1.0f, y);
+    }
+  }
+  *u = QuantizeNormalCoordinate(x);
+  *v = QuantizeNormalCoordinate(y);
+}
+
+/**
+ * @brief EncodeBlock Appends the zigzag coded deltas between consecutive
+ * indices as LEB128 varints. The first delta is taken from zero.
+ * @return False if an index is out of range.
+ */
+bool EncodeBlock(const int *indices, size_t count, int vertex_count,
+                 std::vector<uint8_t> *out) {
+  int previous = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (indices[i] < 0 || indices[i] >= vertex_count) return false;
+    const int32_t kDelta = indices[i] - previous;
+    uint32_t zigzag = (static_cast<uint32_t>(kDelta) << 1) ^
+                      static_cast<uint32_t>(kDelta >> 31);
+    while (zigzag >= 0x80) {
+      out->push_back(static_cast<uint8_t>(zigzag | 0x80));
+      zigzag >>= 7;
+    }
+    out->push_back(static_cast<uint8_t>(zigzag));
+    previous = indices[i];
+  }
+  return true;
+}
+
+/**
+ * @brief DecodeBlock Inverse of EncodeBlock.
+ * @return False if the block is malformed, does not end at end or references
+ * a vertex out of range.
+ */
+bool DecodeBlock(const uint8_t *p, const uint8_t *end, size_t count,
+                 uint32_t vertex_count, int *indices) {
+  uint32_t previous = 0;
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t zigzag = 0;
+    for (int shift = 0;; shift += 7) {
+      if (p == end || shift > 28) return false;
+      const uint8_t kByte = *p++;
+      zigzag |= static_cast<uint32_t>(kByte & 0x7f) << shift;
+      if (kByte < 0x80) break;
+    }
+    previous += (zigzag >> 1) ^ (0u - (zigzag & 1));
+    if (previous >= vertex_count) return false;
+    indices[i] = static_cast<int>(previous);
+  }
+  return p == end;
+}
+
+/**
+ * @brief VertexStreams The quantized arrays of a file and the constants that
+ * map them back to floats.
+ */
+struct VertexStreams {
+  const uint16_t *values[kVertexStreams];
+  float min[3];
+  float scale[3];
+};
+
+/**
+ * @brief DecodeVertex Scalar decoder of one vertex into its interleaved
+ * position and normal record.
+ */
+void DecodeVertex(const VertexStreams &streams, size_t i, float *record) {
+  for (int j = 0; j < 3; ++j)
+    record[j] =
+        streams.min[j] + static_cast<float>(streams.values[j][i]) *
+                             streams.scale[j];
+
+  float x = (static_cast<float>(streams.values[3][i]) - kNormalScale) /
+            kNormalScale;
+  float y = (static_cast<float>(streams.values[4][i]) - kNormalScale) /
+            kNormalScale;
+  x = std::min(1.0f, std::max(-1.0f, x));
+  y = std::min(1.0f, std::max(-1.0f, y));
+  const float kZ = 1.0f - std::fabs(x) - std::fabs(y);
+  if (kZ < 0.0f) {
+    const float kX = x;
+    x = (1.0f - std::fabs(y)) * std::copysign(1.0f, kX);
+    y = (1.0f - std::fabs(kX)) * std::copysign(1.0f, y);
+  }
+  const float kLength = std::sqrt(x * x + y * y + kZ * kZ);
+  record[3] = x / kLength;
+  record[4] = y / kLength;
+  record[5] = kZ / kLength;
+}
+
+#if defined(QMESH_X86)
+
+bool DetectSse2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse2");
+}
+
+const bool kHasSse2 = DetectSse2();
+
+/**
+ * @brief DecodeVerticesSse2 Decodes four vertices per iteration and
+ * transposes them into six-float records: the first four floats of every
+ * record are one row of the 4x4 transpose, the last two a half of an unpacked
+ * pair of normal components.
+ * @return The first vertex not decoded.
+ */
+__attribute__((target("sse2"))) size_t DecodeVerticesSse2(
+    const VertexStreams &streams, size_t begin, size_t end, float *buffer) {
+  const __m128i kZero = _mm_setzero_si128();
+  const __m128 kSign = _mm_set1_ps(-0.0f);
+  const __m128 kOne = _mm_set1_ps(1.0f);
+  const __m128 kMinusOne = _mm_set1_ps(-1.0f);
+  const __m128 kNormal = _mm_set1_ps(kNormalScale);
+  __m128 min[3], scale[3];
+  for (int j = 0; j < 3; ++j) {
+    min[j] = _mm_set1_ps(streams.min[j]);
+    scale[j] = _mm_set1_ps(streams.scale[j]);
+  }
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 values[kVertexStreams];
+    for (int j = 0; j < kVertexStreams; ++j) {
+      const __m128i kPacked = _mm_loadl_epi64(
+          reinterpret_cast<const __m128i *>(streams.values[j] + i));
+      values[j] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(kPacked, kZero));
+    }
+    __m128 position[3];
+    for (int j = 0; j < 3; ++j)
+      position[j] = _mm_add_ps(min[j], _mm_mul_ps(values[j], scale[j]));
+
+    __m128 x = _mm_div_ps(_mm_sub_ps(values[3], kNormal), kNormal);
+    __m128 y = _mm_div_ps(_mm_sub_ps(values[4], kNormal), kNormal);
+    x = _mm_min_ps(kOne, _mm_max_ps(kMinusOne, x));
+    y = _mm_min_ps(kOne, _mm_max_ps(kMinusOne, y));
+    const __m128 kAbsX = _mm_andnot_ps(kSign, x);
+    const __m128 kAbsY = _mm_andnot_ps(kSign, y);
+    const __m128 kZ = _mm_sub_ps(_mm_sub_ps(kOne, kAbsX), kAbsY);
+    const __m128 kFoldedX = _mm_mul_ps(_mm_sub_ps(kOne, kAbsY),
+                                       _mm_or_ps(_mm_and_ps(x, kSign), kOne));
+    const __m128 kFoldedY = _mm_mul_ps(_mm_sub_ps(kOne, kAbsX),
+                                       _mm_or_ps(_mm_and_ps(y, kSign), kOne));
+    const __m128 kFold = _mm_cmplt_ps(kZ, _mm_setzero_ps());
+    x = _mm_or_ps(_mm_and_ps(kFold, kFoldedX), _mm_andnot_ps(kFold, x));
+    y = _mm_or_ps(_mm_and_ps(kFold, kFoldedY), _mm_andnot_ps(kFold, y));
+    const __m128 kLength = _mm_sqrt_ps(_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(kZ, kZ)));
+    const __m128 kNormalX = _mm_div_ps(x, kLength);
+    const __m128 kNormalY = _mm_div_ps(y, kLength);
+    const __m128 kNormalZ = _mm_div_ps(kZ, kLength);
+
+    const __m128 kXY01 = _mm_unpacklo_ps(position[0], position[1]);
+    const __m128 kXY23 = _mm_unpackhi_ps(position[0], position[1]);
+    const __m128 kZN01 = _mm_unpacklo_ps(position[2], kNormalX);
+    const __m128 kZN23 = _mm_unpackhi_ps(position[2], kNormalX);
+    const __m128 kYZ01 = _mm_unpacklo_ps(kNormalY, kNormalZ);
+    const __m128 kYZ23 = _mm_unpackhi_ps(kNormalY, kNormalZ);
+
+    float *record = buffer + i * 6;
+    _mm_storeu_ps(record, _mm_movelh_ps(kXY01, kZN01));
+    _mm_storel_pi(reinterpret_cast<__m64 *>(record + 4), kYZ01);
+    _mm_storeu_ps(record + 6, _mm_movehl_ps(kZN01, kXY01));
+    _mm_storeh_pi(reinterpret_cast<__m64 *>(record + 10), kYZ01);
+    _mm_storeu_ps(record + 12, _mm_movelh_ps(kXY23, kZN23));
+    _mm_storel_pi(reinterpret_cast<__m64 *>(record + 16), kYZ23);
+    _mm_storeu_ps(record + 18, _mm_movehl_ps(kZN23, kXY23));
+    _mm_storeh_pi(reinterpret_cast<__m64 *>(record + 22), kYZ23);
+  }
+  return i;
+}
+
+#elif defined(QMESH_NEON)
+
+/**
+ * @brief DecodeVerticesNeon Same as the SSE2 decoder, with the records
+ * assembled from zipped pairs.
+ * @return The first vertex not decoded.
+ */
+size_t DecodeVerticesNeon(const VertexStreams &streams, size_t begin,
+                          size_t end, float *buffer) {
+  const float32x4_t kZero = vdupq_n_f32(0.0f);
+  const float32x4_t kOne = vdupq_n_f32(1.0f);
+  const float32x4_t kMinusOne = vdupq_n_f32(-1.0f);
+  const float32x4_t kNormal = vdupq_n_f32(kNormalScale);
+  const uint32x4_t kSign = vdupq_n_u32(0x80000000u);
+  float32x4_t min[3], scale[3];
+  for (int j = 0; j < 3; ++j) {
+    min[j] = vdupq_n_f32(streams.min[j]);
+    scale[j] = vdupq_n_f32(streams.scale[j]);
+  }
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    float32x4_t values[kVertexStreams];
+    for (int j = 0; j < kVertexStreams; ++j)
+      values[j] = vcvtq_f32_u32(vmovl_u16(vld1_u16(streams.values[j] + i)));
+    float32x4_t position[3];
+    for (int j = 0; j < 3; ++j)
+      position[j] = vaddq_f32(min[j], vmulq_f32(values[j], scale[j]));
+
+    float32x4_t x = vdivq_f32(vsubq_f32(values[3], kNormal), kNormal);
+    float32x4_t y = vdivq_f32(vsubq_f32(values[4], kNormal), kNormal);
+    x = vminq_f32(kOne, vmaxq_f32(kMinusOne, x));
+    y = vminq_f32(kOne, vmaxq_f32(kMinusOne, y));
+    const float32x4_t kAbsX = vabsq_f32(x);
+    const float32x4_t kAbsY = vabsq_f32(y);
+    const float32x4_t kZ = vsubq_f32(vsubq_f32(kOne, kAbsX), kAbsY);
+    const float32x4_t kSignX = vreinterpretq_f32_u32(
+        vorrq_u32(vandq_u32(vreinterpretq_u32_f32(x), kSign),
+                  vreinterpretq_u32_f32(kOne)));
+    const float32x4_t kSignY = vreinterpretq_f32_u32(
+        vorrq_u32(vandq_u32(vreinterpretq_u32_f32(y), kSign),
+                  vreinterpretq_u32_f32(kOne)));
+    const uint32x4_t kFold = vcltq_f32(kZ, kZero);
+    x = vbslq_f32(kFold, vmulq_f32(vsubq_f32(kOne, kAbsY), kSignX), x);
+    y = vbslq_f32(kFold, vmulq_f32(vsubq_f32(kOne, kAbsX), kSignY), y);
+    const float32x4_t kLength = vsqrtq_f32(vaddq_f32(
+        vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y)), vmulq_f32(kZ, kZ)));
+
+    const float32x4x2_t kXY = vzipq_f32(position[0], position[1]);
+    const float32x4x2_t kZN = vzipq_f32(position[2], vdivq_f32(x, kLength));
+    const float32x4x2_t kYZ =
+        vzipq_f32(vdivq_f32(y, kLength), vdivq_f32(kZ, kLength));
+
+    float *record = buffer + i * 6;
+    for (int half = 0; half < 2; ++half, record += 12) {
+      vst1q_f32(record, vcombine_f32(vget_low_f32(kXY.val[half]),
+                                     vget_low_f32(kZN.val[half])));
+      vst1_f32(record + 4, vget_low_f32(kYZ.val[half]));
+      vst1q_f32(record + 6, vcombine_f32(vget_high_f32(kXY.val[half]),
+                                         vget_high_f32(kZN.val[half])));
+      vst1_f32(record + 10, vget_high_f32(kYZ.val[half]));
+    }
+  }
+  return i;
+}
+
+#endif  // QMESH_NEON
+
+/**
+ * @brief DecodeVertices Decodes the vertices in [begin, end) into their
+ * records of buffer, with the widest available instruction set and a scalar
+ * tail.
+ */
+void DecodeVertices(const VertexStreams &streams, size_t begin, size_t end,
+                    float *buffer) {
+  size_t i = begin;
+#if defined(QMESH_X86)
+  if (kHasSse2) i = DecodeVerticesSse2(streams, begin, end, buffer);
+#elif defined(QMESH_NEON)
+  i = DecodeVerticesNeon(streams, begin, end, buffer);
+#endif
+  for (; i < end; ++i) DecodeVertex(streams, i, buffer + i * 6);
+}
+
+}  // namespace
+
+bool ReadFromQmesh(const std::string &filename, TriangleMesh *mesh) {
+  const auto kStart = std::chrono::steady_clock::now();
+
+  MappedFile file;
+  QmeshHeader header;
+  if (!file.Open(filename) || file.size() < sizeof(QmeshHeader)) return false;
+  memcpy(&header, file.data(), sizeof(header));
+  if (!IsWellFormed(header, file.size())) {
+    std::cout << "\tError: malformed qmesh header " << std::endl;
+    return false;
+  }
+
+  const size_t kVertexCount = header.vertex_count;
+  const size_t kTriangles = header.index_count / 3;
+  std::cout << "Loading triangle mesh" << std::endl;
+  std::cout << "\tVertices = " << kVertexCount << std::endl;
+  std::cout << "\tFaces = " << kTriangles << std::endl;
+
+  mesh->Clear();
+  mesh->buffer_.resize(kVertexCount * 6);
+  mesh->faces_.resize(header.index_count);
+
+  VertexStreams streams;
+  for (int j = 0; j < kVertexStreams; ++j)
+    streams.values[j] = reinterpret_cast<const uint16_t *>(
+        file.data() + header.vertex_offset + j * header.stream_stride);
+  for (int j = 0; j < 3; ++j) {
+    mesh->min_[j] = streams.min[j] = header.min[j];
+    mesh->max_[j] = header.max[j];
+    streams.scale[j] = (header.max[j] - header.min[j]) / kPositionScale;
+  }
+  float *buffer = mesh->buffer_.data();
+  ParallelForRange(0, kVertexCount, kVertexBlock,
+                   [&](size_t begin, size_t end) {
+                     DecodeVertices(streams, begin, end, buffer);
+                   });
+
+  const uint64_t *kTable =
+      reinterpret_cast<const uint64_t *>(file.data() + header.table_offset);
+  const uint8_t *kIndexData =
+      reinterpret_cast<const uint8_t *>(file.data() + header.index_offset);
+  std::atomic<bool> valid(true);
+  ParallelFor(BlockCount(header.index_count, header.block_triangles),
+              [&](size_t block) {
+                const uint64_t kBegin = kTable[block];
+                const uint64_t kEnd = kTable[block + 1];
+                const size_t kFirst = block * header.block_triangles;
+                const size_t kCount =
+                    std::min<size_t>(header.block_triangles,
+                                     kTriangles - kFirst);
+                if (kBegin > kEnd || kEnd > header.index_size ||
+                    !DecodeBlock(kIndexData + kBegin, kIndexData + kEnd,
+                                 kCount * 3,
+                                 static_cast<uint32_t>(kVertexCount),
+                                 &mesh->faces_[kFirst * 3]))
+                  valid = false;
+              });
+  if (!valid) {
+    std::cout << "\tError: malformed index block " << std::endl;
+    mesh->Clear();
+    return false;
+  }
+
+  const double kSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - kStart)
+                              .count();
+  std::cout << "\tDecoded qmesh in " << kSeconds * 1000.0 << " ms"
+            << std::endl;
+  return true;
+}
+
+bool WriteToQmesh(const std::string &filename, const TriangleMesh &mesh) {
+  const size_t kVertexCount = mesh.vertices_.size() / 3;
+  const size_t kTriangles = mesh.triangle_count();
+  const size_t kMaxCount = std::numeric_limits<int>::max();
+  if (kVertexCount == 0 || kVertexCount > kMaxCount || kTriangles == 0 ||
+      kTriangles * 3 > kMaxCount ||
+      mesh.normals_.size() != mesh.vertices_.size())
+    return false;
+
+  QmeshHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kQmeshMagic, sizeof(kQmeshMagic));
+  header.version = kQmeshVersion;
+  header.block_triangles = kBlockTriangles;
+  header.vertex_count = kVertexCount;
+  header.index_count = kTriangles * 3;
+  float scale[3];
+  for (int j = 0; j < 3; ++j) {
+    header.min[j] = mesh.min_[j];
+    header.max[j] = mesh.max_[j];
+    if (!(header.min[j] <= header.max[j])) return false;
+    const float kExtent = header.max[j] - header.min[j];
+    scale[j] = kExtent > 0.0f ? kPositionScale / kExtent : 0.0f;
+  }
+
+  // Vertices, as kVertexStreams padded arrays.
+  header.vertex_offset = AlignSection(sizeof(QmeshHeader));
+  header.stream_stride = AlignSection(kVertexCount * sizeof(uint16_t));
+  const size_t kStreamValues = header.stream_stride / sizeof(uint16_t);
+  std::vector<uint16_t> streams(kStreamValues * kVertexStreams, 0);
+  ParallelForRange(0, kVertexCount, kVertexBlock, [&](size_t begin,
+                                                      size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        const float kQuantized =
+            std::round((mesh.vertices_[i * 3 + j] - header.min[j]) * scale[j]);
+        streams[j * kStreamValues + i] = static_cast<uint16_t>(
+            std::min(kPositionScale, std::max(0.0f, kQuantized)));
+      }
+      EncodeNormal(&mesh.normals_[i * 3], &streams[3 * kStreamValues + i],
+                   &streams[4 * kStreamValues + i]);
+    }
+  });
+
+  // Indices, coded block by block.
+  const size_t kBlocks = BlockCount(header.index_count, kBlockTriangles);
+  std::vector<std::vector<uint8_t>> blocks(kBlocks);
+  std::atomic<bool> valid(true);
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kFirst = block * kBlockTriangles;
+    const size_t kCount =
+        std::min<size_t>(kBlockTriangles, kTriangles - kFirst);
+    blocks[block].reserve(kCount * 3 * 2);
+    if (!EncodeBlock(&mesh.faces_[kFirst * 3], kCount * 3,
+                     static_cast<int>(kVertexCount), &blocks[block]))
+      valid = false;
+  });
+  if (!valid) return false;
+
+  std::vector<uint64_t> table(kBlocks + 1, 0);
+  for (size_t block = 0; block < kBlocks; ++block)
+    table[block + 1] = table[block] + blocks[block].size();
+  header.table_offset =
+      header.vertex_offset + kVertexStreams * header.stream_stride;
+  header.index_offset =
+      AlignSection(header.table_offset + table.size() * sizeof(uint64_t));
+  header.index_size = table.back();
+
+  std::ofstream fout(filename.c_str(),
+                     std::ios_base::out | std::ios_base::binary);
+  if (!fout.is_open()) return false;
+
+  fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  WritePadding(&fout, sizeof(header), header.vertex_offset);
+  fout.write(reinterpret_cast<const char *>(streams.data()),
+             static_cast<std::streamsize>(streams.size() * sizeof(uint16_t)));
+  fout.write(reinterpret_cast<const char *>(table.data()),
+             static_cast<std::streamsize>(table.size() * sizeof(uint64_t)));
+  WritePadding(&fout, header.table_offset + table.size() * sizeof(uint64_t),
+               header.index_offset);
+  for (const std::vector<uint8_t> &block : blocks)
+    fout.write(reinterpret_cast<const char *>(block.data()),
+               static_cast<std::streamsize>(block.size()));
+  fout.close();
+  return static_cast<bool>(fout);
+}
+
+}  // namespace data_representation
@@ -0,0 +1,39 @@
+// Author: Marc Comino 2020
+
+#ifndef QMESH_IO_H_
+#define QMESH_IO_H_
+
+#include <triangle_mesh.h>
+
+#include <string>
+
+namespace data_representation {
+
+/**
+ * @brief ReadFromQmesh Reads a mesh stored in the quantized .qmesh container at
+ * the path filename. Positions and normals are decoded with SIMD straight
+ * into the interleaved GPU layout of TriangleMesh::buffer_, and the index
+ * blocks are decoded in parallel into faces_. vertices_ and normals_ are left
+ * empty.
+ * @param filename The path to the .qmesh file.
+ * @param mesh The resulting representation, ready to be uploaded.
+ * @return Whether it was able to read the file.
+ */
+bool ReadFromQmesh(const std::string &filename, TriangleMesh *mesh);
+
+/**
+ * @brief WriteToQmesh Stores the mesh in the quantized .qmesh container.
+ * Positions are quantized to 16 bits per axis relative to min_ and max_,
+ * normals are octahedral encoded in two 16-bit values, and indices are zigzag
+ * delta coded as varints in independent blocks of triangles, in the order of
+ * faces_.
+ * @param filename The path where the mesh will be stored.
+ * @param mesh The mesh to be stored, with per-vertex normals and its bounding
+ * box.
+ * @return Whether it was able to store the file.
+ */
+bool WriteToQmesh(const std::string &filename, const TriangleMesh &mesh);
+
+}  // namespace data_representation
+
+#endif  // QMESH_IO_H_
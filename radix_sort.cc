@@ -0,0 +1,76 @@
+// Author: Marc Comino 2020
+
+#include <radix_sort.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+const int kDigitBits = 8;
+const size_t kBuckets = 1 << kDigitBits;
+
+/**
+ * @brief kMinBlock Minimum number of pairs per block of a pass.
+ */
+const size_t kMinBlock = 1 << 16;
+
+}  // namespace
+
+void RadixSortPairs(std::vector<uint64_t> *keys, std::vector<uint32_t> *values,
+                    int bits) {
+  const size_t kCount = keys->size();
+  const size_t kBlocks =
+      std::max<size_t>(1, std::min(NumThreads() * 4, kCount / kMinBlock));
+  const size_t kBlock = (kCount + kBlocks - 1) / kBlocks;
+
+  std::vector<uint64_t> key_buffer(kCount);
+  std::vector<uint32_t> value_buffer(kCount);
+  std::vector<size_t> offsets(kBlocks * kBuckets);
+  for (int shift = 0; shift < bits; shift += kDigitBits) {
+    const uint64_t *kKeys = keys->data();
+    std::fill(offsets.begin(), offsets.end(), 0);
+    ParallelFor(kBlocks, [&](size_t block) {
+      size_t *counts = &offsets[block * kBuckets];
+      const size_t kEnd = std::min(kCount, (block + 1) * kBlock);
+      for (size_t i = block * kBlock; i < kEnd; ++i)
+        ++counts[(kKeys[i] >> shift) & (kBuckets - 1)];
+    });
+
+    // Digit-major order of the block offsets keeps the sort stable.
+    size_t total = 0;
+    bool single_digit = false;
+    for (size_t digit = 0; digit < kBuckets; ++digit) {
+      size_t digit_count = 0;
+      for (size_t block = 0; block < kBlocks; ++block) {
+        size_t &offset = offsets[block * kBuckets + digit];
+        const size_t kBlockCount = offset;
+        offset = total;
+        total += kBlockCount;
+        digit_count += kBlockCount;
+      }
+      if (digit_count == kCount) single_digit = true;
+    }
+    if (single_digit) continue;
+
+    ParallelFor(kBlocks, [&](size_t block) {
+      size_t *next = &offsets[block * kBuckets];
+      const size_t kEnd = std::min(kCount, (block + 1) * kBlock);
+      for (size_t i = block * kBlock; i < kEnd; ++i) {
+        const size_t kTarget = next[(kKeys[i] >> shift) & (kBuckets - 1)]++;
+        key_buffer[kTarget] = kKeys[i];
+        value_buffer[kTarget] = (*values)[i];
+      }
+    });
+    keys->swap(key_buffer);
+    values->swap(value_buffer);
+  }
+}
+
+}  // namespace data_representation
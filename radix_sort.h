@@ -0,0 +1,26 @@
+// Author: Marc Comino 2020
+
+#ifndef RADIX_SORT_H_
+#define RADIX_SORT_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief RadixSortPairs Sorts 64-bit keys together with their 32-bit values
+ * with a parallel least-significant-digit radix sort. The sort is stable, so
+ * values with equal keys keep their relative order, and the result does not
+ * depend on the number of threads.
+ * @param keys The keys to sort.
+ * @param values The values, one per key, permuted along with them.
+ * @param bits Number of low bits of the keys that can be non-zero.
+ */
+void RadixSortPairs(std::vector<uint64_t> *keys, std::vector<uint32_t> *values,
+                    int bits);
+
+}  // namespace data_representation
+
+#endif  // RADIX_SORT_H_
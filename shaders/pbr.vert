@@ -6,6 +6,8 @@ layout (location = 1) in vec3 normal;
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+// Maps quantized positions to model space, normals are not quantized.
+uniform mat4 dequantization;
 uniform mat3 normal_matrix;
 
 smooth out vec3 Normal;
@@ -14,7 +16,7 @@ smooth out vec3 Position;
 
 void main(void)  {
   Normal = mat3(model) * normal;
-  Position = vec3(model * vec4(vert, 1.0));
+  Position = vec3(model * dequantization * vec4(vert, 1.0));
   //mat4 inverseView = inverse(view);
   //CameraPos = vec3(inverseView[3][0],inverseView[3][1],inverseView[3][2]);
   //CameraPos = -(view * model * vec4(vert, 1)).xyz;
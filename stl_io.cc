@@ -0,0 +1,278 @@
+// Author: Marc Comino 2020
+
+#include <stl_io.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "./geometry_kernels.h"
+#include "./mapped_file.h"
+#include "./mesh_processing.h"
+#include "./parallel.h"
+#include "./radix_sort.h"
+#include "./text_parser.h"
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+namespace {
+
+const size_t kBinaryHeaderSize = 84;
+
+/**
+ * @brief kBinaryRecordSize Facet normal, three vertices and an attribute word.
+ */
+const size_t kBinaryRecordSize = 12 * sizeof(float) + sizeof(uint16_t);
+
+/**
+ * @brief kChunkSize Minimum amount of text handed to a parsing thread.
+ */
+const size_t kChunkSize = 1 << 20;
+
+/**
+ * @brief kCornerBlock Corners per task of the welding passes.
+ */
+const size_t kCornerBlock = 1 << 16;
+
+/**
+ * @brief kWeldBits Bits per axis of the welding grid. Three of them fit in a
+ * 64-bit key, which gives cells about a two-millionth of the model size.
+ */
+const int kWeldBits = 21;
+
+/**
+ * @brief IsBinaryStl Binary files are recognized by their size matching the
+ * facet count. Some exporters write "solid" at the start of binary headers, so
+ * the ASCII keyword alone is not enough.
+ */
+bool IsBinaryStl(const char *data, size_t size) {
+  if (size < kBinaryHeaderSize) return false;
+
+  uint32_t facets;
+  memcpy(&facets, data + 80, sizeof(facets));
+  const uint64_t kExpected =
+      kBinaryHeaderSize + static_cast<uint64_t>(facets) * kBinaryRecordSize;
+  if (kExpected == size) return true;
+
+  const char *p = SkipSpaces(data, data + size);
+  const bool kAscii = data + size - p >= 5 && strncmp(p, "solid", 5) == 0;
+  return !kAscii && kExpected <= size;
+}
+
+/**
+ * @brief ReadBinaryCorners Copies the three vertices of every facet.
+ */
+bool ReadBinaryCorners(const char *data, std::vector<float> *corners) {
+  uint32_t facets;
+  memcpy(&facets, data + 80, sizeof(facets));
+  corners->resize(static_cast<size_t>(facets) * 9);
+
+  const char *kRecords = data + kBinaryHeaderSize;
+  ParallelForRange(0, facets, kCornerBlock, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      memcpy(&(*corners)[i * 9], kRecords + i * kBinaryRecordSize + 12,
+             9 * sizeof(float));
+    }
+  });
+  return true;
+}
+
+/**
+ * @brief IsVertexLine Whether the line starting at *p is a vertex record, in
+ * which case *p is moved past the keyword.
+ */
+bool IsVertexLine(const char **p, const char *end) {
+  const char *c = SkipSpaces(*p, end);
+  if (end - c < 7 || strncmp(c, "vertex", 6) != 0 ||
+      (c[6] != ' ' && c[6] != '\t'))
+    return false;
+  *p = c + 6;
+  return true;
+}
+
+/**
+ * @brief ReadAsciiCorners Parses the vertex lines of an ASCII file in
+ * line-aligned chunks: a first pass counts the vertices of every chunk and a
+ * second one parses them into place.
+ */
+bool ReadAsciiCorners(const char *data, size_t size,
+                      std::vector<float> *corners) {
+  const std::vector<const char *> kBounds =
+      SplitLines(data, data + size, kChunkSize, NumThreads() * 4);
+  const size_t kChunks = kBounds.size() - 1;
+
+  std::vector<size_t> first(kChunks + 1, 0);
+  ParallelFor(kChunks, [&](size_t chunk) {
+    size_t vertices = 0;
+    const char *kEnd = kBounds[chunk + 1];
+    for (const char *p = kBounds[chunk]; p < kEnd; p = SkipLine(p, kEnd))
+      if (IsVertexLine(&p, kEnd)) ++vertices;
+    first[chunk + 1] = vertices;
+  });
+  for (size_t i = 0; i < kChunks; ++i) first[i + 1] += first[i];
+  if (first[kChunks] % 3 != 0) return false;
+
+  corners->resize(first[kChunks] * 3);
+  std::atomic<bool> valid(true);
+  ParallelFor(kChunks, [&](size_t chunk) {
+    float *values = corners->data() + first[chunk] * 3;
+    const char *kEnd = kBounds[chunk + 1];
+    for (const char *p = kBounds[chunk]; p < kEnd; p = SkipLine(p, kEnd)) {
+      if (!IsVertexLine(&p, kEnd)) continue;
+      for (int j = 0; j < 3; ++j, ++values) {
+        if (!ParseFloat(&p, kEnd, values)) {
+          valid = false;
+          return;
+        }
+      }
+    }
+  });
+  return valid;
+}
+
+/**
+ * @brief SpreadBits Moves the low 21 bits of value to every third bit.
+ */
+uint64_t SpreadBits(uint64_t value) {
+  value &= 0x1FFFFF;
+  value = (value | value << 32) & 0x1F00000000FFFFULL;
+  value = (value | value << 16) & 0x1F0000FF0000FFULL;
+  value = (value | value << 8) & 0x100F00F00F00F00FULL;
+  value = (value | value << 4) & 0x10C30C30C30C30C3ULL;
+  value = (value | value << 2) & 0x1249249249249249ULL;
+  return value;
+}
+
+/**
+ * @brief WeldCorners Merges corners that fall in the same cell of a grid over
+ * their bounding box. The cells are Morton coded, so sorting the keys both
+ * groups equal positions and numbers the vertices in a spatially coherent
+ * order. Every vertex takes the position of its first corner.
+ */
+void WeldCorners(const std::vector<float> &corners, TriangleMesh *mesh) {
+  const size_t kCorners = corners.size() / 3;
+
+  const size_t kBlocks = (kCorners + kCornerBlock - 1) / kCornerBlock;
+  std::vector<Eigen::Vector3f> block_min(
+      kBlocks, Eigen::Vector3f::Constant(std::numeric_limits<float>::max()));
+  std::vector<Eigen::Vector3f> block_max(kBlocks, -block_min.front());
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kFirst = block * kCornerBlock;
+    ExtendBounds(corners.data() + kFirst * 3,
+                 std::min(kCornerBlock, kCorners - kFirst),
+                 block_min[block].data(), block_max[block].data());
+  });
+  Eigen::Vector3f min = block_min.front(), max = block_max.front();
+  for (size_t block = 1; block < kBlocks; ++block) {
+    min = min.cwiseMin(block_min[block]);
+    max = max.cwiseMax(block_max[block]);
+  }
+
+  const float kCells = static_cast<float>((1 << kWeldBits) - 1);
+  Eigen::Vector3f scale;
+  for (int j = 0; j < 3; ++j)
+    scale[j] = max[j] > min[j] ? kCells / (max[j] - min[j]) : 0.0f;
+
+  std::vector<uint64_t> keys(kCorners);
+  std::vector<uint32_t> order(kCorners);
+  ParallelForRange(0, kCorners, kCornerBlock, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      uint64_t key = 0;
+      for (int j = 0; j < 3; ++j) {
+        const float kCell = (corners[i * 3 + j] - min[j]) * scale[j] + 0.5f;
+        // NaN coordinates end up in cell 0.
+        const uint64_t kIndex =
+            kCell >= 0.0f ? static_cast<uint64_t>(std::min(kCell, kCells)) : 0;
+        key |= SpreadBits(kIndex) << j;
+      }
+      keys[i] = key;
+      order[i] = static_cast<uint32_t>(i);
+    }
+  });
+  RadixSortPairs(&keys, &order, 3 * kWeldBits);
+
+  // Every run of equal keys becomes a vertex.
+  std::vector<size_t> first_vertex(kBlocks + 1, 0);
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kEnd = std::min(kCorners, (block + 1) * kCornerBlock);
+    size_t runs = 0;
+    for (size_t i = block * kCornerBlock; i < kEnd; ++i)
+      if (i == 0 || keys[i] != keys[i - 1]) ++runs;
+    first_vertex[block + 1] = runs;
+  });
+  for (size_t i = 0; i < kBlocks; ++i) first_vertex[i + 1] += first_vertex[i];
+
+  mesh->vertices_.resize(first_vertex[kBlocks] * 3);
+  mesh->faces_.resize(kCorners);
+  ParallelFor(kBlocks, [&](size_t block) {
+    const size_t kBegin = block * kCornerBlock;
+    const size_t kEnd = std::min(kCorners, kBegin + kCornerBlock);
+    // vertex is the next id to hand out. A run that started in the previous
+    // block continues with that block's last vertex.
+    size_t vertex = first_vertex[block];
+    for (size_t i = kBegin; i < kEnd; ++i) {
+      if (i == 0 || keys[i] != keys[i - 1]) {
+        std::copy_n(&corners[order[i] * 3], 3, &mesh->vertices_[vertex * 3]);
+        ++vertex;
+      }
+      mesh->faces_[order[i]] = static_cast<int>(vertex - 1);
+    }
+  });
+}
+
+}  // namespace
+
+bool ReadFromStl(const std::string &filename, TriangleMesh *mesh) {
+  const auto kStart = std::chrono::steady_clock::now();
+
+  MappedFile file;
+  if (!file.Open(filename)) return false;
+
+  std::vector<float> corners;
+  const bool kBinary = IsBinaryStl(file.data(), file.size());
+  const bool kRead =
+      kBinary ? ReadBinaryCorners(file.data(), &corners)
+              : ReadAsciiCorners(file.data(), file.size(), &corners);
+  const size_t kTriangles = corners.size() / 9;
+  if (!kRead || kTriangles == 0 ||
+      kTriangles * 3 > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    std::cout << "\tError loading facets " << std::endl;
+    return false;
+  }
+  file.Close();
+
+  std::cout << "Loading triangle mesh" << std::endl;
+  std::cout << "\tFacets = " << kTriangles << " ("
+            << (kBinary ? "binary" : "ASCII") << ")" << std::endl;
+
+  // A reused mesh must not keep the colors, levels or bounds of the last
+  // model.
+  mesh->Clear();
+  WeldCorners(corners, mesh);
+  std::cout << "\tWelded " << kTriangles * 3 << " corners into "
+            << mesh->vertices_.size() / 3 << " vertices " << std::endl;
+
+  const double kSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - kStart)
+                              .count();
+  std::cout << "\tRead STL in " << kSeconds * 1000.0 << " ms" << std::endl;
+
+  ComputeVertexNormals(mesh->vertices_, mesh->faces_, &mesh->normals_);
+  std::cout << "\tGenerated normals " << std::endl;
+  ComputeBoundingBox(mesh->vertices_, mesh);
+  std::cout << "\tGenerated bounding box " << std::endl;
+  mesh->prepareVertexBuffer();
+  std::cout << "\tPrepared vertex buffer " << std::endl;
+  return true;
+}
+
+}  // namespace data_representation
@@ -0,0 +1,26 @@
+// Author: Marc Comino 2020
+
+#ifndef STL_IO_H_
+#define STL_IO_H_
+
+#include <triangle_mesh.h>
+
+#include <string>
+
+namespace data_representation {
+
+/**
+ * @brief ReadFromStl Reads the mesh stored in binary or ASCII STL format at the
+ * path filename and stores the corresponding TriangleMesh representation. STL
+ * stores three unshared vertices per triangle, so corners whose positions fall
+ * in the same cell of a fine grid over the bounding box are welded into one
+ * vertex, and smooth per-vertex normals are computed over the welded mesh.
+ * @param filename The path to the STL mesh.
+ * @param mesh The resulting representation with computed per-vertex normals.
+ * @return Whether it was able to read the file.
+ */
+bool ReadFromStl(const std::string &filename, TriangleMesh *mesh);
+
+}  // namespace data_representation
+
+#endif  // STL_IO_H_
@@ -0,0 +1,166 @@
+// Author: Marc Comino 2020
+
+#ifndef TEXT_PARSER_H_
+#define TEXT_PARSER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief SkipSpaces Advances p past blanks and tabs, stopping at line breaks.
+ */
+inline const char *SkipSpaces(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+  return p;
+}
+
+/**
+ * @brief SkipLine Returns the first character of the next line.
+ */
+inline const char *SkipLine(const char *p, const char *end) {
+  while (p < end && *p != '\n') ++p;
+  return p < end ? p + 1 : end;
+}
+
+/**
+ * @brief ParseInt Parses a decimal integer, skipping leading blanks.
+ * @param p In: where to start parsing. Out: the first unparsed character.
+ * @param end One past the last readable character.
+ * @param value The parsed value.
+ * @return Whether a number was found.
+ */
+inline bool ParseInt(const char **p, const char *end, int64_t *value) {
+  const char *c = SkipSpaces(*p, end);
+  bool negative = false;
+  if (c < end && (*c == '-' || *c == '+')) negative = *c++ == '-';
+
+  const char *kDigits = c;
+  int64_t result = 0;
+  while (c < end && *c >= '0' && *c <= '9') {
+    result = result * 10 + (*c++ - '0');
+  }
+  if (c == kDigits) return false;
+
+  *value = negative ? -result : result;
+  *p = c;
+  return true;
+}
+
+/**
+ * @brief ParseFloat Parses a decimal floating point number, skipping leading
+ * blanks. Much faster than strtof since it does not depend on the locale and
+ * works on non null-terminated ranges. Results may differ from a correctly
+ * rounded conversion in the last bit.
+ * @param p In: where to start parsing. Out: the first unparsed character.
+ * @param end One past the last readable character.
+ * @param value The parsed value.
+ * @return Whether a number was found.
+ */
+inline bool ParseFloat(const char **p, const char *end, float *value) {
+  static const double kPowers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                   1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                   1e18, 1e19, 1e20, 1e21, 1e22};
+  const int kMaxPower = 22;
+
+  const char *c = SkipSpaces(*p, end);
+  const char *kStart = c;
+  bool negative = false;
+  if (c < end && (*c == '-' || *c == '+')) negative = *c++ == '-';
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+  bool any = false;
+  for (; c < end && *c >= '0' && *c <= '9'; ++c, any = true) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*c - '0');
+      if (mantissa != 0) ++digits;
+    } else {
+      ++exponent;
+    }
+  }
+  if (c < end && *c == '.') {
+    for (++c; c < end && *c >= '0' && *c <= '9'; ++c, any = true) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*c - '0');
+        if (mantissa != 0) ++digits;
+        --exponent;
+      }
+    }
+  }
+
+  if (!any) {
+    // inf, nan and other spellings are rare enough to go through strtof.
+    if (c >= end || (*c != 'i' && *c != 'I' && *c != 'n' && *c != 'N'))
+      return false;
+    const char *kWordEnd = c;
+    while (kWordEnd < end && *kWordEnd > ' ') ++kWordEnd;
+    std::string word(kStart, kWordEnd);
+    *value = strtof(word.c_str(), nullptr);
+    *p = kWordEnd;
+    return true;
+  }
+
+  if (c < end && (*c == 'e' || *c == 'E')) {
+    const char *e = c + 1;
+    const char *digit = e < end && (*e == '-' || *e == '+') ? e + 1 : e;
+    int64_t power = 0;
+    if (digit < end && *digit >= '0' && *digit <= '9' &&
+        ParseInt(&e, end, &power)) {
+      exponent += static_cast<int>(power);
+      c = e;
+    }
+  }
+
+  double result = static_cast<double>(mantissa);
+  while (exponent > kMaxPower) {
+    result *= kPowers[kMaxPower];
+    exponent -= kMaxPower;
+  }
+  while (exponent < -kMaxPower) {
+    result /= kPowers[kMaxPower];
+    exponent += kMaxPower;
+  }
+  result = exponent < 0 ? result / kPowers[-exponent]
+                        : result * kPowers[exponent];
+
+  *value = static_cast<float>(negative ? -result : result);
+  *p = c;
+  return true;
+}
+
+/**
+ * @brief SplitLines Splits [begin, end) into roughly equal chunks that start
+ * right after a line break, one per task, so they can be parsed concurrently.
+ * @param begin First character of the text.
+ * @param end One past the last character of the text.
+ * @param min_chunk Minimum size of a chunk in bytes.
+ * @param max_chunks Maximum number of chunks.
+ * @return The chunk boundaries, from begin to end (both included).
+ */
+inline std::vector<const char *> SplitLines(const char *begin, const char *end,
+                                            size_t min_chunk,
+                                            size_t max_chunks) {
+  const size_t kSize = static_cast<size_t>(end - begin);
+  size_t chunks = std::max<size_t>(1, std::min(max_chunks, kSize / min_chunk));
+
+  std::vector<const char *> bounds(1, begin);
+  for (size_t i = 1; i < chunks; ++i) {
+    const char *split = SkipLine(begin + kSize * i / chunks - 1, end);
+    if (split > bounds.back() && split < end) bounds.push_back(split);
+  }
+  bounds.push_back(end);
+  return bounds;
+}
+
+}  // namespace data_representation
+
+#endif  // TEXT_PARSER_H_
@@ -14,6 +14,8 @@ void TriangleMesh::Clear() {
   faces_.clear();
   normals_.clear();
   buffer_.clear();
+  colors_.clear();
+  lods_.clear();
 
   min_ = Eigen::Vector3f(std::numeric_limits<float>::max(),
                          std::numeric_limits<float>::max(),
@@ -23,19 +25,42 @@ void TriangleMesh::Clear() {
                          std::numeric_limits<float>::lowest());
 }
 
-void TriangleMesh::prepareVertexBuffer()
-{
-    buffer_.clear();
-    for(unsigned int i=0; i < faces_.size();++i)
-    {
-        for(int j=0; j< 3; ++j)
-        {
-            buffer_.push_back(vertices_[i*3+j]);
-        }
-        for(int j=0; j< 3; ++j)
-        {
-            buffer_.push_back(normals_[i*3+j]);
-        }
-    }
+void TriangleMesh::prepareVertexBuffer() {
+  BuildVertexBuffer(vertices_, normals_, &buffer_);
 }
+
+size_t TriangleMesh::vertex_count() const {
+  return vertices_.empty() ? buffer_.size() / kInterleavedFloats
+                           : vertices_.size() / 3;
+}
+
+size_t TriangleMesh::triangle_count() const {
+  return (lods_.empty() ? faces_.size() : lods_[0].index_count) / 3;
+}
+
+Eigen::Matrix4f TriangleMesh::EncodeVertexBuffer(
+    const VertexLayout &layout, std::vector<unsigned char> *data) const {
+  VertexSource source;
+  source.count = vertex_count();
+  if (vertices_.empty()) {
+    source.positions = buffer_.data() + kInterleavedLayout.position.offset /
+                                            sizeof(float);
+    source.normals =
+        buffer_.data() + kInterleavedLayout.normal.offset / sizeof(float);
+    source.stride = kInterleavedFloats;
+  } else {
+    source.positions = vertices_.data();
+    source.normals = normals_.size() == vertices_.size() ? normals_.data()
+                                                         : nullptr;
+    source.stride = 3;
+  }
+
+  data->resize(VertexBufferSize(layout, source.count));
+  EncodeVertices(source, layout, min_.data(), max_.data(), data->data());
+  Eigen::Matrix4f dequantization;
+  DequantizationMatrix(layout, min_.data(), max_.data(),
+                       dequantization.data());
+  return dequantization;
+}
+
 }  // namespace data_representation
@@ -7,8 +7,21 @@
 
 #include <vector>
 
+#include "./vertex_buffer.h"
+
 namespace data_representation {
 
+/**
+ * @brief MeshLod A level of detail of a mesh: the range of faces_ that draws
+ * it, and the distance from its surface to that of the full mesh estimated by
+ * the simplifier.
+ */
+struct MeshLod {
+  size_t first_index;
+  size_t index_count;
+  float error;
+};
+
 class TriangleMesh {
  public:
   /**
@@ -25,13 +38,56 @@ class TriangleMesh {
    * @brief Clear Empties the data arrays and resets the bounding box vertices.
    */
   void Clear();
+
+  /**
+   * @brief prepareVertexBuffer Fills buffer_ with one record per vertex in
+   * kInterleavedLayout, which faces_ index directly.
+   */
   void prepareVertexBuffer();
+
+  /**
+   * @brief vertex_count Number of vertices, also of meshes decoded straight
+   * into buffer_.
+   */
+  size_t vertex_count() const;
+
+  /**
+   * @brief triangle_count Number of triangles of the full mesh.
+   */
+  size_t triangle_count() const;
+
+  /**
+   * @brief EncodeVertexBuffer Encodes one entry per vertex in the given
+   * layout, from vertices_ and normals_ or, if there are none, from buffer_.
+   * @param layout A layout from MakeVertexLayout for vertex_count() vertices.
+   * @param data The encoded buffer.
+   * @return The matrix that maps the decoded positions to model space.
+   */
+  Eigen::Matrix4f EncodeVertexBuffer(const VertexLayout &layout,
+                                     std::vector<unsigned char> *data) const;
+
  public:
   std::vector<float> vertices_;
   std::vector<int> faces_;
   std::vector<float> normals_;
+
+  /**
+   * @brief buffer_ Interleaved vertex records, see prepareVertexBuffer.
+   */
   std::vector<float> buffer_;
 
+  /**
+   * @brief lods_ Levels of detail, the full mesh first, all of them indexing
+   * the same vertices. When there are any, faces_ holds their indices one
+   * after the other.
+   */
+  std::vector<MeshLod> lods_;
+
+  /**
+   * @brief colors_ Optional per-vertex RGB colors, empty if the model has none.
+   */
+  std::vector<unsigned char> colors_;
+
   /**
    * @brief min The minimum point of the bounding box.
    */
@@ -0,0 +1,210 @@
+// Author: Marc Comino 2020
+
+#include <vertex_buffer.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kVertexBlock Vertices per task of the buffer build.
+ */
+const size_t kVertexBlock = 1 << 16;
+
+/**
+ * @brief FloatToHalf Converts to a half float rounding to nearest even, with
+ * overflows to infinity and NaNs kept quiet.
+ */
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t kSign = (bits >> 16) & 0x8000;
+  uint32_t magnitude = bits & 0x7FFFFFFF;
+
+  if (magnitude >= 0x7F800000)
+    return kSign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00);
+  // 65520 and above round to infinity.
+  if (magnitude >= 0x477FF000) return kSign | 0x7C00;
+  if (magnitude < 0x38800000) {
+    // Subnormal halves: adding 0.5 leaves the float with the ulp of a
+    // subnormal half and lets the FPU round.
+    float subnormal;
+    memcpy(&subnormal, &magnitude, sizeof(subnormal));
+    subnormal += 0.5f;
+    memcpy(&magnitude, &subnormal, sizeof(magnitude));
+    return kSign | (magnitude - 0x3F000000);
+  }
+  // Rebias the exponent and round the 13 dropped bits to nearest even.
+  magnitude += 0xC8000FFF + ((magnitude >> 13) & 1);
+  return kSign | (magnitude >> 13);
+}
+
+uint32_t PackSnorm10(const float *values) {
+  uint32_t packed = 0;
+  for (int k = 0; k < 3; ++k) {
+    const float kClamped = std::min(1.0f, std::max(-1.0f, values[k]));
+    const int32_t kValue = static_cast<int32_t>(std::lround(kClamped * 511.0f));
+    packed |= (static_cast<uint32_t>(kValue) & 0x3FF) << (10 * k);
+  }
+  return packed;
+}
+
+/**
+ * @brief Encode Writes the three values of an attribute in the given format.
+ * @param offset Subtracted from kUnorm16x3 values before scaling.
+ * @param scale Maps kUnorm16x3 values to [0, 65535].
+ */
+void Encode(VertexFormat format, const float *values, const float *offset,
+            const float *scale, unsigned char *out) {
+  switch (format) {
+    case VertexFormat::kFloat3:
+      memcpy(out, values, 3 * sizeof(float));
+      break;
+    case VertexFormat::kHalf3: {
+      const uint16_t kHalves[4] = {FloatToHalf(values[0]),
+                                   FloatToHalf(values[1]),
+                                   FloatToHalf(values[2]), 0};
+      memcpy(out, kHalves, sizeof(kHalves));
+      break;
+    }
+    case VertexFormat::kUnorm16x3: {
+      uint16_t quantized[4] = {0, 0, 0, 0};
+      for (int k = 0; k < 3; ++k) {
+        const float kValue = (values[k] - offset[k]) * scale[k];
+        quantized[k] = static_cast<uint16_t>(
+            std::lround(std::min(65535.0f, std::max(0.0f, kValue))));
+      }
+      memcpy(out, quantized, sizeof(quantized));
+      break;
+    }
+    case VertexFormat::kSnorm10x3: {
+      const uint32_t kPacked = PackSnorm10(values);
+      memcpy(out, &kPacked, sizeof(kPacked));
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Extent Size of the bounding box along an axis, 1 if it is flat so
+ * that the dequantization stays invertible.
+ */
+float Extent(const float min[3], const float max[3], int axis) {
+  const float kExtent = max[axis] - min[axis];
+  return kExtent > 0.0f ? kExtent : 1.0f;
+}
+
+}  // namespace
+
+size_t VertexFormatSize(VertexFormat format) {
+  switch (format) {
+    case VertexFormat::kFloat3: return 3 * sizeof(float);
+    case VertexFormat::kHalf3:
+    case VertexFormat::kUnorm16x3: return 4 * sizeof(uint16_t);
+    case VertexFormat::kSnorm10x3: return sizeof(uint32_t);
+  }
+  return 0;
+}
+
+VertexLayout MakeVertexLayout(VertexFormat position, VertexFormat normal,
+                              VertexArrangement arrangement,
+                              size_t vertex_count) {
+  const size_t kPositionSize = VertexFormatSize(position);
+  const size_t kNormalSize = VertexFormatSize(normal);
+  VertexLayout layout;
+  layout.position.format = position;
+  layout.normal.format = normal;
+  layout.position.offset = 0;
+  if (arrangement == VertexArrangement::kInterleaved) {
+    layout.position.stride = layout.normal.stride = kPositionSize + kNormalSize;
+    layout.normal.offset = kPositionSize;
+  } else {
+    layout.position.stride = kPositionSize;
+    layout.normal.stride = kNormalSize;
+    layout.normal.offset = vertex_count * kPositionSize;
+  }
+  return layout;
+}
+
+size_t VertexBufferSize(const VertexLayout &layout, size_t vertex_count) {
+  if (vertex_count == 0) return 0;
+  const VertexAttributeLayout *kAttributes[2] = {&layout.position,
+                                                 &layout.normal};
+  size_t size = 0;
+  for (const VertexAttributeLayout *attribute : kAttributes) {
+    size = std::max(size, attribute->offset +
+                              (vertex_count - 1) * attribute->stride +
+                              VertexFormatSize(attribute->format));
+  }
+  return size;
+}
+
+void EncodeVertices(const VertexSource &source, const VertexLayout &layout,
+                    const float min[3], const float max[3],
+                    unsigned char *data) {
+  float scale[3];
+  for (int k = 0; k < 3; ++k) scale[k] = 65535.0f / Extent(min, max, k);
+  const float kZero[3] = {0.0f, 0.0f, 0.0f};
+
+  ParallelForRange(0, source.count, kVertexBlock, [&](size_t begin,
+                                                      size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Encode(layout.position.format, source.positions + i * source.stride,
+             min, scale,
+             data + layout.position.offset + i * layout.position.stride);
+      Encode(layout.normal.format,
+             source.normals == nullptr ? kZero
+                                       : source.normals + i * source.stride,
+             min, scale,
+             data + layout.normal.offset + i * layout.normal.stride);
+    }
+  });
+}
+
+void DequantizationMatrix(const VertexLayout &layout, const float min[3],
+                          const float max[3], float matrix[16]) {
+  std::fill_n(matrix, 16, 0.0f);
+  matrix[15] = 1.0f;
+  const bool kQuantized = layout.position.format == VertexFormat::kUnorm16x3;
+  for (int k = 0; k < 3; ++k) {
+    matrix[k * 5] = kQuantized ? Extent(min, max, k) : 1.0f;
+    matrix[12 + k] = kQuantized ? min[k] : 0.0f;
+  }
+}
+
+void InterleaveVertices(const float *positions, const float *normals,
+                        size_t begin, size_t end, float *buffer) {
+  const size_t kPosition = kInterleavedLayout.position.offset / sizeof(float);
+  const size_t kNormal = kInterleavedLayout.normal.offset / sizeof(float);
+  for (size_t i = begin; i < end; ++i, buffer += kInterleavedFloats) {
+    std::copy_n(positions + i * 3, 3, buffer + kPosition);
+    if (normals != nullptr) {
+      std::copy_n(normals + i * 3, 3, buffer + kNormal);
+    } else {
+      std::fill_n(buffer + kNormal, 3, 0.0f);
+    }
+  }
+}
+
+void BuildVertexBuffer(const std::vector<float> &positions,
+                       const std::vector<float> &normals,
+                       std::vector<float> *buffer) {
+  const size_t kVertices = positions.size() / 3;
+  const float *kNormals = normals.empty() ? nullptr : normals.data();
+  buffer->resize(kVertices * kInterleavedFloats);
+  ParallelForRange(0, kVertices, kVertexBlock, [&](size_t begin, size_t end) {
+    InterleaveVertices(positions.data(), kNormals, begin, end,
+                       buffer->data() + begin * kInterleavedFloats);
+  });
+}
+
+}  // namespace data_representation
@@ -0,0 +1,182 @@
+// Author: Marc Comino 2020
+
+#ifndef VERTEX_BUFFER_H_
+#define VERTEX_BUFFER_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief VertexFormat How an attribute stores its three components. Records
+ * are padded to a multiple of 4 bytes.
+ */
+enum class VertexFormat {
+  /**
+   * @brief kFloat3 Three floats, 12 bytes.
+   */
+  kFloat3,
+
+  /**
+   * @brief kHalf3 Three half floats and padding, 8 bytes.
+   */
+  kHalf3,
+
+  /**
+   * @brief kUnorm16x3 Three normalized unsigned shorts and padding, 8 bytes.
+   * Positions are quantized over the bounding box and mapped back by the
+   * dequantization matrix.
+   */
+  kUnorm16x3,
+
+  /**
+   * @brief kSnorm10x3 Three signed normalized 10-bit values packed as
+   * GL_INT_2_10_10_10_REV, 4 bytes. Meant for unit normals.
+   */
+  kSnorm10x3
+};
+
+/**
+ * @brief VertexFormatSize Size in bytes of a value of the given format.
+ */
+size_t VertexFormatSize(VertexFormat format);
+
+/**
+ * @brief VertexArrangement How the attributes of a vertex buffer are laid out.
+ */
+enum class VertexArrangement {
+  /**
+   * @brief kInterleaved One record per vertex holding all of its attributes.
+   */
+  kInterleaved,
+
+  /**
+   * @brief kSeparate One stream per attribute, one after the other.
+   */
+  kSeparate
+};
+
+/**
+ * @brief VertexAttributeLayout Where an attribute is stored inside a vertex
+ * buffer.
+ */
+struct VertexAttributeLayout {
+  VertexFormat format;
+
+  /**
+   * @brief offset Byte offset of the attribute of the first vertex.
+   */
+  size_t offset;
+
+  /**
+   * @brief stride Bytes between the attributes of consecutive vertices.
+   */
+  size_t stride;
+};
+
+/**
+ * @brief VertexLayout Attribute table of a vertex buffer with one entry per
+ * vertex that the index buffer refers to.
+ */
+struct VertexLayout {
+  VertexAttributeLayout position;
+  VertexAttributeLayout normal;
+};
+
+/**
+ * @brief kInterleavedFloats Floats per vertex of kInterleavedLayout.
+ */
+const size_t kInterleavedFloats = 6;
+
+/**
+ * @brief kInterleavedLayout Float positions followed by float normals, the
+ * vertex buffer of TriangleMesh, the mesh cache and streamed models.
+ */
+const VertexLayout kInterleavedLayout = {
+    {VertexFormat::kFloat3, 0, kInterleavedFloats * sizeof(float)},
+    {VertexFormat::kFloat3, 3 * sizeof(float),
+     kInterleavedFloats * sizeof(float)}};
+
+/**
+ * @brief MakeVertexLayout Lays out a buffer of vertex_count vertices with the
+ * given attribute formats.
+ */
+VertexLayout MakeVertexLayout(VertexFormat position, VertexFormat normal,
+                              VertexArrangement arrangement,
+                              size_t vertex_count);
+
+/**
+ * @brief VertexBufferSize Bytes of a buffer of vertex_count vertices.
+ */
+size_t VertexBufferSize(const VertexLayout &layout, size_t vertex_count);
+
+/**
+ * @brief VertexSource Float positions and normals to encode, strided so that
+ * both packed arrays and interleaved buffers can be read.
+ */
+struct VertexSource {
+  const float *positions;
+
+  /**
+   * @brief normals Unit normals, or nullptr to encode zero normals.
+   */
+  const float *normals;
+
+  /**
+   * @brief stride Floats between consecutive positions, and normals.
+   */
+  size_t stride;
+
+  size_t count;
+};
+
+/**
+ * @brief EncodeVertices Encodes every vertex of source into data, in
+ * parallel. Half floats are rounded to nearest even.
+ * @param source The vertices.
+ * @param layout A layout from MakeVertexLayout for source.count vertices.
+ * @param min Minimum corner of the bounding box of the positions.
+ * @param max Maximum corner of the bounding box of the positions.
+ * @param data Output with room for VertexBufferSize bytes.
+ */
+void EncodeVertices(const VertexSource &source, const VertexLayout &layout,
+                    const float min[3], const float max[3],
+                    unsigned char *data);
+
+/**
+ * @brief DequantizationMatrix The column-major matrix that maps positions
+ * decoded by the GPU to model space: the identity, or for kUnorm16x3 the
+ * scale and translation of the unit cube onto the bounding box.
+ */
+void DequantizationMatrix(const VertexLayout &layout, const float min[3],
+                          const float max[3], float matrix[16]);
+
+/**
+ * @brief InterleaveVertices Writes the records of the vertices [begin, end) in
+ * kInterleavedLayout. Runs on the calling thread.
+ * @param positions Packed xyz positions of every vertex.
+ * @param normals Packed xyz normals of every vertex, or nullptr to write zero
+ * normals.
+ * @param buffer Output records; the record of vertex i is written at
+ * buffer + (i - begin) * kInterleavedFloats.
+ */
+void InterleaveVertices(const float *positions, const float *normals,
+                        size_t begin, size_t end, float *buffer);
+
+/**
+ * @brief BuildVertexBuffer Builds the indexed vertex buffer of a mesh in
+ * kInterleavedLayout: exactly one record per vertex, so that the faces index
+ * it directly. The buffer is sized once and filled in parallel.
+ * @param positions Packed xyz positions.
+ * @param normals Packed xyz normals, one per position, or empty for zero
+ * normals.
+ * @param buffer The resulting records.
+ */
+void BuildVertexBuffer(const std::vector<float> &positions,
+                       const std::vector<float> &normals,
+                       std::vector<float> *buffer);
+
+}  // namespace data_representation
+
+#endif  // VERTEX_BUFFER_H_